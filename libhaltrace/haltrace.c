@@ -0,0 +1,108 @@
+/*
+ * Copyright (C) 2011 The CyanogenMod Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#define LOG_TAG "haltrace"
+
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <cutils/atomic.h>
+#include <cutils/log.h>
+#include <cutils/properties.h>
+
+#include "haltrace.h"
+
+#define TRACE_MARKER    "/sys/kernel/debug/tracing/trace_marker"
+
+/*****************************************************************************/
+
+void hal_trace_init(struct hal_trace *trace)
+{
+    char value[PROPERTY_VALUE_MAX];
+
+    property_get(trace->property, value, "0");
+    if (strcmp(value, "1"))
+        return;
+
+    trace->pid = getpid();
+    trace->marker_fd = open(TRACE_MARKER, O_WRONLY);
+    LOGW_IF(trace->marker_fd < 0, "couldn't open %s, tracing to memory",
+            TRACE_MARKER);
+    trace->enabled = 1;
+}
+
+void hal_trace_record(struct hal_trace *trace, char type, const char *name,
+        int value)
+{
+    struct hal_trace_record *r;
+    struct timespec ts;
+    uint32_t slot;
+    char buf[96];
+    int len;
+
+    if (trace->marker_fd >= 0) {
+        switch (type) {
+        case 'B':
+            len = snprintf(buf, sizeof(buf), "B|%d|%s", trace->pid, name);
+            break;
+        case 'E':
+            len = snprintf(buf, sizeof(buf), "E");
+            break;
+        default:
+            len = snprintf(buf, sizeof(buf), "C|%d|%s|%d", trace->pid, name, value);
+            break;
+        }
+        write(trace->marker_fd, buf, len);
+        return;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    /* unsigned, so that the index keeps counting through the wrap */
+    slot = (uint32_t)android_atomic_inc((volatile int32_t *)&trace->head);
+    r = &trace->ring[slot & (trace->ring_size - 1)];
+    r->time = (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+    r->name = name;
+    r->value = value;
+    r->type = type;
+}
+
+int hal_trace_dump(struct hal_trace *trace, int fd)
+{
+    const uint32_t head = trace->head;
+    uint32_t i;
+    int dumped = 0;
+
+    if (!trace->enabled || trace->marker_fd >= 0)
+        return 0;
+
+    /* oldest first; records being written while we dump may be torn */
+    for (i = head - trace->ring_size; i != head; i++) {
+        const struct hal_trace_record *r = &trace->ring[i & (trace->ring_size - 1)];
+        char buf[96];
+        int len;
+        if (!r->type)
+            continue;
+        len = snprintf(buf, sizeof(buf), "trace %lld %c %s %d\n",
+                r->time, r->type, r->name ? r->name : "", r->value);
+        write(fd, buf, len);
+        dumped++;
+    }
+    return dumped;
+}
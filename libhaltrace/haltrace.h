@@ -0,0 +1,64 @@
+/*
+ * Copyright (C) 2011 The CyanogenMod Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef _HALTRACE_H_
+#define _HALTRACE_H_
+
+#include <stdint.h>
+
+// begin/end spans and counters shared by the lights and sensors HALs,
+// written to the ftrace trace_marker (systrace format) or, when that can't
+// be opened, to an in-memory ring. Each HAL defines its own hal_trace with
+// HAL_TRACE_DEFINE and tests its enabled field inline before calling in,
+// so that a trace point that is off costs one not-taken branch.
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct hal_trace_record {
+    long long time;
+    const char *name;       /* trace point names are string literals */
+    int value;
+    char type;              /* 'B', 'E' or 'C', 0 for a slot never written */
+};
+
+struct hal_trace {
+    int enabled;
+    const char *property;   /* set to "1" to trace */
+    int marker_fd;
+    int pid;
+    struct hal_trace_record *ring;
+    uint32_t ring_size;     /* power of two */
+    volatile uint32_t head; /* records ever written, wraps around */
+};
+
+#define HAL_TRACE_DEFINE(var, property, ring_size)                      \
+    static struct hal_trace_record var##_ring[ring_size];               \
+    struct hal_trace var = { 0, property, -1, 0, var##_ring, ring_size, 0 }
+
+void hal_trace_init(struct hal_trace *trace);
+void hal_trace_record(struct hal_trace *trace, char type, const char *name,
+        int value);
+/* writes the in-memory ring as text, returns 0 if it isn't in use */
+int hal_trace_dump(struct hal_trace *trace, int fd);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
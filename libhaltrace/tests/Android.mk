@@ -0,0 +1,14 @@
+# Copyright (C) 2011 The CyanogenMod Project
+#
+# Host benchmark of the trace points, see haltrace_bench.c
+
+LOCAL_PATH := $(call my-dir)
+
+include $(CLEAR_VARS)
+LOCAL_MODULE_TAGS := tests
+LOCAL_SRC_FILES := haltrace_bench.c ../haltrace.c
+LOCAL_C_INCLUDES := $(LOCAL_PATH)/..
+LOCAL_STATIC_LIBRARIES := libcutils liblog
+LOCAL_LDLIBS := -lrt
+LOCAL_MODULE := haltrace_bench
+include $(BUILD_HOST_EXECUTABLE)
@@ -0,0 +1,155 @@
+/*
+ * Copyright (C) 2011 The CyanogenMod Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/*
+ * What a trace point costs while tracing is off, to the in-memory ring and
+ * to a marker file, and that the ring keeps its order when the record
+ * count wraps around.
+ *
+ *   haltrace_bench [calls]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "haltrace.h"
+
+/*****************************************************************************/
+
+HAL_TRACE_DEFINE(bench_trace, "debug.haltrace.bench", 16);
+
+#define TRACE_INT(name, value)  do { \
+        if (__builtin_expect(bench_trace.enabled, 0)) \
+            hal_trace_record(&bench_trace, 'C', name, value); \
+    } while (0)
+
+static int failures;
+
+#define CHECK(cond, ...) do { \
+        if (!(cond)) { \
+            printf("FAIL: " __VA_ARGS__); \
+            printf("\n"); \
+            failures++; \
+        } \
+    } while (0)
+
+static long long now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/* a hot path without and with a trace point, kept out of line like the
+ * HAL functions they stand for */
+static int sink;
+
+static __attribute__((noinline)) void work(int i)
+{
+    sink += i;
+}
+
+static __attribute__((noinline)) void traced_work(int i)
+{
+    TRACE_INT("work", i);
+    sink += i;
+}
+
+static long long run(void (*func)(int), int calls)
+{
+    long long start = now();
+    int i;
+    for (i = 0; i < calls; i++)
+        func(i);
+    return now() - start;
+}
+
+static void check_wrap(void)
+{
+    char buf[4096], name[16];
+    long long time, last = 0;
+    int fds[2], len, value, n = 0, expected;
+    char type;
+    char *line;
+
+    /* the next records take the count through 2^32 */
+    bench_trace.enabled = 1;
+    bench_trace.marker_fd = -1;
+    bench_trace.head = 0xfffffff8;
+    for (value = 0; value < 24; value++)
+        TRACE_INT("wrap", value);
+    CHECK(bench_trace.head == 16, "head %u after the wrap", bench_trace.head);
+
+    if (pipe(fds) < 0)
+        return;
+    CHECK(hal_trace_dump(&bench_trace, fds[1]) == 16, "ring not full after the wrap");
+    close(fds[1]);
+    len = read(fds[0], buf, sizeof(buf) - 1);
+    close(fds[0]);
+    buf[len > 0 ? len : 0] = '\0';
+
+    /* oldest first: the last 16 of the 24 values */
+    expected = 24 - 16;
+    for (line = strtok(buf, "\n"); line; line = strtok(NULL, "\n")) {
+        if (sscanf(line, "trace %lld %c %15s %d", &time, &type, name, &value) != 4)
+            continue;
+        CHECK(value == expected && time >= last, "record %d: value %d", n, value);
+        expected++;
+        last = time;
+        n++;
+    }
+    CHECK(n == 16, "%d records dumped", n);
+    bench_trace.enabled = 0;
+}
+
+int main(int argc, char **argv)
+{
+    int calls = argc > 1 ? atoi(argv[1]) : 10000000;
+    long long plain, off, ring, marker;
+
+    if (calls <= 0)
+        calls = 10000000;
+
+    check_wrap();
+
+    bench_trace.enabled = 0;
+    run(work, calls);                   /* warm up */
+    plain = run(work, calls);
+    off = run(traced_work, calls);
+
+    bench_trace.enabled = 1;
+    bench_trace.marker_fd = -1;
+    ring = run(traced_work, calls);
+
+    /* the write() of a trace_marker, to a file that throws it away */
+    bench_trace.marker_fd = open("/dev/null", O_WRONLY);
+    marker = bench_trace.marker_fd >= 0 ? run(traced_work, calls / 10) * 10 : 0;
+    bench_trace.enabled = 0;
+
+    printf("%d calls, ns per call:\n", calls);
+    printf("  no trace point      %.2f\n", (double)plain / calls);
+    printf("  tracing off         %.2f\n", (double)off / calls);
+    printf("  tracing to ring     %.2f\n", (double)ring / calls);
+    printf("  tracing to marker   %.2f\n", (double)marker / calls);
+
+    printf("%s\n", failures ? "FAILED" : "PASSED");
+    return failures ? 1 : 0;
+}
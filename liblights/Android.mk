@@ -25,7 +25,15 @@ LOCAL_MODULE_PATH := $(TARGET_OUT_SHARED_LIBRARIES)/hw
 LOCAL_MODULE_TAGS := optional
 
 LOCAL_SRC_FILES := lights_leo.c \
-		   events.c
+		   events.c \
+		   paths.c \
+		   timers.c \
+		   trace.c
+
+# trace points, see trace.h
+#LOCAL_CFLAGS += -DLIGHTS_TRACE
+LOCAL_C_INCLUDES := $(LOCAL_PATH)/../libhaltrace
+LOCAL_STATIC_LIBRARIES := libhaltrace.leo
 
 LOCAL_SHARED_LIBRARIES := liblog libcutils
 LOCAL_PRELINK_MODULE := false
@@ -33,3 +41,5 @@ LOCAL_PRELINK_MODULE := false
 include $(BUILD_SHARED_LIBRARY)
 
 endif # !TARGET_SIMULATOR
+
+include $(call all-makefiles-under,$(LOCAL_PATH))
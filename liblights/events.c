@@ -16,38 +16,53 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
 #include <fcntl.h>
 #include <dirent.h>
+#include <limits.h>
 #include <sys/poll.h>
 
 #include <linux/input.h>
 
 #include "events.h"
+#include "paths.h"
 
 #define MAX_DEVICES 16
 
-static struct pollfd ev_fds[MAX_DEVICES];
+#ifndef SYN_DROPPED
+#define SYN_DROPPED 3
+#endif
+
+/* one spare slot for the fd passed to ev_wait */
+static struct pollfd ev_fds[MAX_DEVICES + 1];
+/* set after a SYN_DROPPED until that device's next SYN_REPORT */
+static unsigned char ev_resync[MAX_DEVICES];
 static unsigned ev_count = 0;
 
 int ev_init(void)
 {
     DIR *dir;
     struct dirent *de;
+    char path[PATH_MAX];
     int fd;
 
-    dir = opendir("/dev/input");
+    dir = opendir(lights_path(path, sizeof(path), "/dev/input"));
     if(dir != 0) {
         while((de = readdir(dir))) {
 //            fprintf(stderr,"/dev/input/%s\n", de->d_name);
             if(strncmp(de->d_name,"event",5)) continue;
-            fd = openat(dirfd(dir), de->d_name, O_RDONLY);
+            fd = openat(dirfd(dir), de->d_name, O_RDONLY | O_NONBLOCK);
             if(fd < 0) continue;
 
             ev_fds[ev_count].fd = fd;
             ev_fds[ev_count].events = POLLIN;
+            ev_resync[ev_count] = 0;
             ev_count++;
             if(ev_count == MAX_DEVICES) break;
         }
+        closedir(dir);
     }
 
     return 0;
@@ -60,6 +75,20 @@ void ev_exit(void)
     }
 }
 
+/* waits for input, or for fd to become readable, for at most timeout ms */
+int ev_wait(int fd, int timeout)
+{
+    unsigned n = ev_count;
+
+    if (fd >= 0) {
+        ev_fds[n].fd = fd;
+        ev_fds[n].events = POLLIN;
+        ev_fds[n].revents = 0;
+        n++;
+    }
+    return poll(ev_fds, n, timeout);
+}
+
 int ev_get(struct input_event *ev, unsigned dont_wait)
 {
     int r;
@@ -80,3 +109,50 @@ int ev_get(struct input_event *ev, unsigned dont_wait)
 
     return -1;
 }
+
+/*
+ * Drains every device that has input queued into evs, at most max events,
+ * without blocking; returns the number of events stored. Devices that filled
+ * the rest of the buffer are picked up again by the next call.
+ *
+ * When the kernel's buffer for a device overflowed it reports SYN_DROPPED;
+ * that event is passed on so the caller knows state was lost, and the rest
+ * of the torn packet up to and including the next SYN_REPORT is discarded as
+ * documented for evdev.
+ */
+int ev_get_all(struct input_event *evs, unsigned max)
+{
+    unsigned n, i, base, count = 0;
+    int r;
+
+    if (max == 0 || poll(ev_fds, ev_count, 0) <= 0)
+        return 0;
+
+    for (n = 0; n < ev_count && count < max; n++) {
+        if (!(ev_fds[n].revents & POLLIN))
+            continue;
+        r = read(ev_fds[n].fd, &evs[count], (max - count) * sizeof(*evs));
+        if (r < (int)sizeof(*evs))
+            continue;   /* EAGAIN, or the device went away */
+
+        /* filter the events just read in place */
+        base = count;
+        r /= sizeof(*evs);
+        for (i = 0; i < (unsigned)r; i++) {
+            struct input_event *ev = &evs[base + i];
+
+            if (ev->type == EV_SYN && ev->code == SYN_DROPPED) {
+                ev_resync[n] = 1;
+                evs[count++] = *ev;
+                continue;
+            }
+            if (ev_resync[n]) {
+                if (ev->type == EV_SYN && ev->code == SYN_REPORT)
+                    ev_resync[n] = 0;
+                continue;
+            }
+            evs[count++] = *ev;
+        }
+    }
+    return count;
+}
@@ -23,7 +23,9 @@
 struct input_event;
 
 int ev_init(void);
+int ev_wait(int fd, int timeout);
 int ev_get(struct input_event *ev, unsigned dont_wait);
+int ev_get_all(struct input_event *evs, unsigned max);
 void ev_exit(void);
 
 #endif
@@ -34,8 +34,16 @@
 #include <linux/input.h>
 #include <time.h>
 #include <sys/stat.h>
+#include <poll.h>
+#include <dirent.h>
+#include <stdlib.h>
+
+#include <linux/lightsensor.h>
 
 #include "events.h"
+#include "paths.h"
+#include "timers.h"
+#include "trace.h"
 
 #define LIGHT_ATTENTION	1
 #define LIGHT_NOTIFY 	2
@@ -45,6 +53,22 @@
 
 #define  ENABLE_RADIO_POOL
 
+#define  BUTTONS_TIMEOUT_MS  8000    /* keypad light after the last key press */
+#define  LCD_DIM_MS          10000
+#define  LCD_DIM_LEVEL       50
+#define  RADIO_POLL_MS       1000
+#define  EV_BATCH            64      /* input events read per ev_get_all() */
+
+#ifndef SYN_DROPPED
+#define SYN_DROPPED 3
+#endif
+
+/* backlight follows the CM3602 when the framework asks for
+   BRIGHTNESS_MODE_SENSOR. GB's PowerManager sends that mode for its own
+   software auto-brightness too, which the overlay enables, so this stays
+   off unless the framework's engine is switched off */
+//#define  ENABLE_HW_AUTOBRIGHTNESS
+
 #define  LED_DEBUG  1
 
 #if LED_DEBUG
@@ -60,7 +84,9 @@ static pthread_once_t g_init = PTHREAD_ONCE_INIT;
 static pthread_mutex_t g_lock = PTHREAD_MUTEX_INITIALIZER;
 
 #ifdef ENABLE_LCDSAVE
-static int g_current_backlight = 0;
+static int g_current_backlight = 0; /* level asked for, restored on activity */
+static int g_dimmed = 0;
+static long long g_last_activity = 0;
 #endif
 
 static int g_ts = 0;
@@ -111,12 +137,13 @@ struct led leds[NUM_LEDS] = {
 
 static int init_prop(struct led_prop *prop)
 {
+    char path[PATH_MAX];
     int fd;
 
     prop->fd = -1;
     if (!prop->filename)
         return 0;
-    fd = open(prop->filename, O_RDWR);
+    fd = open(lights_path(path, sizeof(path), prop->filename), O_RDWR);
     if (fd < 0) {
         LOGE("init_prop: %s cannot be opened (%s)\n", prop->filename,
              strerror(errno));
@@ -140,6 +167,7 @@ void init_globals(void)
 {
     int i;
     pthread_mutex_init(&g_lock, NULL);
+    lights_trace_init();
 
     for (i = 0; i < NUM_LEDS; ++i) {
         init_prop(&leds[i].brightness);
@@ -163,6 +191,7 @@ write_int(struct led_prop *prop, int value)
     if (prop->fd < 0)
         return 0;
     if (prop->value != value) { 
+        LIGHTS_TRACE_BEGIN("write_int");
     	//LOGV("%s %s: 0x%x\n", __func__, prop->filename, value);
     	bytes = snprintf(buffer, sizeof(buffer), "%d\n", value);
     	while (bytes > 0) {
@@ -170,11 +199,13 @@ write_int(struct led_prop *prop, int value)
         	if (amt < 0) {
         	    if (errno == EINTR)
          	       continue;
+         	   LIGHTS_TRACE_END();
          	   return -errno;
         	}
         	bytes -= amt;
     	}
     	prop->value = value;
+        LIGHTS_TRACE_END();
     }
     return 0;
 }
@@ -201,11 +232,12 @@ static int last_battery_state = 0;
 void *battery_state_thread(void *arg){
     int fd,size, rs;
     char state[20];
+    char path[PATH_MAX];
     struct timespec t;
     t.tv_nsec = 0;
     t.tv_sec = 5;
         
-    fd = open("/sys/class/power_supply/battery/status",O_RDONLY | O_NDELAY);
+    fd = open(lights_path(path, sizeof(path), "/sys/class/power_supply/battery/status"),O_RDONLY | O_NDELAY);
     if(fd < 0) {
        	LOGE("Couldn't open /sys/class/power_supply/battery/status\n");
         return 0;
@@ -254,30 +286,12 @@ static int last_radio_state = 0;
 #endif
 
 static pthread_t events_ct = 0;
-static time_t    keys_tm;
-#ifdef ENABLE_LCDSAVE
-static time_t    abs_tm;
-static time_t    last_activity_tm;
-
-static int user_activity_idle() {
-  int fd;
-  int ret =0;
-  char tmp[20];
-
-  fd= open("/sys/android_power/auto_off_timeout",O_RDONLY);
-  if(fd < 0) {
-       	LOGE("Couldn't open /sys/android_power/auto_off_timeout\n");
-        return 0;
-  }
 
-  memset(&tmp[0], 0, sizeof(tmp));
-  read(fd, tmp,20); 
-    
-  D("@@ %s->%s\n", __func__, tmp);
- 
-  close(fd);
-  return (ret);
-}
+static void buttons_timeout(void *arg);
+static struct lights_timer buttons_timer = LIGHTS_TIMER_INIT(buttons_timeout, NULL);
+#ifdef ENABLE_LCDSAVE
+static void lcd_dim_timeout(void *arg);
+static struct lights_timer lcd_dim_timer = LIGHTS_TIMER_INIT(lcd_dim_timeout, NULL);
 #endif
 
 static int
@@ -286,9 +300,12 @@ switch_led_button(int on) {
   if (g_buttons!=on) {	
   	//D("@@ %s->%s\n", __func__, g_buttons?"ON":"OFF");
   	err = write_int(&leds[BUTTONS_LED].brightness, on);
-  	keys_tm = time(NULL) + (8*on); // switch off button keypad after 8 seconds
   	g_buttons = on; 
   }
+  if (on)
+  	timer_start(&buttons_timer, BUTTONS_TIMEOUT_MS); // switch off button keypad after 8 seconds
+  else
+  	timer_stop(&buttons_timer);
   return err;
 }
 
@@ -297,113 +314,277 @@ set_led_backlight(int level) {
   int err = 0;	
   //D("%s: [%d %d %d]\n", __func__, level, g_backlight, g_current_backlight);
   if (g_backlight != level ){
+     LIGHTS_TRACE_INT("backlight", level);
      err = write_int(&leds[LCD_BACKLIGHT].brightness, level);
      g_backlight = level;
   }
-#ifdef ENABLE_LCDSAVE
-  if (level>=g_current_backlight){
-        g_current_backlight=level;
-	abs_tm = time(NULL) + (10);
-  }
-#endif
+  if (level == 0 && g_buttons)
+     switch_led_button(0);
   return err;
 }
 
-void *events_cthread(void *arg) {
+static void buttons_timeout(void *arg) {
+  pthread_mutex_lock(&g_lock);
+  switch_led_button(0);
+  pthread_mutex_unlock(&g_lock);
+}
+
+//=====================================================================================
+/*
+ * Backlight ramps.
+ *
+ * Backlight changes glide from the level currently on the panel to the new
+ * one over a given time. While a ramp is running a lights timer steps it
+ * every RAMP_TICK_MS on the events thread, so however often the target
+ * changes the sysfs attribute is written at most RAMP_MAX_HZ times a second;
+ * a new target simply restarts the ramp from wherever the panel is.
+ * Switching the panel on or off is never ramped.
+ */
+#define RAMP_MS          150   /* levels pushed by the framework */
+#define RAMP_MAX_HZ      60
+#define RAMP_TICK_MS     ((1000 + RAMP_MAX_HZ - 1) / RAMP_MAX_HZ)
+
+struct ramp {
+    int armed;
+    int from;
+    int target;
+    long long start_ms;
+    int duration_ms;
+    unsigned writes;    /* sysfs writes for the current transition */
+};
+
+/* protected by g_lock */
+static struct ramp g_ramp = { 0, 0, 0, 0, 0, 0 };
+
+static void ramp_step(void *arg);
+static struct lights_timer ramp_timer = LIGHTS_TIMER_INIT(ramp_step, NULL);
+
+static int ramp_level_at(long long now) {
+    long long elapsed = now - g_ramp.start_ms;
+
+    if (elapsed >= g_ramp.duration_ms)
+        return g_ramp.target;
+    return g_ramp.from + (g_ramp.target - g_ramp.from) * elapsed / g_ramp.duration_ms;
+}
+
+static void ramp_step(void *arg) {
+    int level, before;
+
+    pthread_mutex_lock(&g_lock);
+    if (g_ramp.armed) {
+        level = ramp_level_at(timers_now());
+        before = g_backlight;
+        set_led_backlight(level);
+        if (g_backlight != before)
+            g_ramp.writes++;
+        if (level == g_ramp.target) {
+            g_ramp.armed = 0;
+            D("@@ %s: reached %d with %u writes\n", __func__, level, g_ramp.writes);
+        } else {
+            timer_start(&ramp_timer, RAMP_TICK_MS);
+        }
+    }
+    pthread_mutex_unlock(&g_lock);
+}
+
+/* called with g_lock held */
+static int set_backlight_ramped_locked(int level, int duration_ms) {
+    if (g_ramp.armed ? g_ramp.target == level : g_backlight == level)
+        return 0;   /* already there, or on its way */
+
+    /* the steps run on the events thread, without it the level goes straight in */
+    if (duration_ms <= 0 || level == 0 || g_backlight == 0 || events_ct == 0) {
+        if (g_ramp.armed) {
+            timer_stop(&ramp_timer);
+            g_ramp.armed = 0;
+        }
+        g_ramp.target = level;
+        return set_led_backlight(level);
+    }
+
+    g_ramp.from = g_backlight;
+    g_ramp.target = level;
+    g_ramp.start_ms = timers_now();
+    g_ramp.duration_ms = duration_ms;
+    if (!g_ramp.armed) {
+        g_ramp.writes = 0;
+        g_ramp.armed = 1;
+        timer_start(&ramp_timer, RAMP_TICK_MS);
+    }
+    return 0;
+}
+
 #ifdef ENABLE_RADIO_POOL
+static void radio_poll(void *arg);
+static struct lights_timer radio_timer = LIGHTS_TIMER_INIT(radio_poll, NULL);
+
+static void radio_poll(void *arg) {
     int radio_state = 0;
     char sim_state[PROPERTY_VALUE_MAX];
-#endif
-    struct input_event ev;
-    struct timespec t;
-    time_t a_tm, k_tm;
-    //int fd;
-    t.tv_nsec= 10000*1000;
-    t.tv_sec = 0;
-
-    ev_init();
 
-    for (;;) {    
-          /* radio events tracking */
-#ifdef ENABLE_RADIO_POOL
-          radio_state = 0;      
-          if (property_get("gsm.sim.state", sim_state, NULL) && (strcmp(sim_state, "READY")==0))  {  
-              radio_state = 1;  
-          } 
-          //radio state changed
-          if ( last_radio_state != radio_state){   
-	    D("@@ %s: |%s| %d->%d\n", __func__, sim_state, last_radio_state, radio_state );
-            //green blink if radio is on
-    	    write_int(&leds[AMBER_LED].brightness, radio_state?0:1);                    
-    	    write_int(&leds[GREEN_LED].brightness, radio_state?1:0);
-    	    write_int(&leds[GREEN_LED].blink, radio_state?1:0);
-            last_radio_state=radio_state;   
-          }    
+    if (property_get("gsm.sim.state", sim_state, NULL) && (strcmp(sim_state, "READY")==0))  {  
+        radio_state = 1;  
+    } 
+    //radio state changed
+    if ( last_radio_state != radio_state){   
+        D("@@ %s: |%s| %d->%d\n", __func__, sim_state, last_radio_state, radio_state );
+        pthread_mutex_lock(&g_lock);
+        //green blink if radio is on
+        write_int(&leds[AMBER_LED].brightness, radio_state?0:1);                    
+        write_int(&leds[GREEN_LED].brightness, radio_state?1:0);
+        write_int(&leds[GREEN_LED].blink, radio_state?1:0);
+        pthread_mutex_unlock(&g_lock);
+        last_radio_state=radio_state;   
+    }    
+    timer_start(&radio_timer, RADIO_POLL_MS);
+}
 #endif
-          /* battery events tracking */
- 
-          /* button events tracking */
-    	  ev_get(&ev, 1); 
-          if (ev.type==EV_KEY) {
-	       if (ev.value == 1){
-                 switch (ev.code) {
-                 case BTN_TOUCH:
+
+/* called with g_lock held, level as picked by the framework or the auto thread */
+static int set_backlight_target_locked(int level, int duration_ms) {
 #ifdef ENABLE_LCDSAVE
-			if (g_backlight > 0) && (abs_tm==0)                                                                                                                  
-		       	    set_led_backlight(g_current_backlight);			
-			}
+    int was_on = g_current_backlight > 0;
+
+    g_current_backlight = level;
+    if (level == 0) {
+        g_dimmed = 0;
+        timer_stop(&lcd_dim_timer);
+    } else if (g_dimmed) {
+        return 0;       /* the next touch brings it back */
+    } else {
+        if (!was_on)
+            g_last_activity = timers_now();
+        if (!timer_pending(&lcd_dim_timer))
+            timer_start(&lcd_dim_timer, LCD_DIM_MS);
+    }
 #endif
-		      break;
-                 case KEY_SEND:
-	         case KEY_MENU:
-	         case KEY_HOME:
-	         case KEY_BACK:
-	         case KEY_END:
-	         case KEY_POWER:
+    return set_backlight_ramped_locked(level, duration_ms);
+}
+
 #ifdef ENABLE_LCDSAVE
-		     if (abs_tm==0) {set_led_backlight(g_current_backlight);}
+/*
+ * Dimming on user inactivity.
+ *
+ * The events thread stamps g_last_activity once per batch of key or touch
+ * input; no timer is touched per event. When the dim timer fires it either
+ * finds the user idle for LCD_DIM_MS and drops the panel to LCD_DIM_LEVEL,
+ * or re-arms itself for the rest of the idle period. The first activity
+ * after that puts g_current_backlight back.
+ */
+static void lcd_activity_locked(void) {
+    g_last_activity = timers_now();
+    if (g_dimmed) {
+        D("@@ %s: restoring %d\n", __func__, g_current_backlight);
+        g_dimmed = 0;
+        set_backlight_ramped_locked(g_current_backlight, RAMP_MS);
+    }
+    if (g_current_backlight > 0 && !timer_pending(&lcd_dim_timer))
+        timer_start(&lcd_dim_timer, LCD_DIM_MS);
+}
+
+static void lcd_dim_timeout(void *arg) {
+    long long idle;
+
+    pthread_mutex_lock(&g_lock);
+    idle = timers_now() - g_last_activity;
+    if (g_current_backlight == 0 || g_dimmed) {
+        /* restarted by the next level or activity */
+    } else if (idle < LCD_DIM_MS) {
+        timer_start(&lcd_dim_timer, LCD_DIM_MS - idle);
+    } else if (g_current_backlight > LCD_DIM_LEVEL) {
+        D("@@ %s: idle %lld ms, dimming\n", __func__, idle);
+        g_dimmed = 1;
+        set_backlight_ramped_locked(LCD_DIM_LEVEL, RAMP_MS);
+    }
+    pthread_mutex_unlock(&g_lock);
+}
+
+static int is_touch_axis(int code) {
+    switch (code) {
+    case ABS_X:
+    case ABS_Y:
+    case ABS_MT_POSITION_X:
+    case ABS_MT_POSITION_Y:
+        return 1;
+    }
+    return 0;   /* the light sensor reports ABS_MISC */
+}
 #endif
-            	     switch_led_button(1);
-                     sleep(1);
-                     break;
+
+/*
+ * Sleeps until there is input or the next lights timer is due, so an idle
+ * phone doesn't wake this thread at all between radio polls.
+ */
+void *events_cthread(void *arg) {
+    struct input_event evs[EV_BATCH];
+    int active, keys, n, i;
+
+    ev_init();
+    timers_init(NULL);
+#ifdef ENABLE_RADIO_POOL
+    timer_start(&radio_timer, 0);
+#endif
+
+    for (;;) {    
+          if (ev_wait(timers_fd(), timers_timeout()) < 0 && errno != EINTR) {
+              LOGE("%s: poll failed (%s)\n", __func__, strerror(errno));
+              break;
+          }
+          LIGHTS_TRACE_BEGIN("events_cthread");
+          /* button, dim, ramp and radio deadlines */
+          timers_run();
+
+          /* button events tracking, everything queued is handled in one go */
+          active = 0;
+          keys = 0;
+          while ((n = ev_get_all(evs, EV_BATCH)) > 0) {
+            for (i = 0; i < n; i++) {
+              struct input_event *ev = &evs[i];
+
+              if (ev->type==EV_SYN && ev->code==SYN_DROPPED) {
+                  /* the kernel lost some of a burst, which was activity */
+                  D("@@ %s: input events dropped\n", __func__);
+                  active = 1;
+                  continue;
+              }
 #ifdef ENABLE_LCDSAVE
-                 case KEY_VOLUMEUP:
-                 case KEY_VOLUMEDOWN:
-		     if (abs_tm==0) { set_led_backlight(g_current_backlight);}
- 		     break;
+              if (ev->type==EV_ABS && is_touch_axis(ev->code)) {
+                  active = 1;
+                  continue;
+              }
 #endif
-                 default:
-	             /*LOGD("keys: code %d, value %d\n", ev.code, ev.value);*/
-		     sleep(1);
-                     break;
-                }
+              if (ev->type!=EV_KEY || ev->value != 1)
+                  continue;
+              active = 1;
+              switch (ev->code) {
+              case KEY_SEND:
+              case KEY_MENU:
+              case KEY_HOME:
+              case KEY_BACK:
+              case KEY_END:
+              case KEY_POWER:
+                  keys = 1;
+                  break;
+              default:
+                  /*LOGD("keys: code %d, value %d\n", ev->code, ev->value);*/
+                  break;
               }
-	 }
-//=========================
+            }
+          }
+          if (active) {
+              pthread_mutex_lock(&g_lock);
 #ifdef ENABLE_LCDSAVE
-	if (g_backlight > 0) {
-	   a_tm = time(NULL); 
-	   //D("%ld %ld\n", a_tm, abs_tm);  
-	   if ((abs_tm>0) && (a_tm >= abs_tm) && (user_activity_idle())) {
-	   	//D("LCD_BACKLIGHT->down brightness\n"); 
-	   	set_led_backlight(50);
-	   	//write_int(&leds[LCD_BACKLIGHT].brightness, 50);
-	  	 abs_tm = 0;
-           }
-	}
+              lcd_activity_locked();
 #endif
-        k_tm = time(NULL);  
-        //D("[%ld][%ld][%d][%d %d %d][%d]\n", tm, keys_tm, ev.type, ev.code, ev.value, g_buttons, g_backlight);	
-	if (g_buttons==1) {
-          if (k_tm == keys_tm || g_backlight == 0){
-            switch_led_button(0);
-            sleep(1);
+              /* no keypad light while the panel is off */
+              if (keys && g_backlight > 0)
+                  switch_led_button(1);
+              pthread_mutex_unlock(&g_lock);
           }
-	}
-//=========================
-      nanosleep(&t,NULL); //avoid 100% CPU usage by system_server
+      LIGHTS_TRACE_END();
     }
 
+    timers_exit();
     ev_exit();
     events_ct = 0; 
     return 0;
@@ -414,6 +595,301 @@ void start_events_thread() {
 	pthread_create(&events_ct, NULL, events_cthread, NULL);
    return;
 }
+//=====================================================================================
+#ifdef ENABLE_HW_AUTOBRIGHTNESS
+/*
+ * In-HAL automatic brightness.
+ *
+ * While the framework is in BRIGHTNESS_MODE_SENSOR and the screen is on, the
+ * auto thread reads the lightsensor-level evdev node itself, smooths the lux
+ * value over AUTO_TAU_MS, and moves the backlight along the lux->level curve
+ * once the smoothed lux strays AUTO_HYSTERESIS_PCT from the value that set the
+ * current level. The curve defaults to the values of the framework overlay and
+ * can be replaced with ro.lights.auto_curve = "lux:level,lux:level,...".
+ */
+#define AUTO_LS_INPUT_NAME   "lightsensor-level"
+#define AUTO_LS_DEVICE       "/dev/lightsensor"
+#define AUTO_CURVE_PROPERTY  "ro.lights.auto_curve"
+#define AUTO_MAX_POINTS      16
+#define AUTO_TAU_MS          2000
+#define AUTO_TICK_MS         250
+#define AUTO_HYSTERESIS_PCT  15
+#define AUTO_RAMP_MS         1000
+
+struct auto_point {
+    int lux;
+    int level;
+};
+
+static struct auto_point g_auto_curve[AUTO_MAX_POINTS] = {
+    {    0,  35 },
+    {  200,  55 },
+    {  400,  70 },
+    { 1000,  70 },
+    { 3000, 250 },
+};
+static int g_auto_points = 5;
+
+/* protected by g_lock */
+static int g_auto_mode = 0;       /* framework asked for sensor mode, screen on */
+static int g_auto_level = -1;     /* last level we computed, -1 until a reading */
+static int g_auto_cap = 255;      /* the framework's level, applied when lower */
+
+static pthread_t auto_ct = 0;
+static int g_auto_wake[2] = { -1, -1 };
+
+/* same levels as libsensors' LightSensor::indexToValue() */
+static int auto_index_to_lux(int index) {
+    static const int lux[10] = {
+        10, 160, 225, 320, 640, 1280, 2600, 5800, 8000, 10240
+    };
+    if (index < 0)
+        index = 0;
+    if (index > 9)
+        index = 9;
+    return lux[index];
+}
+
+static void auto_load_curve(void) {
+    char value[PROPERTY_VALUE_MAX];
+    struct auto_point curve[AUTO_MAX_POINTS];
+    char *p, *end;
+    int n = 0;
+
+    if (!property_get(AUTO_CURVE_PROPERTY, value, NULL))
+        return;
+
+    for (p = value; *p && n < AUTO_MAX_POINTS; ) {
+        curve[n].lux = strtol(p, &end, 10);
+        if (end == p || *end != ':')
+            goto bad;
+        p = end + 1;
+        curve[n].level = strtol(p, &end, 10);
+        if (end == p || (n && curve[n].lux <= curve[n-1].lux))
+            goto bad;
+        n++;
+        p = (*end == ',') ? end + 1 : end;
+    }
+    if (n < 1 || *p)
+        goto bad;
+
+    memcpy(g_auto_curve, curve, n * sizeof(curve[0]));
+    g_auto_points = n;
+    return;
+
+bad:
+    LOGE("ignoring malformed %s \"%s\"\n", AUTO_CURVE_PROPERTY, value);
+}
+
+/* piecewise linear between curve points, flat outside */
+static int auto_lux_to_level(int lux) {
+    int i;
+    const struct auto_point *a, *b;
+
+    if (lux <= g_auto_curve[0].lux)
+        return g_auto_curve[0].level;
+    for (i = 1; i < g_auto_points; i++) {
+        if (lux < g_auto_curve[i].lux) {
+            a = &g_auto_curve[i-1];
+            b = &g_auto_curve[i];
+            return a->level + (b->level - a->level) * (lux - a->lux) / (b->lux - a->lux);
+        }
+    }
+    return g_auto_curve[g_auto_points-1].level;
+}
+
+static int auto_open_input(const char *input_name) {
+    char path[PATH_MAX];
+    char name[80];
+    struct dirent *de;
+    DIR *dir;
+    int fd = -1;
+
+    dir = opendir(lights_path(path, sizeof(path), "/dev/input"));
+    if (dir == NULL)
+        return -1;
+    while ((de = readdir(dir))) {
+        if (strncmp(de->d_name, "event", 5))
+            continue;
+        snprintf(path, sizeof(path), "%s/dev/input/%s", lights_root(), de->d_name);
+        fd = open(path, O_RDONLY | O_NONBLOCK);
+        if (fd < 0)
+            continue;
+        if (ioctl(fd, EVIOCGNAME(sizeof(name) - 1), name) < 1)
+            name[0] = '\0';
+        if (!strcmp(name, input_name))
+            break;
+        close(fd);
+        fd = -1;
+    }
+    closedir(dir);
+    return fd;
+}
+
+static long long auto_now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/* switch the CM3602 light sensor on for us, leave it alone if someone
+   (libsensors) already had it on; returns 1 if we turned it on */
+static int auto_sensor_enable(int ctl_fd, int on, int owned) {
+    int flags = 0;
+
+    if (ctl_fd < 0)
+        return 0;
+    if (on) {
+        if (!ioctl(ctl_fd, LIGHTSENSOR_IOCTL_GET_ENABLED, &flags) && flags)
+            return 0;
+        flags = 1;
+        if (ioctl(ctl_fd, LIGHTSENSOR_IOCTL_ENABLE, &flags) < 0) {
+            LOGE("%s: LIGHTSENSOR_IOCTL_ENABLE failed (%s)\n", __func__, strerror(errno));
+            return 0;
+        }
+        return 1;
+    }
+    if (owned) {
+        ioctl(ctl_fd, LIGHTSENSOR_IOCTL_ENABLE, &flags);
+    }
+    return 0;
+}
+
+void *auto_cthread(void *arg) {
+    struct pollfd fds[2];
+    struct input_event ev[16];
+    struct input_absinfo absinfo;
+    char path[PATH_MAX];
+    int ctl_fd, active = 0, owned = 0;
+    int raw_lux = -1, set_lux = -1, level, i, n;
+    long long smooth = -1, last_ms = 0, now;
+
+    auto_load_curve();
+
+    fds[0].fd = auto_open_input(AUTO_LS_INPUT_NAME);
+    fds[0].events = POLLIN;
+    fds[1].fd = g_auto_wake[0];
+    fds[1].events = POLLIN;
+    ctl_fd = open(lights_path(path, sizeof(path), AUTO_LS_DEVICE), O_RDONLY);
+    if (fds[0].fd < 0) {
+        LOGE("%s: no %s input device, automatic brightness disabled\n",
+             __func__, AUTO_LS_INPUT_NAME);
+    }
+    LOGE_IF(ctl_fd < 0, "%s: couldn't open %s (%s)\n", __func__, AUTO_LS_DEVICE,
+            strerror(errno));
+
+    for (;;) {
+        pthread_mutex_lock(&g_lock);
+        n = g_auto_mode && fds[0].fd >= 0;
+        pthread_mutex_unlock(&g_lock);
+
+        if (n != active) {
+            active = n;
+            if (active) {
+                owned = auto_sensor_enable(ctl_fd, 1, owned);
+                /* drop whatever queued up while we were not looking and
+                   start from the current level rather than the darkest one */
+                while (read(fds[0].fd, ev, sizeof(ev)) > 0);
+                if (!ioctl(fds[0].fd, EVIOCGABS(ABS_MISC), &absinfo)) {
+                    raw_lux = auto_index_to_lux(absinfo.value);
+                    smooth = raw_lux;
+                    set_lux = -1;
+                }
+            } else {
+                owned = auto_sensor_enable(ctl_fd, 0, owned);
+                smooth = raw_lux = set_lux = -1;
+            }
+            last_ms = auto_now_ms();
+        }
+
+        fds[0].revents = fds[1].revents = 0;
+        if (active) {
+            /* tick while the smoothed value is still converging */
+            poll(fds, 2, (smooth >= 0 && smooth != raw_lux) ? AUTO_TICK_MS : -1);
+        } else {
+            /* sleep until set_auto_mode_locked() pokes us */
+            poll(&fds[1], 1, -1);
+        }
+        if (fds[1].revents & POLLIN) {
+            char msg;
+            while (read(fds[1].fd, &msg, 1) > 0);
+        }
+        if (!active)
+            continue;
+
+        if (fds[0].revents & POLLIN) {
+            while ((n = read(fds[0].fd, ev, sizeof(ev))) > 0) {
+                for (i = 0; i < n / (int)sizeof(ev[0]); i++) {
+                    if (ev[i].type == EV_ABS && ev[i].code == ABS_MISC && ev[i].value != -1)
+                        raw_lux = auto_index_to_lux(ev[i].value);
+                }
+            }
+        }
+        if (raw_lux < 0)
+            continue;
+
+        /* first order low pass, alpha = dt / (tau + dt); after a quiet period
+           a new reading starts a fresh ramp instead of being taken as is */
+        now = auto_now_ms();
+        if (smooth < 0) {
+            smooth = raw_lux;
+        } else {
+            long long dt = now - last_ms, step;
+            if (dt > AUTO_TICK_MS)
+                dt = AUTO_TICK_MS;
+            step = (raw_lux - smooth) * dt / (AUTO_TAU_MS + dt);
+            if (step == 0 || llabs(raw_lux - smooth - step) * 100 <= raw_lux)
+                smooth = raw_lux;   /* close enough, stop ticking */
+            else
+                smooth += step;
+        }
+        last_ms = now;
+
+        if (set_lux >= 0 &&
+                llabs(smooth - set_lux) * 100 < (long long)set_lux * AUTO_HYSTERESIS_PCT)
+            continue;
+
+        level = auto_lux_to_level((int)smooth);
+        pthread_mutex_lock(&g_lock);
+        if (g_auto_mode) {
+            set_lux = (int)smooth;
+            if (level != g_auto_level)
+                D("@@ %s: %d lux -> level %d\n", __func__, set_lux, level);
+            g_auto_level = level;
+            set_backlight_target_locked(level < g_auto_cap ? level : g_auto_cap,
+                                        AUTO_RAMP_MS);
+        }
+        pthread_mutex_unlock(&g_lock);
+    }
+
+    return 0;
+}
+
+/* called with g_lock held */
+static void set_auto_mode_locked(int on) {
+    char msg = 'W';
+
+    if (g_auto_mode == on)
+        return;
+    g_auto_mode = on;
+    if (!on)
+        g_auto_level = -1;
+
+    if (auto_ct == 0) {
+        if (!on)
+            return;
+        if (pipe(g_auto_wake) < 0) {
+            LOGE("%s: pipe failed (%s)\n", __func__, strerror(errno));
+            g_auto_mode = 0;
+            return;
+        }
+        fcntl(g_auto_wake[0], F_SETFL, O_NONBLOCK);
+        fcntl(g_auto_wake[1], F_SETFL, O_NONBLOCK);
+        pthread_create(&auto_ct, NULL, auto_cthread, NULL);
+    }
+    write(g_auto_wake[1], &msg, 1);
+}
+#endif
 //=================================================================================================
 static int
 set_light_backlight(struct light_device_t* dev,
@@ -423,7 +899,20 @@ set_light_backlight(struct light_device_t* dev,
     LOGV("%s brightness=%d color=0x%08x",
             __func__,brightness, state->color);
     pthread_mutex_lock(&g_lock);
-    set_led_backlight(brightness);
+#ifdef ENABLE_HW_AUTOBRIGHTNESS
+    /* in sensor mode the auto thread picks the level while the screen is on.
+       The framework's level is used until its first reading, and after that
+       whenever it is lower: PowerManager dims the screen before turning it
+       off, and animates back up from there */
+    set_auto_mode_locked(brightness > 0 &&
+                         state->brightnessMode == BRIGHTNESS_MODE_SENSOR);
+    if (g_auto_mode) {
+        g_auto_cap = brightness;
+        if (g_auto_level >= 0 && g_auto_level < brightness)
+            brightness = g_auto_level;
+    }
+#endif
+    set_backlight_target_locked(brightness, RAMP_MS);
     pthread_mutex_unlock(&g_lock);
     return err;
 }
@@ -595,6 +1084,7 @@ static int open_lights(const struct hw_module_t* module, char const* name,
 
     if (0 == strcmp(LIGHT_ID_BACKLIGHT, name)) {
         set_light = set_light_backlight;
+        start_events_thread();  /* runs the ramps */
     }
     else if (0 == strcmp(LIGHT_ID_BUTTONS, name)) {
         set_light = set_light_buttons;	
@@ -0,0 +1,55 @@
+/*
+ * Copyright (C) 2011 The CyanogenMod Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "paths.h"
+
+/*****************************************************************************/
+
+#ifdef LIGHTS_HOST_TEST
+
+const char *lights_root(void)
+{
+    const char *root = getenv(LIGHTS_ROOT_ENV);
+    return root ? root : "";
+}
+
+/* returns path itself when there is no root, buf otherwise */
+const char *lights_path(char *buf, size_t size, const char *path)
+{
+    const char *root = lights_root();
+
+    if (!root[0])
+        return path;
+    snprintf(buf, size, "%s%s", root, path);
+    return buf;
+}
+
+#else
+
+const char *lights_root(void)
+{
+    return "";
+}
+
+const char *lights_path(char *buf, size_t size, const char *path)
+{
+    return path;
+}
+
+#endif
@@ -0,0 +1,33 @@
+/*
+ * Copyright (C) 2011 The CyanogenMod Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _PATHS_H_
+#define _PATHS_H_
+
+#include <stddef.h>
+
+// every sysfs and devfs path the HAL opens goes through lights_path(). In a
+// host test build (LIGHTS_HOST_TEST) it prefixes them with $LIGHTS_ROOT,
+// which the harness points at a tree of fake LED attribute files and a
+// dev/input directory of FIFOs standing in for the evdev nodes. The device
+// build opens the paths as they are.
+
+#define LIGHTS_ROOT_ENV     "LIGHTS_ROOT"
+
+const char *lights_root(void);
+const char *lights_path(char *buf, size_t size, const char *path);
+
+#endif
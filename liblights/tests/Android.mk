@@ -0,0 +1,79 @@
+# Copyright (C) 2011 The CyanogenMod Project
+#
+# Host tests and benchmarks for the lights HAL. They run it against fake LED
+# attribute files and input devices under a temporary $LIGHTS_ROOT, see
+# lights_harness.h.
+
+LOCAL_PATH := $(call my-dir)
+
+lights_test_includes := $(LOCAL_PATH)/.. hardware/libhardware/include $(KERNEL_HEADERS)
+lights_test_cflags := -D_GNU_SOURCE -DLIGHTS_HOST_TEST
+
+lights_hal_sources := \
+	../lights_leo.c \
+	../events.c \
+	../paths.c \
+	../timers.c \
+	lights_harness.c
+
+include $(CLEAR_VARS)
+LOCAL_MODULE_TAGS := tests
+LOCAL_SRC_FILES := lights_bench.c $(lights_hal_sources)
+LOCAL_C_INCLUDES := $(lights_test_includes)
+LOCAL_CFLAGS := $(lights_test_cflags)
+LOCAL_STATIC_LIBRARIES := libcutils liblog
+LOCAL_LDLIBS := -lpthread -lrt
+LOCAL_MODULE := lights_bench
+include $(BUILD_HOST_EXECUTABLE)
+
+# with the optional in-HAL automatic brightness built in
+include $(CLEAR_VARS)
+LOCAL_MODULE_TAGS := tests
+LOCAL_SRC_FILES := lights_auto_test.c $(lights_hal_sources)
+LOCAL_C_INCLUDES := $(lights_test_includes)
+LOCAL_CFLAGS := $(lights_test_cflags) -DENABLE_HW_AUTOBRIGHTNESS
+LOCAL_STATIC_LIBRARIES := libcutils liblog
+LOCAL_LDLIBS := -lpthread -lrt
+LOCAL_MODULE := lights_auto_test
+include $(BUILD_HOST_EXECUTABLE)
+
+include $(CLEAR_VARS)
+LOCAL_MODULE_TAGS := tests
+LOCAL_SRC_FILES := lights_ramp_test.c $(lights_hal_sources)
+LOCAL_C_INCLUDES := $(lights_test_includes)
+LOCAL_CFLAGS := $(lights_test_cflags)
+LOCAL_STATIC_LIBRARIES := libcutils liblog
+LOCAL_LDLIBS := -lpthread -lrt
+LOCAL_MODULE := lights_ramp_test
+include $(BUILD_HOST_EXECUTABLE)
+
+include $(CLEAR_VARS)
+LOCAL_MODULE_TAGS := tests
+LOCAL_SRC_FILES := lights_timers_test.c ../timers.c
+LOCAL_C_INCLUDES := $(lights_test_includes)
+LOCAL_CFLAGS := $(lights_test_cflags)
+LOCAL_STATIC_LIBRARIES := libcutils liblog
+LOCAL_LDLIBS := -lpthread -lrt
+LOCAL_MODULE := lights_timers_test
+include $(BUILD_HOST_EXECUTABLE)
+
+# with the optional dimming on inactivity built in
+include $(CLEAR_VARS)
+LOCAL_MODULE_TAGS := tests
+LOCAL_SRC_FILES := lights_dim_test.c $(lights_hal_sources)
+LOCAL_C_INCLUDES := $(lights_test_includes)
+LOCAL_CFLAGS := $(lights_test_cflags) -DENABLE_LCDSAVE
+LOCAL_STATIC_LIBRARIES := libcutils liblog
+LOCAL_LDLIBS := -lpthread -lrt
+LOCAL_MODULE := lights_dim_test
+include $(BUILD_HOST_EXECUTABLE)
+
+include $(CLEAR_VARS)
+LOCAL_MODULE_TAGS := tests
+LOCAL_SRC_FILES := lights_input_test.c $(lights_hal_sources)
+LOCAL_C_INCLUDES := $(lights_test_includes)
+LOCAL_CFLAGS := $(lights_test_cflags)
+LOCAL_STATIC_LIBRARIES := libcutils liblog
+LOCAL_LDLIBS := -lpthread -lrt
+LOCAL_MODULE := lights_input_test
+include $(BUILD_HOST_EXECUTABLE)
@@ -0,0 +1,131 @@
+/*
+ * Copyright (C) 2011 The CyanogenMod Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+
+/*
+ * The in-HAL automatic brightness (ENABLE_HW_AUTOBRIGHTNESS) against a fake
+ * lightsensor-level input device and /dev/lightsensor: the backlight
+ * follows the sensor in BRIGHTNESS_MODE_SENSOR, a lower framework level
+ * (PowerManager's dim) still gets through, and leaving sensor mode hands
+ * the backlight back to the framework and switches the sensor off.
+ *
+ *   lights_auto_test
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <linux/input.h>
+
+#include "lights_harness.h"
+
+/*****************************************************************************/
+
+static int sFailures;
+
+#define CHECK(cond, ...) do { \
+        if (!(cond)) { \
+            printf("FAIL: " __VA_ARGS__); \
+            printf("\n"); \
+            sFailures++; \
+        } \
+    } while (0)
+
+static struct light_device_t *sBacklight;
+
+static void setBacklight(int level, int mode)
+{
+    harness_set(sBacklight, 0xff000000 | (level << 16) | (level << 8) | level,
+            LIGHT_FLASH_NONE, mode);
+}
+
+static int waitLevel(int level, int timeout_ms, const char *what)
+{
+    long long start = harness_now_ms();
+    int ok = !harness_wait_value("lcd-backlight", "brightness", level, timeout_ms);
+
+    CHECK(ok, "%s: backlight at %d, want %d", what,
+            harness_value("lcd-backlight", "brightness"), level);
+    if (ok)
+        printf("%-36s level %3d after %4lld ms\n", what, level,
+                harness_now_ms() - start);
+    return ok;
+}
+
+int main(int argc, char **argv)
+{
+    int ls;
+
+    if (harness_init() < 0)
+        return 2;
+    sBacklight = harness_open(LIGHT_ID_BACKLIGHT);
+    if (!sBacklight) {
+        harness_exit();
+        return 2;
+    }
+    /* a FIFO, unlike an evdev node, hands each event to one reader only:
+       the sensor comes after the events thread has looked at dev/input, so
+       that only the auto thread opens it */
+    harness_sleep_ms(100);
+    ls = harness_input_add("lightsensor-level");
+    /* index 0 is 10 lux, on the default curve level 35 + 20 * 10 / 200 */
+    harness_input_set_abs(ls, ABS_MISC, 0);
+
+    setBacklight(100, BRIGHTNESS_MODE_USER);
+    waitLevel(100, 1000, "user mode");
+    CHECK(!harness_lightsensor_enabled(), "light sensor on in user mode");
+
+    /* from the reading at the time sensor mode starts */
+    setBacklight(100, BRIGHTNESS_MODE_SENSOR);
+    waitLevel(36, 3000, "sensor mode, 10 lux");
+    CHECK(harness_lightsensor_enabled(), "light sensor not switched on");
+
+    /* 5800 lux, past the top of the curve */
+    setBacklight(255, BRIGHTNESS_MODE_SENSOR);
+    harness_abs(ls, ABS_MISC, 7);
+    waitLevel(250, 8000, "sensor mode, 5800 lux");
+
+    /* PowerManager dims in sensor mode before the screen goes off */
+    setBacklight(20, BRIGHTNESS_MODE_SENSOR);
+    waitLevel(20, 1000, "framework dim");
+    harness_sleep_ms(1500);
+    CHECK(harness_value("lcd-backlight", "brightness") == 20,
+            "the auto level took over from the dim level (%d)",
+            harness_value("lcd-backlight", "brightness"));
+    setBacklight(255, BRIGHTNESS_MODE_SENSOR);
+    waitLevel(250, 2000, "framework undim");
+
+    /* the lower of the two wins */
+    setBacklight(100, BRIGHTNESS_MODE_SENSOR);
+    waitLevel(100, 1000, "framework level under the auto one");
+
+    setBacklight(80, BRIGHTNESS_MODE_USER);
+    waitLevel(80, 1000, "back to user mode");
+    harness_sleep_ms(100);
+    CHECK(!harness_lightsensor_enabled(), "light sensor left on in user mode");
+
+    setBacklight(120, BRIGHTNESS_MODE_SENSOR);
+    harness_sleep_ms(100);
+    setBacklight(0, BRIGHTNESS_MODE_SENSOR);
+    waitLevel(0, 200, "screen off");
+    harness_sleep_ms(100);
+    CHECK(!harness_lightsensor_enabled(), "light sensor left on with the screen off");
+
+    harness_exit();
+    printf("%s\n", sFailures ? "FAILED" : "PASSED");
+    return sFailures ? 1 : 0;
+}
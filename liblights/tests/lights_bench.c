@@ -0,0 +1,277 @@
+/*
+ * Copyright (C) 2011 The CyanogenMod Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+
+/*
+ * The lights HAL driven through open_lights() on a fake sysfs/devfs tree,
+ * see lights_harness.h. Reports
+ *  - sysfs writes per set_light_*() call, for each light,
+ *  - how often the events thread wakes up, idle and while keys are pressed,
+ *  - set_light_battery() latency while other threads keep g_lock busy,
+ * and fails if a call writes what is already there or the idle events
+ * thread wakes up more than its radio poll needs.
+ *
+ *   lights_bench [contending threads]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include <linux/input.h>
+
+#include "lights_harness.h"
+
+/*****************************************************************************/
+
+#define LATENCY_CALLS   20000
+
+static int sFailures;
+
+#define CHECK(cond, ...) do { \
+        if (!(cond)) { \
+            printf("FAIL: " __VA_ARGS__); \
+            printf("\n"); \
+            sFailures++; \
+        } \
+    } while (0)
+
+static struct light_device_t *sBacklight;
+static struct light_device_t *sButtons;
+static struct light_device_t *sBattery;
+static struct light_device_t *sNotifications;
+static int sKeys;
+
+static unsigned ledWrites(void)
+{
+    static const char *const attrs[][2] = {
+        { "button-backlight", "brightness" },
+        { "green", "brightness" },
+        { "green", "blink" },
+        { "amber", "brightness" },
+        { "amber", "blink" },
+        { "lcd-backlight", "brightness" },
+    };
+    unsigned i, writes = 0;
+
+    for (i = 0; i < sizeof(attrs) / sizeof(attrs[0]); i++)
+        writes += harness_writes(attrs[i][0], attrs[i][1]);
+    return writes;
+}
+
+static unsigned gray(int level)
+{
+    return 0xff000000 | (level << 16) | (level << 8) | level;
+}
+
+static void report(const char *what, int calls, unsigned writes)
+{
+    printf("%-40s %4d calls %5u writes  %5.2f writes/call\n", what, calls,
+            writes, calls ? (double)writes / calls : 0.0);
+}
+
+static void benchWrites(void)
+{
+    static const unsigned colors[] = { 0xffff0000, 0xff00ff00, 0 };
+    unsigned before;
+    int i;
+
+    /* a framework brightness animation, 60 levels a second for a second */
+    before = ledWrites();
+    for (i = 0; i < 60; i++) {
+        harness_set(sBacklight, gray(255 - i * 3), LIGHT_FLASH_NONE,
+                BRIGHTNESS_MODE_USER);
+        harness_sleep_ms(1000 / 60);
+    }
+    harness_wait_value("lcd-backlight", "brightness", 255 - 59 * 3, 1000);
+    report("backlight, animated at 60 Hz", 60, ledWrites() - before);
+
+    /* the same level again and again */
+    before = ledWrites();
+    for (i = 0; i < 100; i++)
+        harness_set(sBacklight, gray(255 - 59 * 3), LIGHT_FLASH_NONE,
+                BRIGHTNESS_MODE_USER);
+    harness_sleep_ms(50);
+    report("backlight, unchanged", 100, ledWrites() - before);
+    CHECK(ledWrites() == before, "an unchanged backlight level was written");
+
+    before = ledWrites();
+    for (i = 0; i < 100; i++)
+        harness_set(sButtons, (i & 1) ? 0 : 0xffffffff, LIGHT_FLASH_NONE,
+                BRIGHTNESS_MODE_USER);
+    report("buttons, on/off", 100, ledWrites() - before);
+    CHECK(ledWrites() - before == 100, "%u writes for 100 button changes",
+            ledWrites() - before);
+
+    before = ledWrites();
+    for (i = 0; i < 100; i++)
+        harness_set(sButtons, 0, LIGHT_FLASH_NONE, BRIGHTNESS_MODE_USER);
+    report("buttons, unchanged", 100, ledWrites() - before);
+    CHECK(ledWrites() == before, "an unchanged button light was written");
+
+    before = ledWrites();
+    for (i = 0; i < 99; i++)
+        harness_set(sBattery, colors[i % 3], LIGHT_FLASH_NONE,
+                BRIGHTNESS_MODE_USER);
+    report("battery, red/green/off", 99, ledWrites() - before);
+
+    harness_set(sBattery, colors[0], LIGHT_FLASH_HARDWARE, BRIGHTNESS_MODE_USER);
+    before = ledWrites();
+    for (i = 0; i < 100; i++)
+        harness_set(sBattery, colors[0], LIGHT_FLASH_HARDWARE,
+                BRIGHTNESS_MODE_USER);
+    report("battery, unchanged", 100, ledWrites() - before);
+    CHECK(ledWrites() == before, "an unchanged battery light was written");
+
+    before = ledWrites();
+    for (i = 0; i < 100; i++)
+        harness_set(sNotifications, colors[i % 3], LIGHT_FLASH_TIMED,
+                BRIGHTNESS_MODE_USER);
+    report("notifications", 100, ledWrites() - before);
+}
+
+static void benchWakeups(void)
+{
+    unsigned before;
+    long long start;
+    int i;
+
+    before = harness_wakeups();
+    start = harness_now_ms();
+    harness_sleep_ms(3000);
+    const double idle = (harness_wakeups() - before) * 1000.0 /
+            (harness_now_ms() - start);
+
+    before = harness_wakeups();
+    start = harness_now_ms();
+    for (i = 0; i < 100; i++) {
+        harness_key(sKeys, KEY_MENU, i & 1 ? 0 : 1);
+        harness_sleep_ms(20);
+    }
+    const double typing = (harness_wakeups() - before) * 1000.0 /
+            (harness_now_ms() - start);
+
+    printf("events thread: %.1f wakeups/s idle, %.1f wakeups/s at 50 key "
+            "events/s\n", idle, typing);
+    /* the radio poll ticks once a second */
+    CHECK(idle < 2.5, "the idle events thread woke up %.1f times a second", idle);
+    CHECK(typing <= 55, "%.1f wakeups a second for 50 key events", typing);
+    CHECK(harness_value("button-backlight", "brightness") == 1,
+            "keys didn't light the buttons");
+}
+
+struct contender {
+    pthread_t thread;
+    volatile int quit;
+    unsigned calls;
+    int index;
+};
+
+static void *contend(void *arg)
+{
+    struct contender *c = arg;
+    int level = 40;
+
+    while (!c->quit) {
+        if (c->index & 1) {
+            harness_set(sButtons, (c->calls & 1) ? 0xffffffff : 0,
+                    LIGHT_FLASH_NONE, BRIGHTNESS_MODE_USER);
+        } else {
+            level = level < 250 ? level + 1 : 40;
+            harness_set(sBacklight, gray(level), LIGHT_FLASH_NONE,
+                    BRIGHTNESS_MODE_USER);
+        }
+        c->calls++;
+    }
+    return NULL;
+}
+
+static int compareLong(const void *a, const void *b)
+{
+    long long x = *(const long long *)a, y = *(const long long *)b;
+    return x < y ? -1 : x > y;
+}
+
+static void measureLatency(const char *what, int threads)
+{
+    static long long lat[LATENCY_CALLS];
+    struct contender c[8];
+    unsigned calls = 0;
+    long long sum = 0, start;
+    int i;
+
+    for (i = 0; i < threads; i++) {
+        c[i].quit = 0;
+        c[i].calls = 0;
+        c[i].index = i;
+        pthread_create(&c[i].thread, NULL, contend, &c[i]);
+    }
+    harness_sleep_ms(20);
+
+    for (i = 0; i < LATENCY_CALLS; i++) {
+        start = harness_now_us() * 1000;
+        harness_set(sBattery, (i & 1) ? 0xffff0000 : 0xff00ff00, LIGHT_FLASH_NONE,
+                BRIGHTNESS_MODE_USER);
+        lat[i] = harness_now_us() * 1000 - start;
+        sum += lat[i];
+    }
+
+    for (i = 0; i < threads; i++) {
+        c[i].quit = 1;
+        pthread_join(c[i].thread, NULL);
+        calls += c[i].calls;
+    }
+
+    qsort(lat, LATENCY_CALLS, sizeof(lat[0]), compareLong);
+    printf("set_light_battery %-22s mean %6.1f us, p50 %5lld us, p99 %5lld us, "
+            "max %6lld us (%u contending calls)\n", what,
+            sum / 1000.0 / LATENCY_CALLS, lat[LATENCY_CALLS / 2] / 1000,
+            lat[LATENCY_CALLS * 99 / 100] / 1000, lat[LATENCY_CALLS - 1] / 1000,
+            calls);
+}
+
+int main(int argc, char **argv)
+{
+    const int threads = argc > 1 ? atoi(argv[1]) : 3;
+    char what[32];
+
+    if (harness_init() < 0)
+        return 2;
+    sKeys = harness_input_add("leo-keypad");
+    sBacklight = harness_open(LIGHT_ID_BACKLIGHT);
+    sButtons = harness_open(LIGHT_ID_BUTTONS);
+    sBattery = harness_open(LIGHT_ID_BATTERY);
+    sNotifications = harness_open(LIGHT_ID_NOTIFICATIONS);
+    if (!sBacklight || !sButtons || !sBattery || !sNotifications) {
+        printf("couldn't open the lights\n");
+        harness_exit();
+        return 2;
+    }
+    /* the events thread opens the input devices when it starts */
+    harness_sleep_ms(100);
+
+    benchWrites();
+    benchWakeups();
+    measureLatency("alone", 0);
+    snprintf(what, sizeof(what), "against %d threads", threads < 8 ? threads : 8);
+    measureLatency(what, threads < 8 ? threads : 8);
+
+    harness_exit();
+    printf("%s\n", sFailures ? "FAILED" : "PASSED");
+    return sFailures ? 1 : 0;
+}
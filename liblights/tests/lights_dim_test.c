@@ -0,0 +1,204 @@
+/*
+ * Copyright (C) 2011 The CyanogenMod Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+
+/*
+ * LCD dimming on input inactivity (ENABLE_LCDSAVE) on a virtual clock: the
+ * panel drops to LCD_DIM_LEVEL after LCD_DIM_MS without touch or key input,
+ * activity pushes the deadline back, and the next touch or key restores the
+ * level asked for, including one set while dimmed. The light sensor's
+ * ABS_MISC reports are not activity, and no timer runs with the panel off.
+ *
+ * The clock is installed before the events thread starts; moving it is
+ * followed by an input packet without key or touch events, which wakes the
+ * thread so that it runs the timers that became due. Backlight ramps run on
+ * the same clock, so waiting for a level first moves it past RAMP_MS.
+ *
+ *   lights_dim_test
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <linux/input.h>
+
+#include "lights_harness.h"
+#include "../timers.h"
+
+/*****************************************************************************/
+
+/* as in lights_leo.c */
+#define LCD_DIM_MS      10000
+#define LCD_DIM_LEVEL   50
+#define RAMP_MS         150
+
+#define START_MS        1000000
+
+static int sFailures;
+
+#define CHECK(cond, ...) do { \
+        if (!(cond)) { \
+            printf("FAIL: " __VA_ARGS__); \
+            printf("\n"); \
+            sFailures++; \
+        } \
+    } while (0)
+
+static long long sNow = START_MS;
+static struct light_device_t *sBacklight;
+static int sTouch, sKeys, sLight;
+
+static long long virtualClock(void)
+{
+    return __sync_fetch_and_add(&sNow, 0);
+}
+
+static int lcd(void)
+{
+    return harness_value("lcd-backlight", "brightness");
+}
+
+/* until the events thread has read the input and had time to act on it */
+static void settle(int dev)
+{
+    long long deadline = harness_now_ms() + 1000;
+
+    while (harness_input_queued(dev) > 0 && harness_now_ms() < deadline)
+        harness_sleep_ms(1);
+    harness_sleep_ms(30);
+}
+
+static void setClock(long long now)
+{
+    struct input_event syn;
+
+    __sync_lock_test_and_set(&sNow, now);
+    memset(&syn, 0, sizeof(syn));
+    syn.type = EV_SYN;
+    syn.code = SYN_REPORT;
+    harness_input_packet(sKeys, &syn, 1);
+    settle(sKeys);
+}
+
+/* to ms after the start */
+static void advance(long long ms)
+{
+    setClock(START_MS + ms);
+}
+
+static void touch(void)
+{
+    harness_abs(sTouch, ABS_X, 100);
+    settle(sTouch);
+}
+
+static void setBacklight(int level)
+{
+    harness_set(sBacklight, 0xff000000 | (level << 16) | (level << 8) | level,
+            LIGHT_FLASH_NONE, BRIGHTNESS_MODE_USER);
+}
+
+static void expectLevel(int level, const char *what)
+{
+    setClock(virtualClock() + RAMP_MS);
+    if (harness_wait_value("lcd-backlight", "brightness", level, 1000))
+        CHECK(0, "%s: backlight at %d, want %d", what, lcd(), level);
+}
+
+static void expectUnchanged(int level, const char *what)
+{
+    harness_sleep_ms(200);
+    CHECK(lcd() == level, "%s: backlight at %d, want %d", what, lcd(), level);
+}
+
+int main(int argc, char **argv)
+{
+    struct light_device_t *buttons;
+    unsigned writes;
+
+    if (harness_init() < 0)
+        return 2;
+    sKeys = harness_input_add("leo-keypad");
+    sTouch = harness_input_add("leo-touchscreen");
+    sLight = harness_input_add("lightsensor-level");
+    timers_init(virtualClock);
+    sBacklight = harness_open(LIGHT_ID_BACKLIGHT);
+    buttons = harness_open(LIGHT_ID_BUTTONS);
+    if (!sBacklight || !buttons) {
+        harness_exit();
+        return 2;
+    }
+    harness_sleep_ms(100);
+
+    setBacklight(200);
+    expectLevel(200, "start");
+
+    advance(LCD_DIM_MS - 100);
+    expectUnchanged(200, "idle for less than the dim time");
+
+    /* a touch half way moves the deadline back */
+    advance(LCD_DIM_MS / 2);
+    touch();
+    advance(LCD_DIM_MS);
+    expectUnchanged(200, "the dim time after the start, but not after the touch");
+    advance(LCD_DIM_MS / 2 + LCD_DIM_MS - 1);
+    expectUnchanged(200, "a ms before the dim time after the touch");
+    advance(LCD_DIM_MS / 2 + LCD_DIM_MS);
+    expectLevel(LCD_DIM_LEVEL, "the dim time after the touch");
+    if (lcd() == LCD_DIM_LEVEL)
+        printf("dimmed %d ms of virtual time after the last touch\n", LCD_DIM_MS);
+
+    /* light sensor reports are not activity */
+    harness_abs(sLight, ABS_MISC, 3);
+    settle(sLight);
+    expectUnchanged(LCD_DIM_LEVEL, "light sensor report");
+
+    touch();
+    expectLevel(200, "touch while dimmed");
+
+    /* a key press also counts, and lights the buttons */
+    advance(3 * LCD_DIM_MS);
+    expectLevel(LCD_DIM_LEVEL, "idle again");
+    harness_key(sKeys, KEY_MENU, 1);
+    harness_key(sKeys, KEY_MENU, 0);
+    settle(sKeys);
+    expectLevel(200, "key while dimmed");
+    CHECK(harness_value("button-backlight", "brightness") == 1,
+            "the key didn't light the buttons");
+
+    /* a level set while dimmed is what the next touch restores */
+    advance(5 * LCD_DIM_MS);
+    expectLevel(LCD_DIM_LEVEL, "idle once more");
+    setBacklight(180);
+    expectUnchanged(LCD_DIM_LEVEL, "level set while dimmed");
+    touch();
+    expectLevel(180, "touch after a level set while dimmed");
+
+    /* nothing runs for a panel that is off */
+    setBacklight(0);
+    expectLevel(0, "panel off");
+    writes = harness_writes("lcd-backlight", "brightness");
+    advance(10 * LCD_DIM_MS);
+    advance(20 * LCD_DIM_MS);
+    CHECK(harness_writes("lcd-backlight", "brightness") == writes,
+            "the panel was written while off");
+
+    harness_exit();
+    printf("%s\n", sFailures ? "FAILED" : "PASSED");
+    return sFailures ? 1 : 0;
+}
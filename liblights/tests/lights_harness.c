@@ -0,0 +1,491 @@
+/*
+ * Copyright (C) 2011 The CyanogenMod Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <ftw.h>
+#include <limits.h>
+#include <poll.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+
+#include <linux/input.h>
+#include <linux/lightsensor.h>
+
+#include "lights_harness.h"
+#include "../paths.h"
+
+/*****************************************************************************/
+
+#define MAX_INPUTS      8
+
+struct fake_input {
+    char name[80];
+    int fd;                 /* our end of the FIFO, O_RDWR */
+    int abs[ABS_MAX + 1];
+    unsigned dropped;
+};
+
+/* the attribute files of leds[] in lights_leo.c */
+static const char *const sAttributes[] = {
+    "button-backlight/brightness",
+    "green/brightness",
+    "green/blink",
+    "amber/brightness",
+    "amber/blink",
+    "lcd-backlight/brightness",
+};
+
+static char s_root[64];
+static pthread_t s_main;
+static pthread_mutex_t s_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct fake_input s_inputs[MAX_INPUTS];
+static int s_num_inputs;
+static int s_lightsensor_enabled;
+static volatile unsigned s_wakeups;
+
+extern const struct hw_module_t HAL_MODULE_INFO_SYM;
+
+/*****************************************************************************/
+
+long long harness_now_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+long long harness_now_ms(void)
+{
+    return harness_now_us() / 1000;
+}
+
+void harness_sleep_ms(int ms)
+{
+    struct timespec ts;
+    ts.tv_sec = ms / 1000;
+    ts.tv_nsec = (ms % 1000) * 1000000L;
+    while (nanosleep(&ts, &ts) < 0 && errno == EINTR)
+        ;
+}
+
+static int remove_entry(const char *path, const struct stat *sb, int flag,
+        struct FTW *ftw)
+{
+    return remove(path);
+}
+
+static int make_file(const char *path)
+{
+    char full[PATH_MAX];
+    int fd;
+
+    snprintf(full, sizeof(full), "%s%s", s_root, path);
+    fd = open(full, O_CREAT | O_TRUNC | O_WRONLY, 0644);
+    if (fd < 0) {
+        perror(full);
+        return -1;
+    }
+    close(fd);
+    return 0;
+}
+
+static void make_dir(const char *path)
+{
+    char full[PATH_MAX];
+
+    snprintf(full, sizeof(full), "%s%s", s_root, path);
+    mkdir(full, 0755);
+}
+
+int harness_init(void)
+{
+    char path[PATH_MAX];
+    size_t i;
+
+    strcpy(s_root, "/tmp/lights-root-XXXXXX");
+    if (!mkdtemp(s_root)) {
+        perror("mkdtemp");
+        s_root[0] = '\0';
+        return -1;
+    }
+    make_dir("/dev");
+    make_dir("/dev/input");
+    make_dir("/sys");
+    make_dir("/sys/class");
+    make_dir("/sys/class/leds");
+    for (i = 0; i < sizeof(sAttributes) / sizeof(sAttributes[0]); i++) {
+        snprintf(path, sizeof(path), "/sys/class/leds/%s", sAttributes[i]);
+        *strrchr(path, '/') = '\0';
+        make_dir(path);
+        snprintf(path, sizeof(path), "/sys/class/leds/%s", sAttributes[i]);
+        if (make_file(path) < 0)
+            return -1;
+    }
+    if (make_file("/dev/lightsensor") < 0)
+        return -1;
+
+    s_main = pthread_self();
+    s_wakeups = 0;
+    s_lightsensor_enabled = 0;
+    setenv(LIGHTS_ROOT_ENV, s_root, 1);
+    return 0;
+}
+
+void harness_exit(void)
+{
+    int i;
+
+    for (i = 0; i < s_num_inputs; i++)
+        close(s_inputs[i].fd);
+    s_num_inputs = 0;
+    if (s_root[0])
+        nftw(s_root, remove_entry, 8, FTW_DEPTH | FTW_PHYS);
+    s_root[0] = '\0';
+    unsetenv(LIGHTS_ROOT_ENV);
+}
+
+const char *harness_root(void)
+{
+    return s_root;
+}
+
+struct light_device_t *harness_open(const char *id)
+{
+    struct hw_device_t *device = NULL;
+
+    if (HAL_MODULE_INFO_SYM.methods->open(&HAL_MODULE_INFO_SYM, id, &device))
+        return NULL;
+    return (struct light_device_t *)device;
+}
+
+int harness_set(struct light_device_t *dev, unsigned color, int flash_mode,
+        int brightness_mode)
+{
+    struct light_state_t state;
+
+    memset(&state, 0, sizeof(state));
+    state.color = color;
+    state.flashMode = flash_mode;
+    state.brightnessMode = brightness_mode;
+    return dev->set_light(dev, &state);
+}
+
+/*****************************************************************************/
+
+int harness_input_add(const char *name)
+{
+    struct fake_input *in;
+    char path[PATH_MAX];
+
+    if (s_num_inputs == MAX_INPUTS)
+        return -1;
+    in = &s_inputs[s_num_inputs];
+    snprintf(path, sizeof(path), "%s/dev/input/event%d", s_root, s_num_inputs);
+    if (mkfifo(path, 0644) < 0) {
+        perror(path);
+        return -1;
+    }
+    /* read-write, so that the HAL's open doesn't wait for a writer and its
+       poll() doesn't see a hangup */
+    in->fd = open(path, O_RDWR | O_NONBLOCK);
+    if (in->fd < 0) {
+        perror(path);
+        return -1;
+    }
+    snprintf(in->name, sizeof(in->name), "%s", name);
+    memset(in->abs, 0, sizeof(in->abs));
+    in->dropped = 0;
+    return s_num_inputs++;
+}
+
+void harness_input_set_abs(int dev, int code, int value)
+{
+    pthread_mutex_lock(&s_lock);
+    s_inputs[dev].abs[code] = value;
+    pthread_mutex_unlock(&s_lock);
+}
+
+int harness_input_queued(int dev)
+{
+    int bytes = 0;
+
+    if (ioctl(s_inputs[dev].fd, FIONREAD, &bytes) < 0)
+        return -1;
+    return bytes / sizeof(struct input_event);
+}
+
+unsigned harness_input_dropped(int dev)
+{
+    return s_inputs[dev].dropped;
+}
+
+int harness_input_packet(int dev, const struct input_event *evs, int n)
+{
+    struct fake_input *in = &s_inputs[dev];
+    struct input_event packet[16];
+    struct timeval now;
+    long long us = harness_now_us();
+    int queued, i;
+
+    if (n > 16)
+        return -EINVAL;
+    now.tv_sec = us / 1000000;
+    now.tv_usec = us % 1000000;
+
+    queued = harness_input_queued(dev);
+    if (queued < 0)
+        return -errno;
+    if (queued + n > HARNESS_EVDEV_BUFFER) {
+        /* what evdev does for a client that doesn't keep up: the packet is
+           lost and the client told so once there is room */
+        in->dropped++;
+        if (queued < HARNESS_EVDEV_BUFFER) {
+            memset(packet, 0, sizeof(packet[0]));
+            packet[0].time = now;
+            packet[0].type = EV_SYN;
+            packet[0].code = SYN_DROPPED;
+            write(in->fd, packet, sizeof(packet[0]));
+        }
+        return 0;
+    }
+
+    for (i = 0; i < n; i++) {
+        packet[i] = evs[i];
+        packet[i].time = now;
+    }
+    /* at most a few hundred bytes, written atomically */
+    if (write(in->fd, packet, n * sizeof(packet[0])) < 0)
+        return -errno;
+    return n;
+}
+
+static int input_event_pair(int dev, int type, int code, int value)
+{
+    struct input_event evs[2];
+
+    memset(evs, 0, sizeof(evs));
+    evs[0].type = type;
+    evs[0].code = code;
+    evs[0].value = value;
+    evs[1].type = EV_SYN;
+    evs[1].code = SYN_REPORT;
+    return harness_input_packet(dev, evs, 2);
+}
+
+int harness_key(int dev, int code, int value)
+{
+    return input_event_pair(dev, EV_KEY, code, value);
+}
+
+int harness_abs(int dev, int code, int value)
+{
+    return input_event_pair(dev, EV_ABS, code, value);
+}
+
+/*****************************************************************************/
+
+static int read_attribute(const char *led, const char *attr, char *buf,
+        size_t size)
+{
+    char path[PATH_MAX];
+    ssize_t len;
+    int fd;
+
+    snprintf(path, sizeof(path), "%s/sys/class/leds/%s/%s", s_root, led, attr);
+    fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return -1;
+    len = read(fd, buf, size - 1);
+    close(fd);
+    if (len < 0)
+        return -1;
+    buf[len] = '\0';
+    return len;
+}
+
+unsigned harness_writes(const char *led, const char *attr)
+{
+    char buf[65536];
+    unsigned writes = 0;
+    char *p;
+
+    if (read_attribute(led, attr, buf, sizeof(buf)) < 0)
+        return 0;
+    for (p = buf; (p = strchr(p, '\n')); p++)
+        writes++;
+    return writes;
+}
+
+int harness_value(const char *led, const char *attr)
+{
+    char buf[65536];
+    int len;
+
+    len = read_attribute(led, attr, buf, sizeof(buf));
+    if (len <= 0)
+        return -1;
+    buf[--len] = '\0';      /* the last newline */
+    while (len > 0 && buf[len - 1] != '\n')
+        len--;
+    return atoi(buf + len);
+}
+
+int harness_history(const char *led, const char *attr, int *values, int max)
+{
+    char buf[65536];
+    char *p, *end;
+    int n = 0;
+
+    if (read_attribute(led, attr, buf, sizeof(buf)) < 0)
+        return 0;
+    for (p = buf; n < max && (end = strchr(p, '\n')); p = end + 1)
+        values[n++] = atoi(p);
+    return n;
+}
+
+int harness_wait_value(const char *led, const char *attr, int value,
+        int timeout_ms)
+{
+    long long deadline = harness_now_ms() + timeout_ms;
+
+    while (harness_value(led, attr) != value) {
+        if (harness_now_ms() >= deadline)
+            return -1;
+        harness_sleep_ms(5);
+    }
+    return 0;
+}
+
+int harness_lightsensor_enabled(void)
+{
+    int enabled;
+
+    pthread_mutex_lock(&s_lock);
+    enabled = s_lightsensor_enabled;
+    pthread_mutex_unlock(&s_lock);
+    return enabled;
+}
+
+unsigned harness_wakeups(void)
+{
+    return s_wakeups;
+}
+
+/*****************************************************************************/
+
+/* what fd is: an input device (>= 0), /dev/lightsensor (-1), or not ours */
+#define NOT_OURS    -2
+
+static int fake_device(int fd)
+{
+    char link[32], target[PATH_MAX];
+    size_t rootlen = strlen(s_root);
+    ssize_t len;
+    int dev;
+
+    if (!rootlen)
+        return NOT_OURS;
+    snprintf(link, sizeof(link), "/proc/self/fd/%d", fd);
+    len = readlink(link, target, sizeof(target) - 1);
+    if (len < 0)
+        return NOT_OURS;
+    target[len] = '\0';
+    if (strncmp(target, s_root, rootlen))
+        return NOT_OURS;
+    if (sscanf(target + rootlen, "/dev/input/event%d", &dev) == 1)
+        return dev < s_num_inputs ? dev : NOT_OURS;
+    if (!strcmp(target + rootlen, "/dev/lightsensor"))
+        return -1;
+    return NOT_OURS;
+}
+
+static int input_ioctl(struct fake_input *in, unsigned long cmd, void *arg)
+{
+    if (_IOC_TYPE(cmd) == 'E' && _IOC_NR(cmd) == _IOC_NR(EVIOCGNAME(0))) {
+        size_t len = _IOC_SIZE(cmd);
+        size_t n = strlen(in->name) + 1;
+        if (n > len)
+            n = len;
+        memcpy(arg, in->name, n);
+        return n;
+    }
+    if (_IOC_TYPE(cmd) == 'E' && (_IOC_NR(cmd) & ~ABS_MAX) == _IOC_NR(EVIOCGABS(0))) {
+        struct input_absinfo *info = arg;
+        memset(info, 0, sizeof(*info));
+        info->value = in->abs[_IOC_NR(cmd) & ABS_MAX];
+        return 0;
+    }
+    errno = EINVAL;
+    return -1;
+}
+
+static int lightsensor_ioctl(unsigned long cmd, void *arg)
+{
+    if (cmd == LIGHTSENSOR_IOCTL_GET_ENABLED) {
+        *(int *)arg = s_lightsensor_enabled;
+        return 0;
+    }
+    if (cmd == LIGHTSENSOR_IOCTL_ENABLE) {
+        s_lightsensor_enabled = *(int *)arg;
+        return 0;
+    }
+    errno = EINVAL;
+    return -1;
+}
+
+int ioctl(int fd, unsigned long cmd, ...)
+{
+    va_list ap;
+    void *arg;
+    int dev, ret;
+
+    va_start(ap, cmd);
+    arg = va_arg(ap, void *);
+    va_end(ap);
+
+    /* FIONREAD and the like on the FIFOs go to the kernel */
+    dev = fake_device(fd);
+    if (dev == NOT_OURS || (dev >= 0 && _IOC_TYPE(cmd) != 'E'))
+        return syscall(SYS_ioctl, fd, cmd, arg);
+
+    pthread_mutex_lock(&s_lock);
+    ret = dev >= 0 ? input_ioctl(&s_inputs[dev], cmd, arg) : lightsensor_ioctl(cmd, arg);
+    pthread_mutex_unlock(&s_lock);
+    return ret;
+}
+
+int poll(struct pollfd *fds, nfds_t nfds, int timeout)
+{
+    struct timespec ts;
+    int ret;
+
+    ts.tv_sec = timeout / 1000;
+    ts.tv_nsec = (timeout % 1000) * 1000000L;
+    ret = ppoll(fds, nfds, timeout < 0 ? NULL : &ts, NULL);
+    if (timeout != 0 && s_root[0] && !pthread_equal(pthread_self(), s_main))
+        __sync_fetch_and_add(&s_wakeups, 1);
+    return ret;
+}
@@ -0,0 +1,88 @@
+/*
+ * Copyright (C) 2011 The CyanogenMod Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+
+#ifndef _LIGHTS_HARNESS_H_
+#define _LIGHTS_HARNESS_H_
+
+#include <hardware/lights.h>
+
+/*
+ * Runs the lights HAL on a host. harness_init() builds a temporary
+ * $LIGHTS_ROOT with the LED attribute files of leds[], a /dev/lightsensor
+ * and a dev/input directory; the HAL is then opened and driven through its
+ * module methods like the framework would.
+ *
+ * LED attributes are plain files the HAL writes "<value>\n" to at its file
+ * offset, so a file holds every value written, in order. Input devices are
+ * FIFOs standing in for evdev nodes (a host usually has no /dev/uinput we
+ * may use): the harness keeps the write end open, answers EVIOCGNAME and
+ * EVIOCGABS for them, and like evdev replaces a packet that doesn't fit in
+ * a client buffer of HARNESS_EVDEV_BUFFER events by a SYN_DROPPED.
+ *
+ * ioctl() and poll() are defined here. ioctl() answers the requests the HAL
+ * makes on the fake nodes, poll() counts how often a thread of the HAL woke
+ * up from a poll that could sleep.
+ */
+
+#define HARNESS_EVDEV_BUFFER    64
+
+struct input_event;
+
+int harness_init(void);
+void harness_exit(void);
+const char *harness_root(void);
+
+/* open_lights() through HAL_MODULE_INFO_SYM */
+struct light_device_t *harness_open(const char *id);
+int harness_set(struct light_device_t *dev, unsigned color, int flash_mode,
+        int brightness_mode);
+
+/* a dev/input/eventN node answering EVIOCGNAME with name */
+int harness_input_add(const char *name);
+void harness_input_set_abs(int dev, int code, int value);
+/* one packet, stamped with the current time; returns the events queued,
+   0 when the buffer was full and the packet was dropped */
+int harness_input_packet(int dev, const struct input_event *evs, int n);
+int harness_key(int dev, int code, int value);
+int harness_abs(int dev, int code, int value);
+/* events written but not read by the HAL yet, and packets dropped */
+int harness_input_queued(int dev);
+unsigned harness_input_dropped(int dev);
+
+/* writes to /sys/class/leds/<led>/<attr> and the last value written, -1
+   before the first */
+unsigned harness_writes(const char *led, const char *attr);
+int harness_value(const char *led, const char *attr);
+/* the values written, oldest first; returns how many were, at most max */
+int harness_history(const char *led, const char *attr, int *values, int max);
+/* waits up to timeout_ms for the attribute to read value */
+int harness_wait_value(const char *led, const char *attr, int value,
+        int timeout_ms);
+
+/* what /dev/lightsensor was last told by LIGHTSENSOR_IOCTL_ENABLE */
+int harness_lightsensor_enabled(void);
+
+/* blocking poll() returns on threads other than the one that called
+   harness_init() */
+unsigned harness_wakeups(void);
+
+long long harness_now_ms(void);
+long long harness_now_us(void);
+void harness_sleep_ms(int ms);
+
+#endif
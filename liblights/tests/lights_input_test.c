@@ -0,0 +1,202 @@
+/*
+ * Copyright (C) 2011 The CyanogenMod Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+
+/*
+ * Input handling of the lights HAL under load. ev_get_all() is checked on
+ * its own first: it drains several devices in one call, splits what doesn't
+ * fit over the next calls, and after a SYN_DROPPED passes the marker on and
+ * discards the torn packet up to the next SYN_REPORT. Then the events
+ * thread gets key events at 1000 a second, steadily and in bursts, through
+ * fake evdev nodes that drop packets like evdev does when the reader falls
+ * HARNESS_EVDEV_BUFFER events behind; none may be lost.
+ *
+ *   lights_input_test [seconds]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <linux/input.h>
+
+#include "lights_harness.h"
+#include "../events.h"
+
+/*****************************************************************************/
+
+#ifndef SYN_DROPPED
+#define SYN_DROPPED 3
+#endif
+
+#define RATE            1000    /* events a second */
+
+static int sFailures;
+
+#define CHECK(cond, ...) do { \
+        if (!(cond)) { \
+            printf("FAIL: " __VA_ARGS__); \
+            printf("\n"); \
+            sFailures++; \
+        } \
+    } while (0)
+
+static void event(struct input_event *ev, int type, int code, int value)
+{
+    memset(ev, 0, sizeof(*ev));
+    ev->type = type;
+    ev->code = code;
+    ev->value = value;
+}
+
+/* count of events drained, and how many calls it took */
+static int drain(struct input_event *evs, int max, int batch, int *calls)
+{
+    int n, total = 0;
+
+    *calls = 0;
+    while (total < max && (n = ev_get_all(evs + total,
+            batch < max - total ? batch : max - total)) > 0) {
+        total += n;
+        (*calls)++;
+    }
+    return total;
+}
+
+static void checkGetAll(int keys, int touch)
+{
+    struct input_event in[16], out[64];
+    int i, n, calls;
+
+    ev_init();
+
+    /* 2 devices, 3 packets each, in batches smaller than all of it */
+    for (i = 0; i < 3; i++) {
+        harness_key(keys, KEY_MENU, 1);
+        harness_abs(touch, ABS_X, i);
+    }
+    n = drain(out, 64, 5, &calls);
+    CHECK(n == 12, "%d events drained from two devices, want 12", n);
+    CHECK(calls >= 3, "12 events in batches of 5 in %d calls", calls);
+    CHECK(harness_input_queued(keys) == 0 && harness_input_queued(touch) == 0,
+            "events left behind");
+
+    /* a torn packet after an overflow */
+    event(&in[0], EV_SYN, SYN_DROPPED, 0);
+    event(&in[1], EV_ABS, ABS_Y, 7);
+    event(&in[2], EV_SYN, SYN_REPORT, 0);
+    event(&in[3], EV_KEY, KEY_HOME, 1);
+    event(&in[4], EV_SYN, SYN_REPORT, 0);
+    harness_input_packet(keys, in, 5);
+    n = drain(out, 64, 64, &calls);
+    CHECK(n == 3, "%d events after a SYN_DROPPED, want 3", n);
+    CHECK(n == 3 && out[0].type == EV_SYN && out[0].code == SYN_DROPPED &&
+            out[1].type == EV_KEY && out[1].code == KEY_HOME &&
+            out[2].type == EV_SYN && out[2].code == SYN_REPORT,
+            "SYN_DROPPED not passed on, or the torn packet kept");
+
+    /* resync state is per device, and lasts over reads */
+    event(&in[0], EV_SYN, SYN_DROPPED, 0);
+    event(&in[1], EV_ABS, ABS_X, 1);
+    harness_input_packet(touch, in, 2);
+    harness_key(keys, KEY_BACK, 1);
+    n = drain(out, 64, 64, &calls);
+    CHECK(n == 3, "%d events, want SYN_DROPPED and the other device's key", n);
+    harness_abs(touch, ABS_X, 2);
+    harness_abs(touch, ABS_X, 3);
+    n = drain(out, 64, 64, &calls);
+    CHECK(n == 2 && out[0].type == EV_ABS && out[0].value == 3,
+            "%d events after the torn packet ended in the next read, want 2", n);
+
+    ev_exit();
+}
+
+static void deadlineAdd(struct timespec *t, long ns)
+{
+    t->tv_nsec += ns;
+    while (t->tv_nsec >= 1000000000L) {
+        t->tv_nsec -= 1000000000L;
+        t->tv_sec++;
+    }
+}
+
+/* packets of one key event and its SYN_REPORT, burst packets at a time */
+static void flood(const char *what, int keys, int seconds, int burst)
+{
+    const int packets = RATE / 2 * seconds;
+    const long period = 2000000L * burst;     /* ns, RATE events a second */
+    struct timespec next;
+    unsigned dropped = harness_input_dropped(keys);
+    unsigned wakeups = harness_wakeups();
+    int i, j, queued, maxQueued = 0;
+    long long start = harness_now_ms(), took;
+
+    clock_gettime(CLOCK_MONOTONIC, &next);
+    for (i = 0; i < packets; i += burst) {
+        for (j = 0; j < burst; j++)
+            harness_key(keys, KEY_MENU, (i + j) & 1 ? 0 : 1);
+        queued = harness_input_queued(keys);
+        if (queued > maxQueued)
+            maxQueued = queued;
+        deadlineAdd(&next, period);
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+    }
+    took = harness_now_ms() - start;
+    harness_sleep_ms(50);
+
+    dropped = harness_input_dropped(keys) - dropped;
+    wakeups = harness_wakeups() - wakeups;
+    printf("%-20s %6d events in %lld ms, %u packets dropped, at most %d "
+            "unread, %u wakeups\n", what, packets * 2, took, dropped, maxQueued,
+            wakeups);
+    CHECK(dropped == 0, "%s: %u packets dropped", what, dropped);
+    CHECK(harness_input_queued(keys) == 0, "%s: %d events never read", what,
+            harness_input_queued(keys));
+}
+
+int main(int argc, char **argv)
+{
+    const int seconds = argc > 1 ? atoi(argv[1]) : 3;
+    struct light_device_t *buttons, *backlight;
+    int keys, touch;
+
+    if (harness_init() < 0)
+        return 2;
+    keys = harness_input_add("leo-keypad");
+    touch = harness_input_add("leo-touchscreen");
+
+    checkGetAll(keys, touch);
+
+    backlight = harness_open(LIGHT_ID_BACKLIGHT);
+    buttons = harness_open(LIGHT_ID_BUTTONS);
+    if (!backlight || !buttons) {
+        harness_exit();
+        return 2;
+    }
+    harness_set(backlight, 0xffc8c8c8, LIGHT_FLASH_NONE, BRIGHTNESS_MODE_USER);
+    harness_sleep_ms(100);
+
+    flood("steady", keys, seconds > 0 ? seconds : 1, 1);
+    flood("bursts of 16", keys, seconds > 0 ? seconds : 1, 16);
+    CHECK(harness_value("button-backlight", "brightness") == 1,
+            "the key presses didn't light the buttons");
+
+    harness_exit();
+    printf("%s\n", sFailures ? "FAILED" : "PASSED");
+    return sFailures ? 1 : 0;
+}
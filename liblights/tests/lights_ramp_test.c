@@ -0,0 +1,167 @@
+/*
+ * Copyright (C) 2011 The CyanogenMod Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+
+/*
+ * Backlight ramps on a fake sysfs tree: how many times the lcd-backlight
+ * attribute is written for a transition, for a framework animation that
+ * pushes a new level every 10 ms, and for a target changed mid-ramp. The
+ * levels written must head straight for the target, and switching the
+ * panel off or on is a single write.
+ *
+ *   lights_ramp_test
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "lights_harness.h"
+
+/*****************************************************************************/
+
+/* as in lights_leo.c */
+#define RAMP_MS         150
+#define RAMP_MAX_HZ     60
+
+#define MAX_WRITES      1024
+
+static int sFailures;
+
+#define CHECK(cond, ...) do { \
+        if (!(cond)) { \
+            printf("FAIL: " __VA_ARGS__); \
+            printf("\n"); \
+            sFailures++; \
+        } \
+    } while (0)
+
+static struct light_device_t *sBacklight;
+
+static void setBacklight(int level)
+{
+    harness_set(sBacklight, 0xff000000 | (level << 16) | (level << 8) | level,
+            LIGHT_FLASH_NONE, BRIGHTNESS_MODE_USER);
+}
+
+/* the writes since *start, which moves past them */
+static int writesSince(int *start, int *values)
+{
+    int history[MAX_WRITES];
+    int n = harness_history("lcd-backlight", "brightness", history, MAX_WRITES);
+    int i;
+
+    for (i = *start; i < n; i++)
+        values[i - *start] = history[i];
+    n -= *start;
+    *start += n;
+    return n;
+}
+
+/* every level written lies between from and to, and moves towards to */
+static int monotonic(const int *values, int n, int from, int to)
+{
+    int i, prev = from;
+
+    for (i = 0; i < n; i++) {
+        if (to >= from ? (values[i] < prev || values[i] > to)
+                       : (values[i] > prev || values[i] < to))
+            return 0;
+        prev = values[i];
+    }
+    return 1;
+}
+
+static void settle(int level)
+{
+    CHECK(!harness_wait_value("lcd-backlight", "brightness", level, 1000),
+            "backlight at %d, want %d", harness_value("lcd-backlight", "brightness"),
+            level);
+    harness_sleep_ms(50);
+}
+
+int main(int argc, char **argv)
+{
+    int values[MAX_WRITES];
+    int seen = 0, n, i;
+    long long start, took;
+
+    if (harness_init() < 0)
+        return 2;
+    sBacklight = harness_open(LIGHT_ID_BACKLIGHT);
+    if (!sBacklight) {
+        harness_exit();
+        return 2;
+    }
+    setBacklight(200);
+    settle(200);
+    writesSince(&seen, values);
+
+    /* one transition: RAMP_MS at no more than RAMP_MAX_HZ */
+    start = harness_now_ms();
+    setBacklight(50);
+    settle(50);
+    took = harness_now_ms() - start - 50;
+    n = writesSince(&seen, values);
+    printf("200 -> 50:          %3d writes in %lld ms\n", n, took);
+    CHECK(n >= 2 && n <= RAMP_MAX_HZ * RAMP_MS / 1000 + 2,
+            "%d writes for one %d ms ramp", n, RAMP_MS);
+    CHECK(monotonic(values, n, 200, 50), "ramp 200 -> 50 went astray");
+    CHECK(took >= RAMP_MS - 20, "ramp took %lld ms", took);
+
+    /* a framework animation, a level every 10 ms for a second */
+    start = harness_now_ms();
+    for (i = 1; i <= 100; i++) {
+        setBacklight(50 + i * 2);
+        harness_sleep_ms(10);
+    }
+    settle(250);
+    took = harness_now_ms() - start - 50;
+    n = writesSince(&seen, values);
+    printf("animation 50 -> 250: 100 calls, %3d writes in %lld ms\n", n, took);
+    CHECK(n <= took * RAMP_MAX_HZ / 1000 + 2, "%d writes in %lld ms", n, took);
+    CHECK(monotonic(values, n, 50, 250), "animation 50 -> 250 went astray");
+
+    /* retargeted half way: no queued writes towards the old target */
+    setBacklight(30);
+    harness_sleep_ms(RAMP_MS / 2);
+    setBacklight(200);
+    settle(200);
+    n = writesSince(&seen, values);
+    /* where it turned back */
+    for (i = 0; i + 1 < n && values[i + 1] <= values[i]; i++)
+        ;
+    printf("250 -> 30, then 200 half way: %3d writes, turned at %d\n", n,
+            n ? values[i] : -1);
+    CHECK(n <= 2 * (RAMP_MAX_HZ * RAMP_MS / 1000 + 2), "%d writes for a retargeted ramp", n);
+    CHECK(monotonic(values, i + 1, 250, 30) && monotonic(values + i, n - i, values[i], 200),
+            "retargeted ramp went astray");
+    CHECK(n && values[i] > 30, "the ramp reached the old target before turning");
+
+    /* switching the panel off and on isn't ramped */
+    setBacklight(0);
+    n = writesSince(&seen, values);
+    CHECK(n == 1 && values[0] == 0, "panel off took %d writes", n);
+    setBacklight(120);
+    n = writesSince(&seen, values);
+    CHECK(n == 1 && values[0] == 120, "panel on took %d writes", n);
+    harness_sleep_ms(RAMP_MS + 50);
+    CHECK(writesSince(&seen, values) == 0, "writes after the panel came on");
+
+    harness_exit();
+    printf("%s\n", sFailures ? "FAILED" : "PASSED");
+    return sFailures ? 1 : 0;
+}
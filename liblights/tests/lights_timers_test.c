@@ -0,0 +1,322 @@
+/*
+ * Copyright (C) 2011 The CyanogenMod Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+
+/*
+ * The lights timer scheduler on a virtual clock: timers fire in deadline
+ * order (in start order for equal deadlines), never early and exactly once,
+ * stop and restart take effect, callbacks may start timers, and
+ * timers_timeout() is what the events thread sleeps for. A random mix of
+ * starts and stops is checked against a plain array. Last, the timerfd is
+ * checked against the real clock: readable when the head is due, disarmed
+ * when it is stopped.
+ *
+ *   lights_timers_test [operations]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <poll.h>
+#include <time.h>
+
+#include "../timers.h"
+
+/*****************************************************************************/
+
+#define NUM_TIMERS      32
+#define MAX_FIRED       4096
+
+static int sFailures;
+
+#define CHECK(cond, ...) do { \
+        if (!(cond)) { \
+            printf("FAIL: " __VA_ARGS__); \
+            printf("\n"); \
+            sFailures++; \
+        } \
+    } while (0)
+
+static long long sNow;
+
+static long long virtualClock(void)
+{
+    return sNow;
+}
+
+static long long realClock(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+struct fired {
+    int id;
+    long long at;
+};
+
+static struct fired sFired[MAX_FIRED];
+static int sNumFired;
+static struct lights_timer sTimers[NUM_TIMERS];
+
+/* -1 or what the timer does when it fires */
+static int sRestartMs[NUM_TIMERS];
+static int sChain[NUM_TIMERS];
+
+static void onTimer(void *arg)
+{
+    int id = (int)(long)arg;
+
+    if (sNumFired < MAX_FIRED) {
+        sFired[sNumFired].id = id;
+        sFired[sNumFired].at = sNow;
+        sNumFired++;
+    }
+    if (sRestartMs[id] >= 0)
+        timer_start(&sTimers[id], sRestartMs[id]);
+    if (sChain[id] >= 0)
+        timer_start(&sTimers[sChain[id]], 0);
+}
+
+static void reset(void)
+{
+    int i;
+
+    for (i = 0; i < NUM_TIMERS; i++) {
+        timer_stop(&sTimers[i]);
+        sTimers[i].func = onTimer;
+        sTimers[i].arg = (void *)(long)i;
+        sRestartMs[i] = -1;
+        sChain[i] = -1;
+    }
+    sNumFired = 0;
+}
+
+/* moves the clock to t and runs what is due */
+static int runAt(long long t)
+{
+    sNow = t;
+    return timers_run();
+}
+
+static void checkOrder(void)
+{
+    static const int expect[] = { 1, 3, 2, 0 };
+    int i;
+
+    reset();
+    sNow = 1000;
+    timer_start(&sTimers[0], 300);
+    timer_start(&sTimers[1], 100);
+    timer_start(&sTimers[2], 200);
+    timer_start(&sTimers[3], 100);
+    CHECK(timers_timeout() == 100, "timeout %d, want 100", timers_timeout());
+
+    CHECK(runAt(1099) == 0, "a timer fired early");
+    CHECK(timers_timeout() == 1, "timeout %d a ms before, want 1", timers_timeout());
+    CHECK(runAt(1100) == 2, "the two 100 ms timers didn't fire together");
+    CHECK(runAt(1250) == 1, "the 200 ms timer didn't fire alone");
+    CHECK(timers_timeout() == 50, "timeout %d, want 50", timers_timeout());
+    CHECK(runAt(5000) == 1, "the 300 ms timer didn't fire");
+    CHECK(runAt(6000) == 0, "a timer fired twice");
+    CHECK(timers_timeout() == -1, "timeout %d with nothing pending", timers_timeout());
+
+    CHECK(sNumFired == 4, "%d timers fired, want 4", sNumFired);
+    for (i = 0; i < sNumFired && i < 4; i++)
+        CHECK(sFired[i].id == expect[i], "timer %d fired in place %d, want %d",
+                sFired[i].id, i, expect[i]);
+}
+
+static void checkStopRestart(void)
+{
+    reset();
+    sNow = 1000;
+    timer_stop(&sTimers[5]);        /* never started */
+    timer_start(&sTimers[4], 50);
+    CHECK(timer_pending(&sTimers[4]), "started timer not pending");
+    timer_stop(&sTimers[4]);
+    CHECK(!timer_pending(&sTimers[4]), "stopped timer still pending");
+    CHECK(timers_timeout() == -1, "timeout %d after the only timer stopped",
+            timers_timeout());
+
+    /* restarted later: only the new deadline counts */
+    timer_start(&sTimers[4], 100);
+    runAt(1050);
+    timer_start(&sTimers[4], 150);
+    CHECK(runAt(1100) == 0 && runAt(1199) == 0, "restarted timer fired at its old deadline");
+    CHECK(runAt(1200) == 1, "restarted timer didn't fire at its new deadline");
+
+    /* restarted earlier, and a deadline already past */
+    timer_start(&sTimers[4], 500);
+    timer_start(&sTimers[4], 10);
+    CHECK(timers_timeout() == 10, "timeout %d after restarting earlier", timers_timeout());
+    timer_start(&sTimers[5], -5);
+    CHECK(timers_timeout() == 0, "timeout %d with a timer due", timers_timeout());
+    CHECK(runAt(1200) == 1 && runAt(1210) == 1, "due timers didn't fire in turn");
+    CHECK(sNumFired == 3, "%d fired, want 3", sNumFired);
+}
+
+static void checkCallbacks(void)
+{
+    int n;
+
+    reset();
+    sNow = 1000;
+
+    /* the radio poll: restarts itself for a second later */
+    sRestartMs[6] = 1000;
+    timer_start(&sTimers[6], 0);
+    CHECK(runAt(1000) == 1 && runAt(1999) == 0 && runAt(2000) == 1 && runAt(3000) == 1,
+            "a self restarting timer didn't fire once a period");
+    /* and after a long stall it fires once, not once per missed period */
+    CHECK(runAt(11500) == 1, "a self restarting timer caught up after a stall");
+    CHECK(timers_timeout() == 1000, "timeout %d after the stall", timers_timeout());
+    timer_stop(&sTimers[6]);
+    sRestartMs[6] = -1;
+
+    /* a callback starting another one that is due right away */
+    sChain[7] = 8;
+    timer_start(&sTimers[7], 10);
+    n = sNumFired;
+    CHECK(runAt(11510) == 2, "a timer started due by a callback didn't fire in the same run");
+    CHECK(sNumFired == n + 2 && sFired[n].id == 7 && sFired[n + 1].id == 8,
+            "chained timers out of order");
+}
+
+/* starts and stops at random against a model, a few operations per ms */
+static void checkRandom(int operations)
+{
+    long long deadline[NUM_TIMERS];
+    unsigned started[NUM_TIMERS];
+    unsigned seq = 0;
+    int i, j, id, fired, next, first = -1;
+
+    reset();
+    sNow = 100000;
+    memset(deadline, 0, sizeof(deadline));
+    srand(47);
+
+    for (i = 0; i < operations; i++) {
+        id = rand() % NUM_TIMERS;
+        if (rand() % 4) {
+            int delay = rand() % 200;
+            timer_start(&sTimers[id], delay);
+            deadline[id] = sNow + delay;
+            started[id] = seq++;
+        } else {
+            timer_stop(&sTimers[id]);
+            deadline[id] = 0;
+        }
+
+        next = -1;
+        for (j = 0; j < NUM_TIMERS; j++) {
+            if (deadline[j] && (next < 0 || deadline[j] - sNow < next))
+                next = deadline[j] - sNow;
+        }
+        if (timers_timeout() != next) {
+            CHECK(0, "operation %d: timeout %d, want %d", i, timers_timeout(), next);
+            break;
+        }
+
+        /* what is due, in deadline order and start order among equals */
+        sNow += rand() % 3;
+        sNumFired = 0;
+        fired = timers_run();
+        for (j = 0; j < sNumFired; j++) {
+            id = sFired[j].id;
+            if (!deadline[id] || deadline[id] > sNow)
+                break;
+            if (j && (deadline[id] < deadline[first] ||
+                    (deadline[id] == deadline[first] && started[id] < started[first])))
+                break;
+            first = id;
+        }
+        if (j < sNumFired) {
+            CHECK(0, "operation %d: timer %d fired out of turn", i, sFired[j].id);
+            break;
+        }
+        for (j = 0; j < sNumFired; j++)
+            deadline[sFired[j].id] = 0;
+        for (j = 0; j < NUM_TIMERS; j++) {
+            if (deadline[j] && deadline[j] <= sNow)
+                break;
+        }
+        if (j < NUM_TIMERS || fired != sNumFired) {
+            CHECK(0, "operation %d: timer %d due and not fired", i, j);
+            break;
+        }
+    }
+    printf("%d random starts and stops matched the model\n", i);
+}
+
+static int waitReadable(int fd, int timeout_ms)
+{
+    struct pollfd pfd;
+    long long start = realClock();
+
+    pfd.fd = fd;
+    pfd.events = POLLIN;
+    if (poll(&pfd, 1, timeout_ms) <= 0)
+        return -1;
+    return realClock() - start;
+}
+
+static void checkTimerfd(void)
+{
+    int waited;
+
+    reset();
+    timers_exit();
+    timers_init(realClock);
+    CHECK(timers_fd() >= 0, "no timerfd");
+
+    timer_start(&sTimers[9], 40);
+    waited = waitReadable(timers_fd(), 500);
+    printf("timerfd readable %d ms after a 40 ms timer started\n", waited);
+    CHECK(waited >= 35 && waited < 200, "timerfd readable after %d ms", waited);
+    CHECK(timers_run() == 1, "the 40 ms timer didn't fire");
+
+    timer_start(&sTimers[9], 40);
+    timer_stop(&sTimers[9]);
+    CHECK(waitReadable(timers_fd(), 100) < 0, "timerfd fired for a stopped timer");
+
+    /* a later timer behind a stopped head is what it waits for */
+    timer_start(&sTimers[9], 20);
+    timer_start(&sTimers[10], 60);
+    timer_stop(&sTimers[9]);
+    waited = waitReadable(timers_fd(), 500);
+    CHECK(waited >= 55 && waited < 200, "timerfd readable after %d ms, want 60", waited);
+    CHECK(timers_run() == 1, "the 60 ms timer didn't fire");
+    timers_exit();
+}
+
+int main(int argc, char **argv)
+{
+    const int operations = argc > 1 ? atoi(argv[1]) : 100000;
+
+    if (timers_init(virtualClock) < 0)
+        return 2;
+    checkOrder();
+    checkStopRestart();
+    checkCallbacks();
+    checkRandom(operations);
+    checkTimerfd();
+
+    printf("%s\n", sFailures ? "FAILED" : "PASSED");
+    return sFailures ? 1 : 0;
+}
@@ -0,0 +1,200 @@
+/*
+ * Copyright (C) 2011 The CyanogenMod Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "lights_leo"
+
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/timerfd.h>
+
+#include <cutils/log.h>
+
+#include "timers.h"
+
+/*****************************************************************************/
+
+static pthread_mutex_t timers_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct lights_timer *timers_head = NULL;
+static timers_clock_t timers_clock = NULL;
+static int timers_tfd = -1;
+
+static long long monotonic_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/* called with timers_lock held whenever the head of the list changes */
+static void rearm_locked(void)
+{
+    struct itimerspec its;
+    long long delay;
+
+    if (timers_tfd < 0)
+        return;
+
+    memset(&its, 0, sizeof(its));
+    if (timers_head) {
+        delay = timers_head->deadline - timers_clock();
+        if (delay <= 0) {
+            its.it_value.tv_nsec = 1;       /* zero would disarm it */
+        } else {
+            its.it_value.tv_sec = delay / 1000;
+            its.it_value.tv_nsec = (delay % 1000) * 1000000;
+        }
+    }
+    timerfd_settime(timers_tfd, 0, &its, NULL);
+}
+
+static int unlink_locked(struct lights_timer *t)
+{
+    struct lights_timer **p;
+
+    for (p = &timers_head; *p; p = &(*p)->next) {
+        if (*p == t) {
+            *p = t->next;
+            t->next = NULL;
+            t->deadline = 0;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/*****************************************************************************/
+
+int timers_init(timers_clock_t clock)
+{
+    pthread_mutex_lock(&timers_lock);
+    if (clock)
+        timers_clock = clock;
+    else if (!timers_clock)
+        timers_clock = monotonic_ms;
+    if (timers_tfd < 0) {
+        timers_tfd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK);
+        LOGE_IF(timers_tfd < 0, "timerfd_create failed (%s)", strerror(errno));
+    }
+    rearm_locked();
+    pthread_mutex_unlock(&timers_lock);
+    return timers_tfd < 0 ? -errno : 0;
+}
+
+void timers_exit(void)
+{
+    pthread_mutex_lock(&timers_lock);
+    while (timers_head)
+        unlink_locked(timers_head);
+    if (timers_tfd >= 0)
+        close(timers_tfd);
+    timers_tfd = -1;
+    pthread_mutex_unlock(&timers_lock);
+}
+
+int timers_fd(void)
+{
+    return timers_tfd;
+}
+
+long long timers_now(void)
+{
+    return timers_clock ? timers_clock() : monotonic_ms();
+}
+
+void timer_start(struct lights_timer *t, int delay_ms)
+{
+    struct lights_timer **p;
+
+    pthread_mutex_lock(&timers_lock);
+    unlink_locked(t);
+    t->deadline = timers_now() + (delay_ms > 0 ? delay_ms : 0);
+    if (t->deadline == 0)
+        t->deadline = 1;    /* 0 means idle */
+    for (p = &timers_head; *p && (*p)->deadline <= t->deadline; p = &(*p)->next)
+        ;
+    t->next = *p;
+    *p = t;
+    if (timers_head == t)
+        rearm_locked();
+    pthread_mutex_unlock(&timers_lock);
+}
+
+void timer_stop(struct lights_timer *t)
+{
+    int was_head;
+
+    pthread_mutex_lock(&timers_lock);
+    was_head = timers_head == t;
+    if (unlink_locked(t) && was_head)
+        rearm_locked();
+    pthread_mutex_unlock(&timers_lock);
+}
+
+int timer_pending(const struct lights_timer *t)
+{
+    int pending;
+
+    pthread_mutex_lock(&timers_lock);
+    pending = t->deadline != 0;
+    pthread_mutex_unlock(&timers_lock);
+    return pending;
+}
+
+/* ms until the earliest deadline, -1 when nothing is pending (a poll timeout) */
+int timers_timeout(void)
+{
+    long long delay = -1;
+
+    pthread_mutex_lock(&timers_lock);
+    if (timers_head) {
+        delay = timers_head->deadline - timers_now();
+        if (delay < 0)
+            delay = 0;
+        else if (delay > INT32_MAX)
+            delay = INT32_MAX;
+    }
+    pthread_mutex_unlock(&timers_lock);
+    return (int)delay;
+}
+
+/* fires everything that is due, returns how many timers ran */
+int timers_run(void)
+{
+    struct lights_timer *t;
+    uint64_t expirations;
+    long long now;
+    int fired = 0;
+
+    if (timers_tfd >= 0)
+        read(timers_tfd, &expirations, sizeof(expirations));
+
+    pthread_mutex_lock(&timers_lock);
+    now = timers_now();
+    while ((t = timers_head) && t->deadline <= now) {
+        unlink_locked(t);
+        pthread_mutex_unlock(&timers_lock);
+        t->func(t->arg);
+        fired++;
+        pthread_mutex_lock(&timers_lock);
+    }
+    rearm_locked();
+    pthread_mutex_unlock(&timers_lock);
+    return fired;
+}
@@ -0,0 +1,51 @@
+/*
+ * Copyright (C) 2011 The CyanogenMod Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _TIMERS_H_
+#define _TIMERS_H_
+
+// one-shot timers sharing a single CLOCK_MONOTONIC timerfd. The owner polls
+// timers_fd() (or sleeps for timers_timeout() ms) and calls timers_run(),
+// which fires every expired timer on the calling thread without the timer
+// lock held, so a callback may take g_lock or restart itself. Times are in
+// milliseconds of the clock given to timers_init(), CLOCK_MONOTONIC unless
+// a test passes its own. timers_init(NULL) keeps a clock installed earlier,
+// so a test can set one before the HAL's events thread starts.
+
+typedef long long (*timers_clock_t)(void);
+
+struct lights_timer {
+    void (*func)(void *arg);
+    void *arg;
+    long long deadline;             /* 0 while not pending */
+    struct lights_timer *next;      /* deadline ordered */
+};
+
+#define LIGHTS_TIMER_INIT(func, arg)    { func, arg, 0, NULL }
+
+int timers_init(timers_clock_t clock);
+void timers_exit(void);
+int timers_fd(void);
+long long timers_now(void);
+
+void timer_start(struct lights_timer *t, int delay_ms);
+void timer_stop(struct lights_timer *t);
+int timer_pending(const struct lights_timer *t);
+
+int timers_timeout(void);
+int timers_run(void);
+
+#endif
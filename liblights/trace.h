@@ -0,0 +1,54 @@
+/*
+ * Copyright (C) 2011 The CyanogenMod Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _TRACE_H_
+#define _TRACE_H_
+
+// begin/end spans and counters recorded by the shared libhaltrace. Compiled
+// in with LIGHTS_TRACE (see Android.mk) and switched on with "setprop
+// debug.lights.trace 1" before the HAL is opened; while off a trace point
+// is one not-taken branch.
+
+#ifdef LIGHTS_TRACE
+
+#include "haltrace.h"
+
+extern struct hal_trace lights_trace;
+
+#define lights_trace_init()             hal_trace_init(&lights_trace)
+#define LIGHTS_TRACE_BEGIN(name)        do { \
+        if (__builtin_expect(lights_trace.enabled, 0)) \
+            hal_trace_record(&lights_trace, 'B', name, 0); \
+    } while (0)
+#define LIGHTS_TRACE_END()              do { \
+        if (__builtin_expect(lights_trace.enabled, 0)) \
+            hal_trace_record(&lights_trace, 'E', "", 0); \
+    } while (0)
+#define LIGHTS_TRACE_INT(name, value)   do { \
+        if (__builtin_expect(lights_trace.enabled, 0)) \
+            hal_trace_record(&lights_trace, 'C', name, value); \
+    } while (0)
+
+#else
+
+#define lights_trace_init()             ((void)0)
+#define LIGHTS_TRACE_BEGIN(name)        ((void)0)
+#define LIGHTS_TRACE_END()              ((void)0)
+#define LIGHTS_TRACE_INT(name, value)   ((void)0)
+
+#endif
+
+#endif
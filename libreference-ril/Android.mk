@@ -35,3 +35,5 @@ else
   LOCAL_MODULE:= leo-reference-ril
   include $(BUILD_EXECUTABLE)
 endif
+
+include $(call all-makefiles-under,$(LOCAL_PATH))
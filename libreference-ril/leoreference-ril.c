@@ -20,6 +20,7 @@
 
 #include <utils/Log.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <assert.h>
 #include <string.h>
 #include <errno.h>
@@ -29,6 +30,11 @@
 #include <fcntl.h>
 #include <pthread.h>
 #include <alloca.h>
+#include <time.h>
+#include <sys/wait.h>
+#include <sys/sysmacros.h>
+#include <limits.h>
+#include <signal.h>
 
 #include "misc.h"
 #include <getopt.h>
@@ -36,6 +42,7 @@
 #include <cutils/sockets.h>
 #include <termios.h>
 #include <utils/Log.h>
+#include <private/android_filesystem_config.h>
 
 #define LOG_TAG "RILW"
 
@@ -51,6 +58,24 @@
 
 #define PPP_TTY_PATH "/dev/ppp0"
 
+/*
+ * Everything the shim touches outside of the AT channel given with -d. All
+ * of them are opened through rootedPath(), so a host test build (with
+ * RIL_HOST_TEST) given $RIL_ROOT runs against the stub libhtc_ril, stub
+ * pppd and pty modem of tests/.
+ */
+#define VENDOR_RIL_PATH     "/system/lib/libhtc_ril.so"
+#define PPPD_PATH           "/bin/pppd"
+#define PPPD_DATA_TTY       "/dev/smd1"
+#define PPP_DEVICE_PATH     "/dev/ppp"
+#define PPP_CONFIG_DIR      "/etc/ppp"
+
+#define PPP_OPTIONS_PATH    PPP_CONFIG_DIR "/options.smd"
+/* per-tty options file pppd reads after the command line, we no longer
+   generate it */
+#define PPP_TTY_OPTIONS_PATH PPP_CONFIG_DIR "/options.smd1"
+#define PPP_PID_PATH        PPP_CONFIG_DIR "/ppp0.pid"
+
 #define AT_ERROR_GENERIC -1
 #define AT_ERROR_COMMAND_PENDING -2
 #define AT_ERROR_CHANNEL_CLOSED -3
@@ -62,10 +87,28 @@
                                         did not get back an intermediate
                                         response */
 
+/* a cached registration state is answered from memory for at most this long,
+   even if the vendor library never reports a network state change */
+#define REG_CACHE_MAX_AGE_MS 30000
+
+/* size of the request routing table, requests above it are passed through */
+#define RIL_ROUTE_MAX 128
+
+/* requests whose synchronous part takes longer than this are logged */
+#define SLOW_REQUEST_MS 500
+
+/* abstract local socket serving a text dump of the metrics below */
+#define METRICS_SOCKET_NAME "rilw-metrics"
+
+/* latency histograms use power of two millisecond buckets: [0,1) [1,2)
+   [2,4) ... with the last one catching everything above 2^(n-2) ms */
+#define LATENCY_BUCKETS 16
+
 void (*libhtc_ril_onRequest)(int request, void *data, size_t datalen, RIL_Token t);
 
 static const char * s_device_path = NULL;
 static const struct RIL_Env *s_rilenv;
+static struct RIL_Env s_vendor_env;  /* env handed to libhtc_ril, see RIL_Init */
 static void *ril_handler=NULL;
 
 static int s_fd = -1;    /* fd of the AT channel */
@@ -74,11 +117,71 @@ static const char * getVersion(void) {
     return "android leo-reference-ril 1.0";
 }
 
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++=
+/*
+ * Metrics, served on the METRICS_SOCKET_NAME socket.
+ *
+ * Everything is updated under s_metrics_lock, which is only ever held for a
+ * few increments; the metrics thread copies a snapshot before formatting.
+ */
+struct latency_hist {
+  unsigned count;
+  unsigned long long total_us;
+  unsigned max_us;
+  unsigned buckets[LATENCY_BUCKETS];
+};
+
+struct modem_metrics {
+  struct latency_hist at;         /* AT command write to final result */
+  unsigned at_timeouts;
+  unsigned long long bytes_written;
+  unsigned long long bytes_read;
+  struct latency_hist ppp_setup;    /* pppd start until it detaches */
+  struct latency_hist ppp_teardown; /* until ppp0.pid disappears */
+  unsigned ppp_setup_failures;
+  unsigned ppp_teardown_failures;
+};
+
+static pthread_mutex_t s_metrics_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct modem_metrics s_modem_metrics;
+
+static long long now_us(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (long long)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static long long now_ms(void) {
+  return now_us() / 1000;
+}
+
+/* callers hold s_metrics_lock */
+static void hist_add(struct latency_hist *h, unsigned us) {
+  unsigned ms = us / 1000;
+  int b = 0;
+
+  while (ms && b < LATENCY_BUCKETS - 1) {
+    ms >>= 1;
+    b++;
+  }
+  h->buckets[b]++;
+  h->count++;
+  h->total_us += us;
+  if (us > h->max_us)
+    h->max_us = us;
+}
+
+static void metrics_add_bytes(unsigned long long *counter, size_t n) {
+  pthread_mutex_lock(&s_metrics_lock);
+  *counter += n;
+  pthread_mutex_unlock(&s_metrics_lock);
+}
+
 //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++=
 void  AT_DUMP(const char*  prefix, const char*  buff, int  len) {
     if (len < 0)
         len = strlen(buff);
-    D("%.*s", len, buff);
+    D("%s%.*s", prefix, len, buff);
 }
 //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++=
 static int at_writeline (const char *s) {
@@ -104,6 +207,7 @@ static int at_writeline (const char *s) {
 
         cur += written;
     }
+    metrics_add_bytes(&s_modem_metrics.bytes_written, len);
 
     /* the \r  */
 
@@ -114,6 +218,7 @@ static int at_writeline (const char *s) {
     if (written < 0) {
         return AT_ERROR_GENERIC;
     }
+    metrics_add_bytes(&s_modem_metrics.bytes_written, 1);
 
     //D("AT> %s", "sent");
 
@@ -127,6 +232,9 @@ static int at_command(char *cmd, int to)
 
     char buf[1024];
     int sel, len, i, err;
+    int used = 0;
+    int done = 0;
+    long long start = now_us();
 
     err=at_writeline(cmd);
     if (err != 0 ) {
@@ -141,20 +249,32 @@ static int at_command(char *cmd, int to)
                 timeout.tv_usec = to;
                 if ((sel = select(s_fd + 1, &rfds, NULL, NULL, &timeout)) > 0) {
                         if (FD_ISSET(s_fd, &rfds)) {
-                                memset(buf, 0, sizeof(buf));
-                                len = read(s_fd, buf, sizeof(buf));
+                                /* the modem may split a result code over
+                                   reads, match against everything so far
+                                   and keep the tail when the buffer fills */
+                                if (used > (int)sizeof(buf) / 2) {
+                                        memmove(buf, buf + used - 16, 16);
+                                        used = 16;
+                                }
+                                len = read(s_fd, buf + used, sizeof(buf) - 1 - used);
                                 if (len> 0) {
-                                	D("%d: %s", len, buf);
+                                	metrics_add_bytes(&s_modem_metrics.bytes_read, len);
+                                	D("%d: %.*s", len, len, buf + used);
+                                	used += len;
+                                	buf[used] = '\0';
                                 	if (strstr(buf, "\r\nOK") != NULL){
 						D("  > OK");
+                                        	done = 1;
                                         	break;
                                 	}
                                 	if (strstr(buf, "\r\nERROR") != NULL){
 						D("  > ERROR");
+                                        	done = 1;
                                         	break;
                                 	}
                                 	if (strstr(buf, "\r\nCONNECT") != NULL){
 						D("  > CONNECT");
+                                        	done = 1;
                                         	break;
                                 	}
                                 }
@@ -165,6 +285,12 @@ static int at_command(char *cmd, int to)
                 }
     }
 
+   pthread_mutex_lock(&s_metrics_lock);
+   hist_add(&s_modem_metrics.at, now_us() - start);
+   if (!done)
+       s_modem_metrics.at_timeouts++;
+   pthread_mutex_unlock(&s_metrics_lock);
+
    return 0;
 
 error:
@@ -236,26 +362,210 @@ int open_modem () {
 }
 #endif
 //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++=
+/*
+ * Registration state cache.
+ *
+ * The framework polls RIL_REQUEST_REGISTRATION_STATE and
+ * RIL_REQUEST_GPRS_REGISTRATION_STATE every time anything changes on the
+ * phone. The answer only changes when the modem says so, so we snapshot the
+ * vendor response as it goes through RIL_onRequestComplete and answer later
+ * polls from memory until a network/radio state indication (or a request
+ * that changes the registration) invalidates it.
+ */
+enum {
+  REG_CS = 0,   /* RIL_REQUEST_REGISTRATION_STATE */
+  REG_PS,       /* RIL_REQUEST_GPRS_REGISTRATION_STATE */
+  NUM_REG_CACHES
+};
+
+struct reg_cache {
+  int valid;
+  unsigned generation;      /* bumped on every invalidation */
+  RIL_Token pending;        /* last request forwarded to refill the entry */
+  unsigned pending_gen;
+  char **response;          /* pointer table followed by the strings */
+  size_t responselen;
+  long long stamp_ms;
+  unsigned hits;
+  unsigned misses;
+};
+
+static pthread_mutex_t s_reg_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct reg_cache s_reg_cache[NUM_REG_CACHES];
+
+static int reg_cache_index(int request) {
+  switch (request) {
+  case RIL_REQUEST_REGISTRATION_STATE:
+    return REG_CS;
+  case RIL_REQUEST_GPRS_REGISTRATION_STATE:
+    return REG_PS;
+  }
+  return -1;
+}
+
+/* copy a char ** response into a single block so it can be freed at once */
+static char **dup_string_response(char **response, size_t responselen) {
+  size_t count = responselen / sizeof(char *);
+  size_t size = responselen;
+  size_t i;
+  char **copy;
+  char *p;
+
+  for (i = 0; i < count; i++) {
+    if (response[i])
+      size += strlen(response[i]) + 1;
+  }
+  copy = malloc(size ? size : 1);
+  if (copy == NULL)
+    return NULL;
+
+  p = (char *)(copy + count);
+  for (i = 0; i < count; i++) {
+    if (response[i]) {
+      strcpy(p, response[i]);
+      copy[i] = p;
+      p += strlen(p) + 1;
+    } else {
+      copy[i] = NULL;
+    }
+  }
+  return copy;
+}
+
+static void reg_cache_invalidate_locked(struct reg_cache *c) {
+  free(c->response);
+  c->response = NULL;
+  c->responselen = 0;
+  c->valid = 0;
+  c->generation++;
+}
+
+static void reg_cache_invalidate_all(const char *why) {
+  int i;
+
+  pthread_mutex_lock(&s_reg_lock);
+  for (i = 0; i < NUM_REG_CACHES; i++) {
+    reg_cache_invalidate_locked(&s_reg_cache[i]);
+  }
+  pthread_mutex_unlock(&s_reg_lock);
+  D("%s: %s", __func__, why);
+}
+
+/*
+ * Called for every completion coming out of libhtc_ril, snapshots the answer
+ * if t is the request we forwarded to refill a cache entry.
+ */
+static void reg_cache_complete(RIL_Token t, RIL_Errno e, void *response,
+                               size_t responselen) {
+  struct reg_cache *c;
+  int i;
+
+  pthread_mutex_lock(&s_reg_lock);
+  for (i = 0; i < NUM_REG_CACHES; i++) {
+    c = &s_reg_cache[i];
+    if (c->pending != t)
+      continue;
+    c->pending = NULL;
+    /* an invalidation raced with the request, don't keep a stale answer */
+    if (e != RIL_E_SUCCESS || c->pending_gen != c->generation)
+      break;
+    free(c->response);
+    c->response = dup_string_response(response, responselen);
+    c->responselen = c->response ? responselen : 0;
+    c->valid = c->response != NULL;
+    c->stamp_ms = now_ms();
+    break;
+  }
+  pthread_mutex_unlock(&s_reg_lock);
+}
+
+static void vendorOnRequestComplete(RIL_Token t, RIL_Errno e, void *response,
+                                    size_t responselen) {
+  reg_cache_complete(t, e, response, responselen);
+  s_rilenv->OnRequestComplete(t, e, response, responselen);
+}
+
+static void vendorOnUnsolicitedResponse(int unsolResponse, const void *data,
+                                        size_t datalen) {
+  switch (unsolResponse) {
+  case RIL_UNSOL_RESPONSE_RADIO_STATE_CHANGED:
+  case RIL_UNSOL_RESPONSE_NETWORK_STATE_CHANGED:
+  case RIL_UNSOL_RESTRICTED_STATE_CHANGED:
+  case RIL_UNSOL_DATA_CALL_LIST_CHANGED:
+    reg_cache_invalidate_all("unsolicited state change");
+    break;
+  }
+  s_rilenv->OnUnsolicitedResponse(unsolResponse, data, datalen);
+}
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++=
 static void requestRegistrationState(int request, void *data,
                                         size_t datalen, RIL_Token t) {
-
-  D("%s", __func__);
-  if (request == RIL_REQUEST_REGISTRATION_STATE) {
-     D("### RIL_REQUEST_REGISTRATION_STATE");
-  } else if (request == RIL_REQUEST_GPRS_REGISTRATION_STATE) {
-     D("### RIL_REQUEST_GPRS_REGISTRATION_STATE");
+  struct reg_cache *c = &s_reg_cache[reg_cache_index(request)];
+  char **response = NULL;
+  size_t responselen = 0;
+  unsigned hits, misses;
+
+  pthread_mutex_lock(&s_reg_lock);
+  if (c->valid && now_ms() - c->stamp_ms > REG_CACHE_MAX_AGE_MS) {
+    reg_cache_invalidate_locked(c);
+  }
+  if (c->valid) {
+    /* hand the framework a private copy, the cache may change under us */
+    response = dup_string_response(c->response, c->responselen);
+    responselen = c->responselen;
+  }
+  if (response) {
+    c->hits++;
+  } else {
+    c->misses++;
+    /* the latest miss refills the cache, so a request the vendor never
+       completes can't wedge it */
+    c->pending = t;
+    c->pending_gen = c->generation;
+  }
+  hits = c->hits;
+  misses = c->misses;
+  pthread_mutex_unlock(&s_reg_lock);
+
+  if (response) {
+    D("%s: %s from cache (hits %u, misses %u)", __func__,
+      request == RIL_REQUEST_REGISTRATION_STATE ? "REGISTRATION_STATE" :
+      "GPRS_REGISTRATION_STATE", hits, misses);
+    RIL_onRequestComplete(t, RIL_E_SUCCESS, response, responselen);
+    free(response);
+    return;
   }
-  libhtc_ril_onRequest(request, data, datalen, t);
 
-  D("%s:%.*s", __func__ , datalen, (char *)data);
-  return;
+  libhtc_ril_onRequest(request, data, datalen, t);
 }
 //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++=
+/* SIGTERM the pppd named in the pid file open on fd, a pid file whose
+   process is gone is stale and removed */
+static void ppp_signal(int fd, const char *path) {
+  char buf[16];
+  ssize_t n;
+  pid_t pid;
+
+  n = read(fd, buf, sizeof(buf) - 1);
+  if (n <= 0)
+    return;     /* pppd is still writing it */
+  buf[n] = '\0';
+  pid = atoi(buf);
+  if (pid <= 0)
+    return;
+  if (kill(pid, SIGTERM) < 0 && errno == ESRCH) {
+    LOGW("%s names pid %d which is gone, removing it", path, pid);
+    unlink(path);
+  }
+}
+
 void requestDeactivateDataCall(void *data, size_t datalen, RIL_Token t)
 {
   int ret, err;
   char * cmd;
   char * cid;
+  char buf[PATH_MAX];
+  const char *pid_path;
   int fd;
 
   open_modem();
@@ -268,16 +578,27 @@ void requestDeactivateDataCall(void *data, size_t datalen, RIL_Token t)
   err = at_command(cmd, 10000);
   free(cmd);
 
+  long long start = now_us();
   int i=0;
   i=0;
-  while((fd = open("/etc/ppp/ppp0.pid",O_RDONLY)) > 0) {
-	if(i%5 == 0) system("killall pppd");
+  pid_path = rootedPath(buf, sizeof(buf), PPP_PID_PATH);
+  while((fd = open(pid_path,O_RDONLY)) > 0) {
+	if(i%5 == 0) ppp_signal(fd, pid_path);
 	close(fd);
-	if(i>25) goto error;
+	if(i>25) break;
 	i++;
 	sleep(1);
   }
 
+  /* failed teardowns are timed too, they are the slow ones */
+  pthread_mutex_lock(&s_metrics_lock);
+  hist_add(&s_modem_metrics.ppp_teardown, now_us() - start);
+  if (fd > 0)
+    s_modem_metrics.ppp_teardown_failures++;
+  pthread_mutex_unlock(&s_metrics_lock);
+  if (fd > 0)
+    goto error;
+
   close_modem();
 
   D("%s: RIL_E_SUCCESS ", __func__);
@@ -290,31 +611,257 @@ void requestDeactivateDataCall(void *data, size_t datalen, RIL_Token t)
   RIL_onRequestComplete(t, RIL_E_GENERIC_FAILURE, NULL, 0);
 }
 //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++=
+/*
+ * PPP configuration.
+ *
+ * options.smd is read and cleaned up once; every data call then gets its own
+ * copy with the credentials appended, fed to pppd through a pipe
+ * ("file /proc/self/fd/N") rather than rewriting files under /etc/ppp.
+ * Only a successful read is cached, a call made while the file can't be read
+ * fails and the next one tries again.
+ */
+static pthread_mutex_t s_ppp_options_lock = PTHREAD_MUTEX_INITIALIZER;
+static char *s_ppp_options = NULL;     /* set once, never changed after */
+static size_t s_ppp_options_len = 0;
+
+/* pipes hold at least this much since 2.6.11, older kernels only a page */
+#define PPP_PIPE_SIZE 65536
+
+/* per-call directives, we always supply our own */
+static int ppp_option_is_per_call(const char *line, size_t len) {
+  static const char * const keys[] = { "user", "password", "file" };
+  size_t i, klen;
+
+  for (i = 0; i < sizeof(keys) / sizeof(keys[0]); i++) {
+    klen = strlen(keys[i]);
+    if (len >= klen && strncmp(line, keys[i], klen) == 0 &&
+        (len == klen || line[klen] == ' ' || line[klen] == '\t'))
+      return 1;
+  }
+  return 0;
+}
+
+/* called with s_ppp_options_lock held, returns 0 once the options are cached */
+static int load_ppp_options_locked(void) {
+  char *raw = NULL, *tmp, *options = NULL;
+  size_t size = 0, cap = 0, len = 0;
+  ssize_t n;
+  int fd;
+  const char *line, *eol, *end;
+  const char *path;
+  char buf[PATH_MAX];
+
+  if (s_ppp_options != NULL)
+    return 0;
+
+  path = rootedPath(buf, sizeof(buf), PPP_OPTIONS_PATH);
+  fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    LOGE("could not open %s: %s", path, strerror(errno));
+    return -1;
+  }
+  for (;;) {
+    if (size == cap) {
+      cap = cap ? cap * 2 : 1024;
+      tmp = realloc(raw, cap);
+      if (tmp == NULL)
+        goto out;
+      raw = tmp;
+    }
+    n = read(fd, raw + size, cap - size);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n < 0) {
+      LOGE("could not read %s: %s", path, strerror(errno));
+      goto out;
+    }
+    if (n == 0)
+      break;
+    size += n;
+  }
+
+  /* keep one directive per line, drop comments, blanks and anything we
+     set per call; the result is never larger than the input */
+  options = malloc(size + 1);
+  if (options == NULL)
+    goto out;
+  end = raw + size;
+  for (line = raw; line < end; line = eol + 1) {
+    eol = memchr(line, '\n', end - line);
+    if (eol == NULL)
+      eol = end;
+    while (line < eol && (*line == ' ' || *line == '\t'))
+      line++;
+    n = eol - line;
+    while (n > 0 && (line[n - 1] == ' ' || line[n - 1] == '\t' ||
+                     line[n - 1] == '\r'))
+      n--;
+    if (n == 0 || *line == '#' || ppp_option_is_per_call(line, n))
+      continue;
+    memcpy(options + len, line, n);
+    len += n;
+    options[len++] = '\n';
+  }
+  D("%s: %u bytes of options cached", __func__, (unsigned)len);
+
+  /* a per-tty file left over from older builds would override our user */
+  unlink(rootedPath(buf, sizeof(buf), PPP_TTY_OPTIONS_PATH));
+
+  s_ppp_options = options;
+  s_ppp_options_len = len;
+  options = NULL;
+
+ out:
+  free(options);
+  free(raw);
+  close(fd);
+  return s_ppp_options != NULL ? 0 : -1;
+}
+
+/* append a pppd option word, quoted so any character survives */
+static int ppp_append_word(char *buf, size_t size, size_t *len,
+                           const char *key, const char *value) {
+  size_t l = *len;
+
+  if (l + strlen(key) + 2 >= size)
+    return -1;
+  l += sprintf(buf + l, "%s \"", key);
+  for (; *value; value++) {
+    if (l + 4 >= size)
+      return -1;
+    if (*value == '"' || *value == '\\')
+      buf[l++] = '\\';
+    buf[l++] = *value;
+  }
+  buf[l++] = '"';
+  buf[l++] = '\n';
+  *len = l;
+  return 0;
+}
+
+/* write all of buf, the pipe is large enough that this never blocks */
+static int ppp_write_all(int fd, const char *p, size_t left) {
+  ssize_t n;
+
+  while (left) {
+    n = write(fd, p, left);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      return -1;
+    p += n;
+    left -= n;
+  }
+  return 0;
+}
+
+/*
+ * Returns the read end of a pipe holding the options for this call, or -1.
+ * The pipe is filled and its write end closed before pppd is started, so
+ * pppd sees a complete file.
+ */
+static int ppp_options_pipe(const char *user, const char *pass) {
+  char *creds;
+  size_t credslen = 0, credssize;
+  int fds[2];
+  int err;
+
+  pthread_mutex_lock(&s_ppp_options_lock);
+  err = load_ppp_options_locked();
+  pthread_mutex_unlock(&s_ppp_options_lock);
+  if (err)
+    return -1;
+
+  /* every character may need a backslash, plus the keys and quotes */
+  credssize = 2 * ((user ? strlen(user) : 0) + (pass ? strlen(pass) : 0)) + 32;
+  creds = malloc(credssize);
+  if (creds == NULL)
+    return -1;
+  if (user)
+    ppp_append_word(creds, credssize, &credslen, "user", user);
+  if (pass)
+    ppp_append_word(creds, credssize, &credslen, "password", pass);
+
+  /* the write end is filled before pppd runs, it must not block */
+  if (s_ppp_options_len + credslen > PPP_PIPE_SIZE) {
+    LOGE("pppd options are %u bytes, more than the %u a pipe holds",
+         (unsigned)(s_ppp_options_len + credslen), PPP_PIPE_SIZE);
+    goto error;
+  }
+  if (pipe(fds) < 0) {
+    LOGE("could not create the pppd options pipe: %s", strerror(errno));
+    goto error;
+  }
+  if (ppp_write_all(fds[1], s_ppp_options, s_ppp_options_len) ||
+      ppp_write_all(fds[1], creds, credslen)) {
+    LOGE("could not write the pppd options: %s", strerror(errno));
+    close(fds[0]);
+    close(fds[1]);
+    goto error;
+  }
+  close(fds[1]);
+  free(creds);
+  return fds[0];
+
+ error:
+  free(creds);
+  return -1;
+}
+
+/* run pppd on the data channel, returns its exit status like system() */
+static int start_pppd(int options_fd) {
+  char options_path[32];
+  char pppd_buf[PATH_MAX], tty_buf[PATH_MAX];
+  const char *pppd = rootedPath(pppd_buf, sizeof(pppd_buf), PPPD_PATH);
+  const char *tty = rootedPath(tty_buf, sizeof(tty_buf), PPPD_DATA_TTY);
+  char *argv[] = { (char *)pppd, (char *)tty, "debug", "defaultroute",
+                   "file", options_path, NULL };
+  pid_t pid;
+  int status;
+
+  snprintf(options_path, sizeof(options_path), "/proc/self/fd/%d", options_fd);
+
+  pid = fork();
+  if (pid < 0)
+    return -1;
+  if (pid == 0) {
+    execv(pppd, argv);
+    _exit(127);
+  }
+  while (waitpid(pid, &status, 0) < 0) {
+    if (errno != EINTR)
+      return -1;
+  }
+  return status;
+}
+
 static void requestSetupDataCall(char **data, size_t datalen, RIL_Token t) {
   const char *apn;
   char *user = NULL;
   char *pass = NULL;
   char *cmd;
-  char *userpass;
   int err;
-  int fd;
-  FILE *cfg;
-  char *buffer;
-  long buffSize, len;
+  int options_fd;
+  long long start;
   char *response[2] = { "1", "ppp0" };
+  char buf[PATH_MAX];
+  const char *ppp_path;
 
   int status;
-  int ret;
 
   D("%s", __func__);
 
   /* check if /dev/ppp exists else pppd will be fail*/
-  int fd_ppp = open ("/dev/ppp", O_RDWR);
+  ppp_path = rootedPath(buf, sizeof(buf), PPP_DEVICE_PATH);
+  int fd_ppp = open (ppp_path, O_RDWR);
   if (fd_ppp == -1)  {
-    system("mknod /dev/ppp c 108 0");
-    fd_ppp = open ("/dev/ppp", O_RDWR);
-    if (fd_ppp == -1) LOGE("Error opening /dev/ppp");
+    if (mknod(ppp_path, S_IFCHR | 0666, makedev(108, 0)) < 0)
+      LOGE("mknod %s: %s", ppp_path, strerror(errno));
+    fd_ppp = open (ppp_path, O_RDWR);
+    if (fd_ppp == -1) LOGE("Error opening %s", ppp_path);
   }
+  if (fd_ppp >= 0)
+    close(fd_ppp);
 
   open_modem();
  
@@ -349,63 +896,26 @@ static void requestSetupDataCall(char **data, size_t datalen, RIL_Token t) {
   err = at_command("ATD*99***1#", 10000);
 
   //err = at_command("ATD*99#", 1);
- 
-  asprintf(&userpass, "%s * %s", user, pass);
-  len = strlen(userpass);
-  fd = open("/etc/ppp/pap-secrets",O_WRONLY);
-  if(fd < 0) {
-    D("could not open /etc/ppp/pap-secrets");
-    goto error;
-  }
-  write(fd, userpass, len);
-  close(fd);
 
-  fd = open("/etc/ppp/chap-secrets",O_WRONLY);
-  if(fd < 0) {
-    D("could not open /etc/ppp/chap-secrets");
+  options_fd = ppp_options_pipe(user, pass);
+  if (options_fd < 0) {
+    D("could not build pppd options");
     goto error;
   }
-  write(fd, userpass, len);
-  close(fd);
-  free(userpass);
 
-  cfg = fopen("/etc/ppp/options.smd","r");
-  if(!cfg) {
-    D("could not open /etc/ppp/options.smd");
-    goto error;
-  }
-
-  //filesize
-  fseek(cfg, 0, SEEK_END);
-  buffSize = ftell(cfg);
-  rewind(cfg);
-
-  //allocate memory
-  buffer = (char *) malloc (sizeof(char)*buffSize);
-  if (buffer == NULL) {
-    goto error;
-  }
-
-  //read in the original file
-  len = fread (buffer,1,buffSize,cfg);
-  if (len != buffSize) {
-     D("could not set cfg");
-    goto error;
-  }
-  fclose(cfg);
-
-  cfg = fopen("/etc/ppp/options.smd1","w");
-  fwrite(buffer,1,buffSize,cfg);
-  fprintf(cfg,"user %s",user);
-  fclose(cfg);
-  free(buffer);
-
-  status = system("/bin/pppd /dev/smd1 debug defaultroute");
+  start = now_us();
+  status = start_pppd(options_fd);
+  close(options_fd);
+  pthread_mutex_lock(&s_metrics_lock);
+  hist_add(&s_modem_metrics.ppp_setup, now_us() - start);
+  if (status != 0)
+    s_modem_metrics.ppp_setup_failures++;
+  pthread_mutex_unlock(&s_metrics_lock);
   if (status == 0) {
     sleep(5); // allow time for ip-up to run
     /*system("/system/bin/log -t pppd -c1 www.google.com");*/
   } else {
-    LOGE("/bin/pppd failed, status: %d", status);
+    LOGE("pppd failed, status: %d", status);
     goto error;
   }
 
@@ -428,18 +938,192 @@ static void requestSetupDataCall(char **data, size_t datalen, RIL_Token t) {
   RIL_onRequestComplete(t, RIL_E_GENERIC_FAILURE, NULL, 0);
 }
 //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++=
+/*
+ * Request routing.
+ *
+ * Every request id below RIL_ROUTE_MAX has a slot telling onRequest whether
+ * we handle it ourselves, answer it from a cache, or hand it to libhtc_ril,
+ * together with a histogram of the time spent in onRequest for it.
+ */
+enum {
+  ROUTE_PASS = 0,     /* straight to libhtc_ril */
+  ROUTE_INTERCEPT,    /* handled (or pre-processed) by the shim */
+  ROUTE_CACHED,       /* may be answered from a cache */
+};
+
+typedef void (*ril_handler_t)(int request, void *data, size_t datalen, RIL_Token t);
+
+struct ril_route {
+  int kind;
+  ril_handler_t handler;  /* NULL: libhtc_ril_onRequest */
+  struct latency_hist latency;  /* under s_metrics_lock */
+};
+
+static void onSetupDataCall(int request, void *data, size_t datalen, RIL_Token t) {
+  reg_cache_invalidate_all("data call setup");
+  requestSetupDataCall(data, datalen, t);
+}
+
+static void onDeactivateDataCall(int request, void *data, size_t datalen, RIL_Token t) {
+  reg_cache_invalidate_all("data call teardown");
+  requestDeactivateDataCall(data, datalen, t);
+}
+
+static void onNetworkConfiguration(int request, void *data, size_t datalen, RIL_Token t) {
+  reg_cache_invalidate_all("network configuration request");
+  libhtc_ril_onRequest(request, data, datalen, t);
+}
+
+static struct ril_route s_routes[RIL_ROUTE_MAX] = {
+  [RIL_REQUEST_SETUP_DATA_CALL]      = { ROUTE_INTERCEPT, onSetupDataCall },
+  [RIL_REQUEST_DEACTIVATE_DATA_CALL] = { ROUTE_INTERCEPT, onDeactivateDataCall },
+  [RIL_REQUEST_REGISTRATION_STATE]      = { ROUTE_CACHED, requestRegistrationState },
+  [RIL_REQUEST_GPRS_REGISTRATION_STATE] = { ROUTE_CACHED, requestRegistrationState },
+  [RIL_REQUEST_RADIO_POWER]                    = { ROUTE_INTERCEPT, onNetworkConfiguration },
+  [RIL_REQUEST_SET_NETWORK_SELECTION_AUTOMATIC] = { ROUTE_INTERCEPT, onNetworkConfiguration },
+  [RIL_REQUEST_SET_NETWORK_SELECTION_MANUAL]   = { ROUTE_INTERCEPT, onNetworkConfiguration },
+  [RIL_REQUEST_SET_PREFERRED_NETWORK_TYPE]     = { ROUTE_INTERCEPT, onNetworkConfiguration },
+  [RIL_REQUEST_SET_BAND_MODE]                  = { ROUTE_INTERCEPT, onNetworkConfiguration },
+};
+
 void onRequest(int request, void *data, size_t datalen, RIL_Token t) {
-        switch (request) {
-        case RIL_REQUEST_SETUP_DATA_CALL:
-            return requestSetupDataCall(data, datalen, t);
-        case RIL_REQUEST_DEACTIVATE_DATA_CALL:
-            return requestDeactivateDataCall(data, datalen, t);
-        case RIL_REQUEST_REGISTRATION_STATE:
-        case RIL_REQUEST_GPRS_REGISTRATION_STATE:
-            return requestRegistrationState(request, data, datalen, t);           
-        default:
+        struct ril_route *route;
+        long long start;
+        unsigned us, count;
+        unsigned long long total_us;
+
+        if ((unsigned)request >= RIL_ROUTE_MAX) {
 	    return libhtc_ril_onRequest(request, data, datalen, t);
-	}
+        }
+
+        route = &s_routes[request];
+        start = now_us();
+        if (route->handler) {
+            route->handler(request, data, datalen, t);
+        } else {
+            libhtc_ril_onRequest(request, data, datalen, t);
+        }
+        us = now_us() - start;
+
+        pthread_mutex_lock(&s_metrics_lock);
+        hist_add(&route->latency, us);
+        count = route->latency.count;
+        total_us = route->latency.total_us;
+        pthread_mutex_unlock(&s_metrics_lock);
+
+        if (us > SLOW_REQUEST_MS * 1000) {
+            LOGW("request %d (route %d) took %u ms, average %llu us over %u",
+                 request, route->kind, us / 1000, total_us / count, count);
+        }
+}
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++=
+static void dump_hist(FILE *out, const char *name, const struct latency_hist *h) {
+  int b;
+
+  fprintf(out, "%s count %u avg_us %llu max_us %u ms_log2", name, h->count,
+          h->count ? h->total_us / h->count : 0, h->max_us);
+  for (b = 0; b < LATENCY_BUCKETS; b++) {
+    fprintf(out, " %u", h->buckets[b]);
+  }
+  fputc('\n', out);
+}
+
+static void dump_metrics(FILE *out) {
+  static struct latency_hist routes[RIL_ROUTE_MAX];
+  static const char * const kinds[] = { "pass", "intercept", "cached" };
+  struct modem_metrics modem;
+  char name[32];
+  int i;
+
+  pthread_mutex_lock(&s_metrics_lock);
+  for (i = 0; i < RIL_ROUTE_MAX; i++) {
+    routes[i] = s_routes[i].latency;
+  }
+  modem = s_modem_metrics;
+  pthread_mutex_unlock(&s_metrics_lock);
+
+  for (i = 0; i < RIL_ROUTE_MAX; i++) {
+    if (!routes[i].count)
+      continue;
+    snprintf(name, sizeof(name), "request %d %s", i, kinds[s_routes[i].kind]);
+    dump_hist(out, name, &routes[i]);
+  }
+  dump_hist(out, "at", &modem.at);
+  fprintf(out, "at_timeouts %u\n", modem.at_timeouts);
+  fprintf(out, "modem_bytes written %llu read %llu\n",
+          modem.bytes_written, modem.bytes_read);
+  dump_hist(out, "pppd_setup", &modem.ppp_setup);
+  dump_hist(out, "pppd_teardown", &modem.ppp_teardown);
+  fprintf(out, "pppd_failures setup %u teardown %u\n",
+          modem.ppp_setup_failures, modem.ppp_teardown_failures);
+}
+
+/* the metrics show what the phone is doing, only system and root may ask */
+static int metrics_peer_allowed(int fd) {
+  struct ucred cred;
+  socklen_t len = sizeof(cred);
+
+  if (getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &cred, &len) < 0) {
+    LOGE("%s: SO_PEERCRED failed: %s", __func__, strerror(errno));
+    return 0;
+  }
+  if (cred.uid != AID_ROOT && cred.uid != AID_SYSTEM) {
+    LOGW("%s: refusing pid %d uid %d", __func__, cred.pid, cred.uid);
+    return 0;
+  }
+  return 1;
+}
+
+/* one text dump per connection, e.g. "socat - ABSTRACT-CONNECT:rilw-metrics" */
+static void *metrics_thread(void *arg) {
+  int server = (int)(long)arg;
+  int fd;
+  FILE *out;
+
+  for (;;) {
+    fd = accept(server, NULL, NULL);
+    if (fd < 0) {
+      if (errno == EINTR)
+        continue;
+      LOGE("%s: accept failed: %s", __func__, strerror(errno));
+      break;
+    }
+    if (!metrics_peer_allowed(fd)) {
+      close(fd);
+      continue;
+    }
+    out = fdopen(fd, "w");
+    if (out == NULL) {
+      close(fd);
+      continue;
+    }
+    dump_metrics(out);
+    fclose(out);
+  }
+  close(server);
+  return NULL;
+}
+
+static void start_metrics_thread(void) {
+  pthread_t thread;
+  pthread_attr_t attr;
+  int server;
+
+  server = socket_local_server(METRICS_SOCKET_NAME,
+                               ANDROID_SOCKET_NAMESPACE_ABSTRACT, SOCK_STREAM);
+  if (server < 0) {
+    LOGE("could not create %s socket: %s", METRICS_SOCKET_NAME, strerror(errno));
+    return;
+  }
+  fcntl(server, F_SETFD, FD_CLOEXEC);
+
+  pthread_attr_init(&attr);
+  pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+  if (pthread_create(&thread, &attr, metrics_thread, (void *)(long)server)) {
+    LOGE("could not start metrics thread");
+    close(server);
+  }
+  pthread_attr_destroy(&attr);
 }
 //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++=
 static void usage(char *s)
@@ -453,6 +1137,8 @@ static void usage(char *s)
 }
 //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++=
 const RIL_RadioFunctions *RIL_Init(const struct RIL_Env *env, int argc, char **argv) {
+    char buf[PATH_MAX];
+    const char *vendor_path;
     int ret;
     int fd = -1;
     int opt;
@@ -477,15 +1163,46 @@ const RIL_RadioFunctions *RIL_Init(const struct RIL_Env *env, int argc, char **a
         return NULL;
     }
 
-    ril_handler=dlopen("/system/lib/libhtc_ril.so", 0/*Need to RTFM, 0 seems fine*/);
+    /* resolve everything now rather than stalling the first requests */
+    vendor_path = rootedPath(buf, sizeof(buf), VENDOR_RIL_PATH);
+    ril_handler=dlopen(vendor_path, RTLD_NOW);
+    if (ril_handler == NULL) {
+        LOGE("could not load %s: %s", vendor_path, dlerror());
+        return NULL;
+    }
     RIL_RadioFunctions* (*htc_ril)(const struct RIL_Env *env, int argc, char **argv);
 
     htc_ril=dlsym(ril_handler, "RIL_Init");
+    if (htc_ril == NULL) {
+        LOGE("%s has no RIL_Init: %s", VENDOR_RIL_PATH, dlerror());
+        return NULL;
+    }
+
+    /* route the vendor completions and indications through us so that we
+       can keep the registration state cache up to date */
+    s_vendor_env = *env;
+    s_vendor_env.OnRequestComplete = vendorOnRequestComplete;
+    s_vendor_env.OnUnsolicitedResponse = vendorOnUnsolicitedResponse;
+
     RIL_RadioFunctions *s_callbacks;
-    s_callbacks=htc_ril(env, argc, argv);
+    s_callbacks=htc_ril(&s_vendor_env, argc, argv);
+    if (s_callbacks == NULL || s_callbacks->onRequest == NULL) {
+        LOGE("%s RIL_Init failed", VENDOR_RIL_PATH);
+        return NULL;
+    }
+    /* we hand the vendor table to libril as ours, it has to match */
+    if (s_callbacks->version < 1 || s_callbacks->version > RIL_VERSION) {
+        LOGE("%s reports RIL version %d, expected 1..%d", VENDOR_RIL_PATH,
+             s_callbacks->version, RIL_VERSION);
+        return NULL;
+    }
+    D("%s: %s RIL version %d", __func__, VENDOR_RIL_PATH, s_callbacks->version);
+
     libhtc_ril_onRequest=s_callbacks->onRequest;
     s_callbacks->onRequest=onRequest;
 
+    start_metrics_thread();
+
     return s_callbacks;
 }
 //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++=
@@ -15,6 +15,11 @@
 ** limitations under the License.
 */
 
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "misc.h"
+
 /** returns 1 if line starts with prefix, 0 if it does not */
 int strStartsWith(const char *line, const char *prefix)
 {
@@ -27,3 +32,21 @@ int strStartsWith(const char *line, const char *prefix)
     return *prefix == '\0';
 }
 
+/*
+ * returns path itself when $RIL_ROOT is unset, buf otherwise. Only the host
+ * tests are built with RIL_HOST_TEST; rild always uses the real paths.
+ */
+const char *rootedPath(char *buf, size_t size, const char *path)
+{
+#ifdef RIL_HOST_TEST
+    const char *root = getenv(RIL_ROOT_ENV);
+
+    if (root == NULL || root[0] == '\0') {
+        return path;
+    }
+    snprintf(buf, size, "%s%s", root, path);
+    return buf;
+#else
+    return path;
+#endif
+}
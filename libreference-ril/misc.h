@@ -15,5 +15,13 @@
 ** limitations under the License.
 */
 
+#include <stddef.h>
+
 /** returns 1 if line starts with prefix, 0 if it does not */
 int strStartsWith(const char *line, const char *prefix);
+
+/* environment variable moving every file the shim uses under another root,
+   honoured only in a build with RIL_HOST_TEST (tests/Android.mk) */
+#define RIL_ROOT_ENV "RIL_ROOT"
+
+const char *rootedPath(char *buf, size_t size, const char *path);
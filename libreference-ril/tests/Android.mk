@@ -0,0 +1,44 @@
+# Copyright (C) 2011 The CyanogenMod Project
+#
+# Host tests for the RIL shim. They run it against a pty fake modem, a stub
+# libhtc_ril and a stub pppd under a temporary $RIL_ROOT, see ril_harness.c.
+
+LOCAL_PATH:= $(call my-dir)
+
+ril_test_cflags := -D_GNU_SOURCE -DRIL_SHLIB -DRIL_HOST_TEST
+ril_test_includes := $(LOCAL_PATH)/.. hardware/ril/include $(KERNEL_HEADERS)
+
+include $(CLEAR_VARS)
+LOCAL_MODULE_TAGS := tests
+LOCAL_SRC_FILES := stub_htc_ril.c
+LOCAL_C_INCLUDES := $(ril_test_includes)
+LOCAL_CFLAGS := $(ril_test_cflags)
+LOCAL_MODULE := libril_stub_htc_ril
+include $(BUILD_HOST_SHARED_LIBRARY)
+
+include $(CLEAR_VARS)
+LOCAL_MODULE_TAGS := tests
+LOCAL_SRC_FILES := stub_pppd.c
+LOCAL_CFLAGS := $(ril_test_cflags)
+LOCAL_MODULE := ril_stub_pppd
+include $(BUILD_HOST_EXECUTABLE)
+
+include $(CLEAR_VARS)
+LOCAL_MODULE_TAGS := tests
+LOCAL_SRC_FILES := ril_bench.c ril_harness.c fake_modem.c ../misc.c
+LOCAL_C_INCLUDES := $(ril_test_includes)
+LOCAL_CFLAGS := $(ril_test_cflags)
+LOCAL_STATIC_LIBRARIES := libcutils liblog
+LOCAL_LDLIBS := -ldl -lpthread -lutil
+LOCAL_MODULE := ril_bench
+include $(BUILD_HOST_EXECUTABLE)
+
+include $(CLEAR_VARS)
+LOCAL_MODULE_TAGS := tests
+LOCAL_SRC_FILES := ril_regcache_test.c ril_harness.c fake_modem.c ../misc.c
+LOCAL_C_INCLUDES := $(ril_test_includes)
+LOCAL_CFLAGS := $(ril_test_cflags)
+LOCAL_STATIC_LIBRARIES := libcutils liblog
+LOCAL_LDLIBS := -ldl -lpthread -lutil
+LOCAL_MODULE := ril_regcache_test
+include $(BUILD_HOST_EXECUTABLE)
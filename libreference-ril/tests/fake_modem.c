@@ -0,0 +1,281 @@
+/*
+ * Copyright (C) 2011 The CyanogenMod Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <time.h>
+#include <unistd.h>
+#include <termios.h>
+
+#include "fake_modem.h"
+
+/*****************************************************************************/
+
+static long long now_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static void sleep_ms(int ms)
+{
+    struct timespec ts;
+
+    if (ms <= 0)
+        return;
+    ts.tv_sec = ms / 1000;
+    ts.tv_nsec = (ms % 1000) * 1000000L;
+    while (nanosleep(&ts, &ts) < 0 && errno == EINTR)
+        ;
+}
+
+/* undo \r \n \t and \\ escapes in place */
+static void unescape(char *s)
+{
+    char *d = s;
+
+    for (; *s; s++) {
+        if (*s == '\\' && s[1]) {
+            s++;
+            switch (*s) {
+            case 'r': *d++ = '\r'; break;
+            case 'n': *d++ = '\n'; break;
+            case 't': *d++ = '\t'; break;
+            default:  *d++ = *s;   break;
+            }
+        } else {
+            *d++ = *s;
+        }
+    }
+    *d = '\0';
+}
+
+void fake_modem_init(struct fake_modem *m)
+{
+    memset(m, 0, sizeof(*m));
+    pthread_mutex_init(&m->lock, NULL);
+    m->master = -1;
+    m->slave = -1;
+    /* what the shim's data call sequence expects */
+    fake_modem_add_rule(m, "ATD", "\\r\\nCONNECT\\r\\n", -1);
+}
+
+int fake_modem_add_rule(struct fake_modem *m, const char *prefix,
+                        const char *response, int delay_ms)
+{
+    struct modem_rule *r;
+    int i;
+
+    /* a later rule for the same prefix replaces the earlier one */
+    for (i = 0; i < m->num_rules; i++) {
+        if (!strcmp(m->rules[i].prefix, prefix))
+            break;
+    }
+    if (i == FAKE_MODEM_MAX_RULES)
+        return -1;
+    r = &m->rules[i];
+    snprintf(r->prefix, sizeof(r->prefix), "%s", prefix);
+    snprintf(r->response, sizeof(r->response), "%s", response);
+    unescape(r->response);
+    r->delay_ms = delay_ms;
+    if (i == m->num_rules)
+        m->num_rules++;
+    return 0;
+}
+
+/*
+ * One rule per line: "prefix<TAB>response[<TAB>delay_ms]", '#' starts a
+ * comment. Responses use \r and \n escapes, e.g.
+ *     AT+CGACT=1	\r\nERROR\r\n	200
+ */
+int fake_modem_load_script(struct fake_modem *m, const char *path)
+{
+    char line[256], *prefix, *response, *delay, *save;
+    FILE *f;
+
+    f = fopen(path, "r");
+    if (f == NULL)
+        return -errno;
+    while (fgets(line, sizeof(line), f)) {
+        line[strcspn(line, "\n")] = '\0';
+        if (line[0] == '#' || line[0] == '\0')
+            continue;
+        prefix = strtok_r(line, "\t", &save);
+        response = strtok_r(NULL, "\t", &save);
+        delay = strtok_r(NULL, "\t", &save);
+        if (prefix == NULL || response == NULL)
+            continue;
+        if (fake_modem_add_rule(m, prefix, response, delay ? atoi(delay) : -1)) {
+            fclose(f);
+            return -ENOSPC;
+        }
+    }
+    fclose(f);
+    return 0;
+}
+
+static void modem_write(struct fake_modem *m, const char *p, size_t len)
+{
+    size_t chunk;
+    ssize_t n;
+
+    while (len) {
+        chunk = m->fragment > 0 && (size_t)m->fragment < len ? (size_t)m->fragment : len;
+        n = write(m->master, p, chunk);
+        if (n < 0) {
+            if (errno == EINTR || errno == EAGAIN)
+                continue;
+            return;
+        }
+        p += n;
+        len -= n;
+        if (len)
+            sleep_ms(m->fragment_gap_ms);
+    }
+}
+
+static void modem_answer(struct fake_modem *m, const char *cmd)
+{
+    const char *response = "\r\nOK\r\n";
+    int delay = m->delay_ms;
+    int i;
+
+    for (i = 0; i < m->num_rules; i++) {
+        if (!strncmp(cmd, m->rules[i].prefix, strlen(m->rules[i].prefix))) {
+            response = m->rules[i].response;
+            if (m->rules[i].delay_ms >= 0)
+                delay = m->rules[i].delay_ms;
+            break;
+        }
+    }
+    sleep_ms(delay);
+    modem_write(m, response, strlen(response));
+
+    pthread_mutex_lock(&m->lock);
+    m->answered_us = now_us();
+    pthread_mutex_unlock(&m->lock);
+}
+
+static void *modem_thread(void *arg)
+{
+    struct fake_modem *m = arg;
+    struct pollfd pfd;
+    char cmd[128];
+    size_t len = 0;
+    long long now;
+    char c;
+    int r;
+
+    pfd.fd = m->master;
+    pfd.events = POLLIN;
+    while (m->running) {
+        r = poll(&pfd, 1, 50);
+        if (r <= 0)
+            continue;
+        if (read(m->master, &c, 1) != 1)
+            continue;
+        if (c == '\n' && len == 0)
+            continue;
+        if (c != '\r') {
+            if (len == 0) {
+                /* the time the shim took to send its next command once the
+                   previous answer was complete */
+                now = now_us();
+                pthread_mutex_lock(&m->lock);
+                if (m->answered_us) {
+                    m->turnarounds++;
+                    m->turnaround_total_us += now - m->answered_us;
+                    if (now - m->answered_us > m->turnaround_max_us)
+                        m->turnaround_max_us = now - m->answered_us;
+                    m->answered_us = 0;
+                }
+                pthread_mutex_unlock(&m->lock);
+            }
+            if (len < sizeof(cmd) - 1)
+                cmd[len++] = c;
+            continue;
+        }
+        cmd[len] = '\0';
+        len = 0;
+        pthread_mutex_lock(&m->lock);
+        m->commands++;
+        snprintf(m->last_command, sizeof(m->last_command), "%s", cmd);
+        pthread_mutex_unlock(&m->lock);
+        modem_answer(m, cmd);
+    }
+    return NULL;
+}
+
+int fake_modem_start(struct fake_modem *m)
+{
+    struct termios ios;
+    const char *name;
+
+    m->master = posix_openpt(O_RDWR | O_NOCTTY);
+    if (m->master < 0 || grantpt(m->master) < 0 || unlockpt(m->master) < 0)
+        goto error;
+    name = ptsname(m->master);
+    if (name == NULL)
+        goto error;
+    snprintf(m->slave_path, sizeof(m->slave_path), "%s", name);
+
+    /* hold the slave open so the master never sees a hangup while the shim
+       closes and reopens it between requests, and keep it raw so nothing
+       the shim writes is echoed back */
+    m->slave = open(m->slave_path, O_RDWR | O_NOCTTY);
+    if (m->slave < 0 || tcgetattr(m->slave, &ios) < 0)
+        goto error;
+    cfmakeraw(&ios);
+    if (tcsetattr(m->slave, TCSANOW, &ios) < 0)
+        goto error;
+
+    m->running = 1;
+    if (pthread_create(&m->thread, NULL, modem_thread, m)) {
+        m->running = 0;
+        goto error;
+    }
+    return 0;
+
+error:
+    fake_modem_stop(m);
+    return -1;
+}
+
+/* the next command doesn't count as a turnaround, e.g. a new request */
+void fake_modem_mark(struct fake_modem *m)
+{
+    pthread_mutex_lock(&m->lock);
+    m->answered_us = 0;
+    pthread_mutex_unlock(&m->lock);
+}
+
+void fake_modem_stop(struct fake_modem *m)
+{
+    if (m->running) {
+        m->running = 0;
+        pthread_join(m->thread, NULL);
+    }
+    if (m->slave >= 0)
+        close(m->slave);
+    if (m->master >= 0)
+        close(m->master);
+    m->slave = m->master = -1;
+}
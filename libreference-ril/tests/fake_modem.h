@@ -0,0 +1,72 @@
+/*
+ * Copyright (C) 2011 The CyanogenMod Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef _FAKE_MODEM_H_
+#define _FAKE_MODEM_H_
+
+#include <pthread.h>
+
+/*
+ * A scriptable AT modem on a pty. Commands are read up to '\r' and answered
+ * by the first rule whose prefix matches, "\r\nOK\r\n" when none does. The
+ * answer can be delayed and written in fragments to exercise the shim's AT
+ * engine the way a real modem splits its result codes.
+ */
+
+#define FAKE_MODEM_MAX_RULES    32
+
+struct modem_rule {
+    char prefix[64];
+    char response[128];     /* written as is, "\r\n" escapes already undone */
+    int delay_ms;           /* -1: use the modem's default */
+};
+
+struct fake_modem {
+    /* configuration, set before fake_modem_start() */
+    struct modem_rule rules[FAKE_MODEM_MAX_RULES];
+    int num_rules;
+    int delay_ms;           /* before every answer */
+    int fragment;           /* bytes per write, 0 for the whole answer */
+    int fragment_gap_ms;    /* between fragments */
+
+    /* set by fake_modem_start() */
+    char slave_path[64];
+
+    /* statistics, read under lock */
+    pthread_mutex_t lock;
+    unsigned commands;
+    unsigned turnarounds;
+    long long turnaround_total_us;
+    long long turnaround_max_us;
+    char last_command[128];
+
+    int master;
+    int slave;
+    int running;
+    long long answered_us;  /* when the last answer was complete, 0 if marked */
+    pthread_t thread;
+};
+
+void fake_modem_init(struct fake_modem *m);
+int fake_modem_add_rule(struct fake_modem *m, const char *prefix,
+                        const char *response, int delay_ms);
+int fake_modem_load_script(struct fake_modem *m, const char *path);
+int fake_modem_start(struct fake_modem *m);
+void fake_modem_mark(struct fake_modem *m);
+void fake_modem_stop(struct fake_modem *m);
+
+#endif
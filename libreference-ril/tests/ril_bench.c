@@ -0,0 +1,185 @@
+/*
+ * Copyright (C) 2011 The CyanogenMod Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/*
+ * Data call setup/teardown bench and AT engine regression test for the RIL
+ * shim, run on a host against the fake modem, stub libhtc_ril and stub pppd
+ * of ril_harness.c.
+ *
+ *   ril_bench [-n calls] [-d modem delay ms] [-f fragment bytes]
+ *             [-g fragment gap ms] [-s modem script] [-l stub lib] [-p stub pppd]
+ *
+ * Exits non-zero when a call fails, pppd got the wrong options, a pppd is
+ * left behind, or the shim is slow to notice a result code (it used to miss
+ * those split across reads and wait out its select timeouts).
+ */
+
+/* the shim itself, for its metrics */
+#include "../leoreference-ril.c"
+
+#include "ril_harness.h"
+
+/* the shim must send its next command this soon after a result code */
+#define MAX_TURNAROUND_US   200000
+
+static char *sSetup[] = { "1", "0", "internet", "benchuser", "bench\"pass", "3", "IP" };
+static char *sDeactivate[] = { "1", "0" };
+
+static int sFailures;
+
+#define CHECK(cond, ...) do { \
+        if (!(cond)) { \
+            fprintf(stderr, "FAIL: " __VA_ARGS__); \
+            fputc('\n', stderr); \
+            sFailures++; \
+        } \
+    } while (0)
+
+static int file_exists(struct ril_harness *h, const char *path)
+{
+    char full[PATH_MAX];
+
+    snprintf(full, sizeof(full), "%s%s", h->root, path);
+    return access(full, F_OK) == 0;
+}
+
+static int file_contains(struct ril_harness *h, const char *path, const char *text)
+{
+    char full[PATH_MAX], buf[4096];
+    ssize_t n;
+    int fd;
+
+    snprintf(full, sizeof(full), "%s%s", h->root, path);
+    fd = open(full, O_RDONLY);
+    if (fd < 0)
+        return 0;
+    n = read(fd, buf, sizeof(buf) - 1);
+    close(fd);
+    buf[n > 0 ? n : 0] = '\0';
+    return strstr(buf, text) != NULL;
+}
+
+/* options.smd unreadable for one call must not break the following ones */
+static void check_options_retry(struct ril_harness *h)
+{
+    char path[PATH_MAX], moved[PATH_MAX];
+
+    snprintf(path, sizeof(path), "%s/etc/ppp/options.smd", h->root);
+    snprintf(moved, sizeof(moved), "%s.away", path);
+    rename(path, moved);
+    CHECK(harness_request(h, RIL_REQUEST_SETUP_DATA_CALL, sSetup, sizeof(sSetup))
+          == RIL_E_GENERIC_FAILURE, "setup without options.smd didn't fail");
+    rename(moved, path);
+}
+
+static void check_pppd_failure(struct ril_harness *h)
+{
+    unsigned before = s_modem_metrics.ppp_setup_failures;
+
+    setenv("STUB_PPPD_FAIL", "1", 1);
+    CHECK(harness_request(h, RIL_REQUEST_SETUP_DATA_CALL, sSetup, sizeof(sSetup))
+          == RIL_E_GENERIC_FAILURE, "setup with a failing pppd didn't fail");
+    unsetenv("STUB_PPPD_FAIL");
+    CHECK(s_modem_metrics.ppp_setup_failures == before + 1,
+          "failed pppd start not counted");
+}
+
+int main(int argc, char **argv)
+{
+    struct ril_harness h;
+    long long start, setup_us, teardown_us;
+    long long setup_total = 0, setup_max = 0, teardown_total = 0, teardown_max = 0;
+    int calls = 3, opt, i;
+    const char *script = NULL;
+
+    harness_parse_args(&h, &argc, argv);
+    while ((opt = getopt(argc, argv, "n:d:f:g:s:")) != -1) {
+        switch (opt) {
+        case 'n': calls = atoi(optarg); break;
+        case 'd': h.modem.delay_ms = atoi(optarg); break;
+        case 'f': h.modem.fragment = atoi(optarg); break;
+        case 'g': h.modem.fragment_gap_ms = atoi(optarg); break;
+        case 's': script = optarg; break;
+        default:
+            fprintf(stderr, "usage: %s [-n calls] [-d delay_ms] [-f fragment] "
+                    "[-g gap_ms] [-s script] [-l stub_lib] [-p stub_pppd]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (script && fake_modem_load_script(&h.modem, script) < 0) {
+        fprintf(stderr, "can't load %s\n", script);
+        return 2;
+    }
+    /* getopt is used again by RIL_Init */
+    optind = 1;
+
+    if (harness_start(&h) < 0) {
+        harness_stop(&h);
+        return 2;
+    }
+
+    check_options_retry(&h);
+    check_pppd_failure(&h);
+
+    for (i = 0; i < calls; i++) {
+        start = harness_now_us();
+        CHECK(harness_request(&h, RIL_REQUEST_SETUP_DATA_CALL, sSetup, sizeof(sSetup))
+              == RIL_E_SUCCESS, "setup %d failed", i);
+        setup_us = harness_now_us() - start;
+        CHECK(h.num_strings == 2 && !strcmp(h.strings[1], "ppp0"),
+              "setup %d didn't answer ppp0", i);
+        CHECK(file_exists(&h, "/etc/ppp/ppp0.pid"), "no pppd after setup %d", i);
+        CHECK(file_contains(&h, "/etc/ppp/stub-pppd.options", "user \"benchuser\"\n") &&
+              file_contains(&h, "/etc/ppp/stub-pppd.options", "password \"bench\\\"pass\"\n") &&
+              !file_contains(&h, "/etc/ppp/stub-pppd.options", "placeholder"),
+              "pppd got the wrong credentials");
+
+        start = harness_now_us();
+        CHECK(harness_request(&h, RIL_REQUEST_DEACTIVATE_DATA_CALL, sDeactivate,
+                              sizeof(sDeactivate)) == RIL_E_SUCCESS, "teardown %d failed", i);
+        teardown_us = harness_now_us() - start;
+        CHECK(!file_exists(&h, "/etc/ppp/ppp0.pid"), "pppd still up after teardown %d", i);
+
+        printf("call %d: setup %lld ms, teardown %lld ms\n", i,
+               setup_us / 1000, teardown_us / 1000);
+        setup_total += setup_us;
+        teardown_total += teardown_us;
+        if (setup_us > setup_max)
+            setup_max = setup_us;
+        if (teardown_us > teardown_max)
+            teardown_max = teardown_us;
+    }
+
+    if (calls > 0) {
+        printf("setup avg %lld ms max %lld ms, teardown avg %lld ms max %lld ms\n",
+               setup_total / calls / 1000, setup_max / 1000,
+               teardown_total / calls / 1000, teardown_max / 1000);
+    }
+    pthread_mutex_lock(&h.modem.lock);
+    printf("modem: %u commands, turnaround avg %lld us max %lld us "
+           "(delay %d ms, fragment %d bytes)\n", h.modem.commands,
+           h.modem.turnarounds ? h.modem.turnaround_total_us / h.modem.turnarounds : 0,
+           h.modem.turnaround_max_us, h.modem.delay_ms, h.modem.fragment);
+    CHECK(h.modem.turnaround_max_us < MAX_TURNAROUND_US,
+          "the shim took %lld us to notice a result code", h.modem.turnaround_max_us);
+    pthread_mutex_unlock(&h.modem.lock);
+    dump_metrics(stdout);
+
+    harness_stop(&h);
+    printf("%s\n", sFailures ? "FAILED" : "PASSED");
+    return sFailures ? 1 : 0;
+}
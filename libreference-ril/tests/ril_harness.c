@@ -0,0 +1,291 @@
+/*
+ * Copyright (C) 2011 The CyanogenMod Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <dlfcn.h>
+#include <ftw.h>
+#include <libgen.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "ril_harness.h"
+#include "../misc.h"
+
+/* what the shim's own options.smd looks like on the phone */
+static const char sOptions[] =
+    "# options for the data channel\n"
+    "115200\n"
+    "nocrtscts\n"
+    "noauth\n"
+    "user placeholder\n"
+    "usepeerdns\n"
+    "novj\n"
+    "noipdefault\n";
+
+static struct ril_harness *sHarness;
+
+extern const RIL_RadioFunctions *RIL_Init(const struct RIL_Env *env, int argc, char **argv);
+
+/*****************************************************************************/
+
+long long harness_now_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static void onRequestComplete(RIL_Token t, RIL_Errno e, void *response, size_t responselen)
+{
+    struct ril_harness *h = sHarness;
+    char **strings = response;
+    int request = *(int *)t;
+    int i, n = 0;
+
+    /* the requests the tests look at answer with strings */
+    if (response && (request == RIL_REQUEST_REGISTRATION_STATE ||
+                     request == RIL_REQUEST_GPRS_REGISTRATION_STATE ||
+                     request == RIL_REQUEST_SETUP_DATA_CALL)) {
+        n = responselen / sizeof(char *);
+    }
+    if (n > HARNESS_MAX_STRINGS)
+        n = HARNESS_MAX_STRINGS;
+
+    pthread_mutex_lock(&h->lock);
+    h->completions++;
+    h->error = e;
+    h->num_strings = n;
+    for (i = 0; i < n; i++) {
+        snprintf(h->strings[i], sizeof(h->strings[i]), "%s",
+                 strings[i] ? strings[i] : "(null)");
+    }
+    pthread_mutex_unlock(&h->lock);
+}
+
+static void onUnsolicitedResponse(int unsolResponse, const void *data, size_t datalen)
+{
+}
+
+struct timed_call {
+    RIL_TimedCallback callback;
+    void *param;
+    struct timespec delay;
+};
+
+static void *timed_thread(void *arg)
+{
+    struct timed_call *c = arg;
+
+    nanosleep(&c->delay, NULL);
+    c->callback(c->param);
+    free(c);
+    return NULL;
+}
+
+static void requestTimedCallback(RIL_TimedCallback callback, void *param,
+                                 const struct timeval *relativeTime)
+{
+    struct timed_call *c = calloc(1, sizeof(*c));
+    pthread_t thread;
+
+    c->callback = callback;
+    c->param = param;
+    if (relativeTime) {
+        c->delay.tv_sec = relativeTime->tv_sec;
+        c->delay.tv_nsec = relativeTime->tv_usec * 1000L;
+    }
+    if (pthread_create(&thread, NULL, timed_thread, c) == 0)
+        pthread_detach(thread);
+    else
+        free(c);
+}
+
+static const struct RIL_Env sEnv = {
+    onRequestComplete,
+    onUnsolicitedResponse,
+    requestTimedCallback,
+};
+
+/*****************************************************************************/
+
+static int write_file(const char *root, const char *path, const char *data)
+{
+    char full[PATH_MAX];
+    int fd;
+
+    snprintf(full, sizeof(full), "%s%s", root, path);
+    fd = open(full, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+        return -1;
+    write(fd, data, strlen(data));
+    close(fd);
+    return 0;
+}
+
+static int make_dirs(const char *root)
+{
+    static const char * const dirs[] = {
+        "/system", "/system/lib", "/bin", "/dev", "/etc", "/etc/ppp"
+    };
+    char path[PATH_MAX];
+    unsigned i;
+
+    for (i = 0; i < sizeof(dirs) / sizeof(dirs[0]); i++) {
+        snprintf(path, sizeof(path), "%s%s", root, dirs[i]);
+        if (mkdir(path, 0755) < 0 && errno != EEXIST)
+            return -1;
+    }
+    return 0;
+}
+
+static int link_into(const char *root, const char *target, const char *path)
+{
+    char full[PATH_MAX];
+
+    snprintf(full, sizeof(full), "%s%s", root, path);
+    return symlink(target, full);
+}
+
+/*
+ * Takes "-l <stub libhtc_ril.so>" and "-p <stub pppd>" off the command line,
+ * by default both are looked up next to the test: ../lib and the same
+ * directory, the way host modules are installed.
+ */
+int harness_parse_args(struct ril_harness *h, int *argc, char **argv)
+{
+    char exe[PATH_MAX], *dir;
+    ssize_t n;
+    int i, j;
+
+    memset(h, 0, sizeof(*h));
+    n = readlink("/proc/self/exe", exe, sizeof(exe) - 1);
+    exe[n > 0 ? n : 0] = '\0';
+    dir = dirname(exe);
+    snprintf(h->stub_lib, sizeof(h->stub_lib), "%s/../lib/libril_stub_htc_ril.so", dir);
+    snprintf(h->stub_pppd, sizeof(h->stub_pppd), "%s/ril_stub_pppd", dir);
+
+    for (i = j = 1; i < *argc; i++) {
+        if (!strcmp(argv[i], "-l") && i + 1 < *argc) {
+            realpath(argv[++i], h->stub_lib);
+        } else if (!strcmp(argv[i], "-p") && i + 1 < *argc) {
+            realpath(argv[++i], h->stub_pppd);
+        } else {
+            argv[j++] = argv[i];
+        }
+    }
+    *argc = j;
+    argv[j] = NULL;
+    fake_modem_init(&h->modem);
+    return 0;
+}
+
+int harness_start(struct ril_harness *h)
+{
+    char *argv[] = { "rild", "-d", h->modem.slave_path, NULL };
+
+    pthread_mutex_init(&h->lock, NULL);
+    sHarness = h;
+
+    snprintf(h->root, sizeof(h->root), "/tmp/ril-harness-XXXXXX");
+    if (mkdtemp(h->root) == NULL || make_dirs(h->root) < 0) {
+        fprintf(stderr, "can't create a root under /tmp: %s\n", strerror(errno));
+        return -1;
+    }
+    if (link_into(h->root, h->stub_lib, "/system/lib/libhtc_ril.so") < 0 ||
+        link_into(h->root, h->stub_pppd, "/bin/pppd") < 0 ||
+        write_file(h->root, "/etc/ppp/options.smd", sOptions) < 0 ||
+        write_file(h->root, "/dev/ppp", "") < 0 ||
+        write_file(h->root, "/dev/smd1", "") < 0) {
+        fprintf(stderr, "can't populate %s: %s\n", h->root, strerror(errno));
+        return -1;
+    }
+    setenv(RIL_ROOT_ENV, h->root, 1);
+
+    if (fake_modem_start(&h->modem) < 0) {
+        fprintf(stderr, "can't start the fake modem: %s\n", strerror(errno));
+        return -1;
+    }
+
+    h->funcs = RIL_Init(&sEnv, 3, argv);
+    if (h->funcs == NULL) {
+        fprintf(stderr, "RIL_Init failed, is %s built?\n", h->stub_lib);
+        return -1;
+    }
+    h->stub = dlopen(h->stub_lib, RTLD_NOW | RTLD_NOLOAD);
+    return 0;
+}
+
+/* issues request like libril would, returns the error it completed with */
+RIL_Errno harness_request(struct ril_harness *h, int request, void *data, size_t datalen)
+{
+    unsigned before;
+    /* tokens have to be unique like libril's, the shim remembers them */
+    int *token = malloc(sizeof(*token));
+
+    *token = request;
+    pthread_mutex_lock(&h->lock);
+    before = h->completions;
+    pthread_mutex_unlock(&h->lock);
+
+    fake_modem_mark(&h->modem);
+    h->funcs->onRequest(request, data, datalen, token);
+    free(token);
+
+    /* every request the shim or the stub handles completes synchronously */
+    pthread_mutex_lock(&h->lock);
+    if (h->completions == before)
+        h->error = -1;
+    pthread_mutex_unlock(&h->lock);
+    return h->error;
+}
+
+void *harness_stub_sym(struct ril_harness *h, const char *name)
+{
+    return h->stub ? dlsym(h->stub, name) : NULL;
+}
+
+static int remove_entry(const char *path, const struct stat *st, int flag, struct FTW *ftw)
+{
+    return remove(path);
+}
+
+void harness_stop(struct ril_harness *h)
+{
+    char path[PATH_MAX];
+    FILE *f;
+    int pid;
+
+    fake_modem_stop(&h->modem);
+    if (h->root[0] == '\0')
+        return;
+
+    /* a data call left up has a stub pppd hanging around */
+    snprintf(path, sizeof(path), "%s/etc/ppp/ppp0.pid", h->root);
+    f = fopen(path, "r");
+    if (f) {
+        if (fscanf(f, "%d", &pid) == 1 && pid > 0)
+            kill(pid, SIGTERM);
+        fclose(f);
+    }
+    nftw(h->root, remove_entry, 8, FTW_DEPTH | FTW_PHYS);
+    h->root[0] = '\0';
+}
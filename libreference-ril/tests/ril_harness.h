@@ -0,0 +1,61 @@
+/*
+ * Copyright (C) 2011 The CyanogenMod Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef _RIL_HARNESS_H_
+#define _RIL_HARNESS_H_
+
+#include <limits.h>
+#include <pthread.h>
+
+#include <telephony/ril.h>
+
+#include "fake_modem.h"
+
+/*
+ * Runs the shim on a host: a temporary $RIL_ROOT holding the stub vendor
+ * library, the stub pppd, an options.smd and a stand-in /dev/ppp, plus a
+ * fake modem on a pty as the AT channel. Requests are issued the way libril
+ * would and their completions captured.
+ */
+
+#define HARNESS_MAX_STRINGS 16
+
+struct ril_harness {
+    char root[PATH_MAX];
+    char stub_lib[PATH_MAX];
+    char stub_pppd[PATH_MAX];
+    struct fake_modem modem;
+    const RIL_RadioFunctions *funcs;
+    void *stub;                 /* the stub vendor library, for dlsym() */
+
+    /* the last completion */
+    pthread_mutex_t lock;
+    unsigned completions;
+    RIL_Errno error;
+    int num_strings;
+    char strings[HARNESS_MAX_STRINGS][32];
+};
+
+int harness_parse_args(struct ril_harness *h, int *argc, char **argv);
+int harness_start(struct ril_harness *h);
+RIL_Errno harness_request(struct ril_harness *h, int request, void *data, size_t datalen);
+void *harness_stub_sym(struct ril_harness *h, const char *name);
+void harness_stop(struct ril_harness *h);
+
+long long harness_now_us(void);
+
+#endif
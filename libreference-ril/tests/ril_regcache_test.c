@@ -0,0 +1,167 @@
+/*
+ * Copyright (C) 2011 The CyanogenMod Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/*
+ * Registration state cache test for the RIL shim, run on a host against the
+ * stub libhtc_ril of ril_harness.c. Counts the requests that reach the
+ * vendor library while the framework polls, and times cached against
+ * uncached polls (STUB_RIL_DELAY_US, -d here, is the vendor's cost).
+ *
+ *   ril_regcache_test [-n polls] [-d vendor delay us] [-l stub lib] [-p stub pppd]
+ */
+
+/* the shim itself, for its cache */
+#include "../leoreference-ril.c"
+
+#include "ril_harness.h"
+
+static unsigned (*stub_calls)(int request);
+static void (*stub_reset)(void);
+static void (*stub_fail)(int request, int fail);
+static void (*stub_move)(void);
+static const char *(*stub_lac)(void);
+
+static int sFailures;
+
+#define CHECK(cond, ...) do { \
+        if (!(cond)) { \
+            fprintf(stderr, "FAIL: " __VA_ARGS__); \
+            fputc('\n', stderr); \
+            sFailures++; \
+        } \
+    } while (0)
+
+/* polls both registration requests n times, returns the average us per poll */
+static long long poll_reg(struct ril_harness *h, int n)
+{
+    long long start = harness_now_us();
+    int i;
+
+    for (i = 0; i < n; i++) {
+        CHECK(harness_request(h, RIL_REQUEST_REGISTRATION_STATE, NULL, 0) == RIL_E_SUCCESS,
+              "registration poll %d failed", i);
+        CHECK(harness_request(h, RIL_REQUEST_GPRS_REGISTRATION_STATE, NULL, 0) == RIL_E_SUCCESS,
+              "gprs registration poll %d failed", i);
+    }
+    return n ? (harness_now_us() - start) / (2 * n) : 0;
+}
+
+static unsigned vendor_calls(void)
+{
+    return stub_calls(RIL_REQUEST_REGISTRATION_STATE) +
+           stub_calls(RIL_REQUEST_GPRS_REGISTRATION_STATE);
+}
+
+int main(int argc, char **argv)
+{
+    struct ril_harness h;
+    long long cached_us, uncached_us;
+    char delay[16];
+    int polls = 100, opt, i;
+    int power = 1;
+
+    harness_parse_args(&h, &argc, argv);
+    while ((opt = getopt(argc, argv, "n:d:")) != -1) {
+        switch (opt) {
+        case 'n': polls = atoi(optarg); break;
+        case 'd':
+            snprintf(delay, sizeof(delay), "%d", atoi(optarg));
+            setenv("STUB_RIL_DELAY_US", delay, 1);
+            break;
+        default:
+            fprintf(stderr, "usage: %s [-n polls] [-d vendor_delay_us] "
+                    "[-l stub_lib] [-p stub_pppd]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (polls < 1)
+        polls = 1;
+    optind = 1;
+
+    if (harness_start(&h) < 0) {
+        harness_stop(&h);
+        return 2;
+    }
+    stub_calls = harness_stub_sym(&h, "stub_ril_calls");
+    stub_reset = harness_stub_sym(&h, "stub_ril_reset");
+    stub_fail = harness_stub_sym(&h, "stub_ril_fail");
+    stub_move = harness_stub_sym(&h, "stub_ril_move");
+    stub_lac = harness_stub_sym(&h, "stub_ril_lac");
+    if (!stub_calls || !stub_reset || !stub_fail || !stub_move || !stub_lac) {
+        harness_stop(&h);
+        return 2;
+    }
+
+    /* a steady state: one vendor request per entry, however often we poll */
+    cached_us = poll_reg(&h, polls);
+    CHECK(vendor_calls() == 2, "%d polls reached the vendor %u times", polls, vendor_calls());
+    CHECK(h.num_strings == 4 && !strcmp(h.strings[1], stub_lac()),
+          "cached gprs answer is wrong");
+
+    /* a cell change is announced by the modem and must be seen at once */
+    stub_reset();
+    stub_move();
+    poll_reg(&h, 1);
+    CHECK(vendor_calls() == 2, "a network state change didn't invalidate");
+    CHECK(!strcmp(h.strings[1], stub_lac()), "stale LAC %s after a cell change, want %s",
+          h.strings[1], stub_lac());
+
+    /* so must anything the framework does to the registration */
+    stub_reset();
+    harness_request(&h, RIL_REQUEST_RADIO_POWER, &power, sizeof(power));
+    poll_reg(&h, 1);
+    CHECK(vendor_calls() == 2, "RIL_REQUEST_RADIO_POWER didn't invalidate");
+
+    /* an answer is only trusted for REG_CACHE_MAX_AGE_MS */
+    stub_reset();
+    for (i = 0; i < NUM_REG_CACHES; i++)
+        s_reg_cache[i].stamp_ms -= REG_CACHE_MAX_AGE_MS + 1000;
+    poll_reg(&h, 1);
+    CHECK(vendor_calls() == 2, "expired answers were served");
+
+    /* a failure is passed on and not remembered */
+    stub_reset();
+    reg_cache_invalidate_all("test");
+    stub_fail(RIL_REQUEST_REGISTRATION_STATE, 1);
+    CHECK(harness_request(&h, RIL_REQUEST_REGISTRATION_STATE, NULL, 0) == RIL_E_GENERIC_FAILURE,
+          "vendor failure not passed on");
+    stub_fail(RIL_REQUEST_REGISTRATION_STATE, 0);
+    CHECK(harness_request(&h, RIL_REQUEST_REGISTRATION_STATE, NULL, 0) == RIL_E_SUCCESS &&
+          stub_calls(RIL_REQUEST_REGISTRATION_STATE) == 2, "vendor failure was cached");
+
+    /* the same polls with the cache emptied before each one */
+    stub_reset();
+    {
+        long long start = harness_now_us();
+
+        for (i = 0; i < polls; i++) {
+            reg_cache_invalidate_all("test");
+            harness_request(&h, RIL_REQUEST_REGISTRATION_STATE, NULL, 0);
+        }
+        uncached_us = (harness_now_us() - start) / polls;
+    }
+    CHECK(stub_calls(RIL_REQUEST_REGISTRATION_STATE) == (unsigned)polls,
+          "uncached polls didn't reach the vendor");
+
+    printf("%d polls: cached %lld us, uncached %lld us per poll\n",
+           polls, cached_us, uncached_us);
+    dump_metrics(stdout);
+
+    harness_stop(&h);
+    printf("%s\n", sFailures ? "FAILED" : "PASSED");
+    return sFailures ? 1 : 0;
+}
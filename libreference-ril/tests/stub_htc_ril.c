@@ -0,0 +1,167 @@
+/*
+ * Copyright (C) 2011 The CyanogenMod Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/*
+ * Stand-in for libhtc_ril.so. Requests are counted and answered on the
+ * calling thread: registration state with a fixed set of strings, anything
+ * else with an empty success. The stub_ril_* calls are looked up by tests
+ * with dlsym() to read the counters and to play the modem.
+ *
+ *   STUB_RIL_DELAY_US    time every request spends "talking to the modem"
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <time.h>
+
+#include <telephony/ril.h>
+
+#define STUB_MAX_REQUEST    256
+
+static const struct RIL_Env *s_env;
+static pthread_mutex_t s_lock = PTHREAD_MUTEX_INITIALIZER;
+static unsigned s_calls[STUB_MAX_REQUEST];
+static unsigned char s_fail[STUB_MAX_REQUEST];
+static int s_delay_us;
+static unsigned s_lac = 0x1a2b;
+
+static char *s_reg[14] = {
+    "1", "1A2B", "00C3D4E5", "3", NULL, NULL, NULL, NULL, NULL, NULL, NULL,
+    NULL, NULL, NULL
+};
+static char *s_gprs_reg[4] = { "1", "1A2B", "00C3D4E5", "3" };
+
+unsigned stub_ril_calls(int request)
+{
+    unsigned n;
+
+    if ((unsigned)request >= STUB_MAX_REQUEST)
+        return 0;
+    pthread_mutex_lock(&s_lock);
+    n = s_calls[request];
+    pthread_mutex_unlock(&s_lock);
+    return n;
+}
+
+void stub_ril_reset(void)
+{
+    pthread_mutex_lock(&s_lock);
+    memset(s_calls, 0, sizeof(s_calls));
+    memset(s_fail, 0, sizeof(s_fail));
+    pthread_mutex_unlock(&s_lock);
+}
+
+/* make request fail with RIL_E_GENERIC_FAILURE until cleared */
+void stub_ril_fail(int request, int fail)
+{
+    if ((unsigned)request < STUB_MAX_REQUEST)
+        s_fail[request] = fail;
+}
+
+/* the cell changes: new LAC in the answers, and the indication a modem sends */
+void stub_ril_move(void)
+{
+    static char lac[8];
+
+    pthread_mutex_lock(&s_lock);
+    s_lac++;
+    snprintf(lac, sizeof(lac), "%04X", s_lac);
+    s_reg[1] = lac;
+    s_gprs_reg[1] = lac;
+    pthread_mutex_unlock(&s_lock);
+    s_env->OnUnsolicitedResponse(RIL_UNSOL_RESPONSE_NETWORK_STATE_CHANGED, NULL, 0);
+}
+
+/* LAC currently reported, for checking what the framework got */
+const char *stub_ril_lac(void)
+{
+    return s_reg[1];
+}
+
+static void onRequest(int request, void *data, size_t datalen, RIL_Token t)
+{
+    struct timespec ts;
+    int fail = 0;
+
+    pthread_mutex_lock(&s_lock);
+    if ((unsigned)request < STUB_MAX_REQUEST) {
+        s_calls[request]++;
+        fail = s_fail[request];
+    }
+    pthread_mutex_unlock(&s_lock);
+
+    if (s_delay_us) {
+        ts.tv_sec = s_delay_us / 1000000;
+        ts.tv_nsec = (s_delay_us % 1000000) * 1000L;
+        nanosleep(&ts, NULL);
+    }
+
+    if (fail) {
+        s_env->OnRequestComplete(t, RIL_E_GENERIC_FAILURE, NULL, 0);
+        return;
+    }
+    switch (request) {
+    case RIL_REQUEST_REGISTRATION_STATE:
+        s_env->OnRequestComplete(t, RIL_E_SUCCESS, s_reg, sizeof(s_reg));
+        break;
+    case RIL_REQUEST_GPRS_REGISTRATION_STATE:
+        s_env->OnRequestComplete(t, RIL_E_SUCCESS, s_gprs_reg, sizeof(s_gprs_reg));
+        break;
+    default:
+        s_env->OnRequestComplete(t, RIL_E_SUCCESS, NULL, 0);
+        break;
+    }
+}
+
+static RIL_RadioState onStateRequest(void)
+{
+    return RADIO_STATE_SIM_READY;
+}
+
+static int onSupports(int requestCode)
+{
+    return 1;
+}
+
+static void onCancel(RIL_Token t)
+{
+}
+
+static const char *getVersion(void)
+{
+    return "stub htc ril";
+}
+
+static RIL_RadioFunctions s_callbacks = {
+    RIL_VERSION,
+    onRequest,
+    onStateRequest,
+    onSupports,
+    onCancel,
+    getVersion
+};
+
+const RIL_RadioFunctions *RIL_Init(const struct RIL_Env *env, int argc, char **argv)
+{
+    const char *delay = getenv("STUB_RIL_DELAY_US");
+
+    s_env = env;
+    s_delay_us = delay ? atoi(delay) : 0;
+    return &s_callbacks;
+}
@@ -0,0 +1,135 @@
+/*
+ * Copyright (C) 2011 The CyanogenMod Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/*
+ * Stand-in for pppd, run by the shim as $RIL_ROOT/bin/pppd. It takes the
+ * options the shim passes ("<tty> ... file /proc/self/fd/N"), keeps a copy
+ * in $RIL_ROOT/etc/ppp/stub-pppd.options for the test to look at, then
+ * detaches like pppd does once the link is up and sits on ppp0.pid until
+ * it gets SIGTERM.
+ *
+ *   STUB_PPPD_DELAY_MS   time the "link negotiation" takes
+ *   STUB_PPPD_FAIL       exit with this status instead of connecting
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+
+static char pid_path[PATH_MAX];
+
+static void on_term(int sig)
+{
+    unlink(pid_path);
+    _exit(0);
+}
+
+static int copy_options(const char *from, const char *to)
+{
+    char buf[4096];
+    ssize_t n;
+    int in, out;
+
+    in = open(from, O_RDONLY);
+    if (in < 0)
+        return -1;
+    out = open(to, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (out < 0) {
+        close(in);
+        return -1;
+    }
+    while ((n = read(in, buf, sizeof(buf))) > 0)
+        write(out, buf, n);
+    close(in);
+    close(out);
+    return n < 0 ? -1 : 0;
+}
+
+int main(int argc, char **argv)
+{
+    const char *root = getenv("RIL_ROOT");
+    const char *delay = getenv("STUB_PPPD_DELAY_MS");
+    const char *fail = getenv("STUB_PPPD_FAIL");
+    const char *options = NULL;
+    char path[PATH_MAX];
+    struct timespec ts;
+    int sync[2];
+    char c;
+    pid_t pid;
+    int i, fd;
+
+    if (root == NULL)
+        root = "";
+    for (i = 1; i < argc - 1; i++) {
+        if (!strcmp(argv[i], "file"))
+            options = argv[i + 1];
+    }
+    if (argc < 2 || options == NULL) {
+        fprintf(stderr, "stub pppd: expected <tty> ... file <options>\n");
+        return 2;
+    }
+
+    snprintf(path, sizeof(path), "%s/etc/ppp/stub-pppd.options", root);
+    if (copy_options(options, path) < 0) {
+        fprintf(stderr, "stub pppd: can't copy %s: %s\n", options, strerror(errno));
+        return 2;
+    }
+    if (delay) {
+        ts.tv_sec = atoi(delay) / 1000;
+        ts.tv_nsec = (atoi(delay) % 1000) * 1000000L;
+        nanosleep(&ts, NULL);
+    }
+    if (fail)
+        return atoi(fail);
+
+    /* detach, the parent only returns once the pid file is in place */
+    snprintf(pid_path, sizeof(pid_path), "%s/etc/ppp/ppp0.pid", root);
+    if (pipe(sync) < 0)
+        return 1;
+    pid = fork();
+    if (pid < 0)
+        return 1;
+    if (pid > 0) {
+        close(sync[1]);
+        return read(sync[0], &c, 1) == 1 ? 0 : 1;
+    }
+
+    setsid();
+    signal(SIGTERM, on_term);
+    /* don't keep the shim's modem or pipes alive */
+    for (fd = 3; fd < 256; fd++) {
+        if (fd != sync[1])
+            close(fd);
+    }
+    fd = open(pid_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+        return 1;
+    snprintf(path, sizeof(path), "%d\n", getpid());
+    write(fd, path, strlen(path));
+    close(fd);
+    write(sync[1], "", 1);
+    close(sync[1]);
+
+    for (;;)
+        pause();
+}
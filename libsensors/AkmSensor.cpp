@@ -27,34 +27,76 @@
 #include <cutils/log.h>
 
 #include "AkmSensor.h"
+#include "HalTrace.h"
+#include "SensorTable.h"
 
 /*****************************************************************************/
 
+// ECS_IOCTL_APP_{GET,SET}_*FLAG by slot
+static const unsigned int sGetFlagCmd[AkmSensor::numHwSensors] = {
+        ECS_IOCTL_APP_GET_AFLAG, ECS_IOCTL_APP_GET_MVFLAG, ECS_IOCTL_APP_GET_MFLAG };
+static const unsigned int sSetFlagCmd[AkmSensor::numHwSensors] = {
+        ECS_IOCTL_APP_SET_AFLAG, ECS_IOCTL_APP_SET_MVFLAG, ECS_IOCTL_APP_SET_MFLAG };
+
+static const uint32_t sStepMask =
+        (1<<AkmSensor::StepDetector) | (1<<AkmSensor::StepCounter);
+
+// the chip sensors needed for a set of enabled sensors
+static uint32_t hwSensorsFor(uint32_t enabled) {
+    uint32_t hw = enabled & ((1<<AkmSensor::numHwSensors) - 1);
+    // the accelerometer also tells when the rate can be lowered
+    if ((enabled & sStepMask) || (enabled && AKM_STILL_DELAY_NS))
+        hw |= 1<<AkmSensor::Accelerometer;
+    return hw;
+}
+
 AkmSensor::AkmSensor()
-: SensorBase(AKM_DEVICE_NAME, "compass"),
+: SensorDriver<AkmSensor>(AKM_DEVICE_NAME, "compass"),
       mEnabled(0),
+      mHwEnabled(0),
       mPendingMask(0),
-      mInputReader(32)
+      mInputReader(32),
+      mFifo(AKM_FIFO_SAMPLES),
+      mReportSteps(false),
+      mStill(false),
+      mHaveMean(false),
+      mLastMotion(0),
+      mHwDelayNs(0),
+      mDropped(0)
 {
+    memset(mAccelMean, 0, sizeof(mAccelMean));
+    memset(mLastEmit, 0, sizeof(mLastEmit));
     memset(mPendingEvents, 0, sizeof(mPendingEvents));
+    memset(mScales, 0, sizeof(mScales));
+    memset(mRaw, 0, sizeof(mRaw));
+    memset(mStatus, SENSOR_STATUS_ACCURACY_HIGH, sizeof(mStatus));
+
+#define AKM_SENSOR(id, name, vendor, type_, range, res, power, driver, slot) \
+    if (driver == DRIVER_AKM) {                                             \
+        mPendingEvents[slot].version = sizeof(sensors_event_t);             \
+        mPendingEvents[slot].sensor = ID_##id;                              \
+        mPendingEvents[slot].type = type_;                                  \
+        mPendingEvents[slot].acceleration.status = SENSOR_STATUS_ACCURACY_HIGH; \
+    }
+    SENSOR_TABLE(AKM_SENSOR)
+#undef AKM_SENSOR
 
-    mPendingEvents[Accelerometer].version = sizeof(sensors_event_t);
-    mPendingEvents[Accelerometer].sensor = ID_A;
-    mPendingEvents[Accelerometer].type = SENSOR_TYPE_ACCELEROMETER;
-    mPendingEvents[Accelerometer].acceleration.status = SENSOR_STATUS_ACCURACY_HIGH;
-
-    mPendingEvents[MagneticField].version = sizeof(sensors_event_t);
-    mPendingEvents[MagneticField].sensor = ID_M;
-    mPendingEvents[MagneticField].type = SENSOR_TYPE_MAGNETIC_FIELD;
-    mPendingEvents[MagneticField].magnetic.status = SENSOR_STATUS_ACCURACY_HIGH;
-
-    mPendingEvents[Orientation  ].version = sizeof(sensors_event_t);
-    mPendingEvents[Orientation  ].sensor = ID_O;
-    mPendingEvents[Orientation  ].type = SENSOR_TYPE_ORIENTATION;
-    mPendingEvents[Orientation  ].orientation.status = SENSOR_STATUS_ACCURACY_HIGH;
-
-    for (int i=0 ; i<numSensors ; i++)
+    for (int i=0 ; i<=ABS_MAX ; i++) {
+        mAxes[i].slot = -1;
+        mAxes[i].axis = 0;
+    }
+#define AKM_AXIS(code, id, axis_, scale_)                                   \
+    mAxes[code].slot = handleToSlot(ID_##id, DRIVER_AKM);                   \
+    mAxes[code].axis = axis_;                                               \
+    if (axis_ != AXIS_STATUS) /* % keeps the dead index in range */          \
+        mScales[mAxes[code].slot][axis_ % 3] = scale_;
+    AKM_AXIS_TABLE(AKM_AXIS)
+#undef AKM_AXIS
+
+    for (int i=0 ; i<numHwSensors ; i++)
         mDelays[i] = 200000000; // 200 ms by default
+    mDelays[StepDetector] = STEP_DELAY_NS;
+    mDelays[StepCounter] = STEP_DELAY_NS;
 
     // read the actual value of all sensors if they're enabled already
     struct input_absinfo absinfo;
@@ -62,58 +104,27 @@ AkmSensor::AkmSensor()
 
     open_device();
 
-    if (!ioctl(dev_fd, ECS_IOCTL_APP_GET_AFLAG, &flags)) {
-        if (flags)  {
-            mEnabled |= 1<<Accelerometer;
-            if (!ioctl(data_fd, EVIOCGABS(EVENT_TYPE_ACCEL_X), &absinfo)) {
-                mPendingEvents[Accelerometer].acceleration.x = absinfo.value * CONVERT_A_X;
-            }
-            if (!ioctl(data_fd, EVIOCGABS(EVENT_TYPE_ACCEL_Y), &absinfo)) {
-                mPendingEvents[Accelerometer].acceleration.y = absinfo.value * CONVERT_A_Y;
-            }
-            if (!ioctl(data_fd, EVIOCGABS(EVENT_TYPE_ACCEL_Z), &absinfo)) {
-                mPendingEvents[Accelerometer].acceleration.z = absinfo.value * CONVERT_A_Z;
-            }
-        }
-    }
-    if (!ioctl(dev_fd, ECS_IOCTL_APP_GET_MVFLAG, &flags)) {
-        if (flags)  {
-            mEnabled |= 1<<MagneticField;
-            if (!ioctl(data_fd, EVIOCGABS(EVENT_TYPE_MAGV_X), &absinfo)) {
-                mPendingEvents[MagneticField].magnetic.x = absinfo.value * CONVERT_M_X;
-            }
-            if (!ioctl(data_fd, EVIOCGABS(EVENT_TYPE_MAGV_Y), &absinfo)) {
-                mPendingEvents[MagneticField].magnetic.y = absinfo.value * CONVERT_M_Y;
-            }
-            if (!ioctl(data_fd, EVIOCGABS(EVENT_TYPE_MAGV_Z), &absinfo)) {
-                mPendingEvents[MagneticField].magnetic.z = absinfo.value * CONVERT_M_Z;
-            }
+    for (int i=0 ; i<numHwSensors ; i++) {
+        if (!ioctl(dev_fd, sGetFlagCmd[i], &flags) && flags) {
+            mEnabled |= 1<<i;
         }
     }
-    if (!ioctl(dev_fd, ECS_IOCTL_APP_GET_MFLAG, &flags)) {
-        if (flags)  {
-            mEnabled |= 1<<Orientation;
-            if (!ioctl(data_fd, EVIOCGABS(EVENT_TYPE_YAW), &absinfo)) {
-                mPendingEvents[Orientation].orientation.azimuth = absinfo.value;
-            }
-            if (!ioctl(data_fd, EVIOCGABS(EVENT_TYPE_PITCH), &absinfo)) {
-                mPendingEvents[Orientation].orientation.pitch = absinfo.value;
-            }
-            if (!ioctl(data_fd, EVIOCGABS(EVENT_TYPE_ROLL), &absinfo)) {
-                mPendingEvents[Orientation].orientation.roll = -absinfo.value;
-            }
-            if (!ioctl(data_fd, EVIOCGABS(EVENT_TYPE_ORIENT_STATUS), &absinfo)) {
-                mPendingEvents[Orientation].orientation.status = uint8_t(absinfo.value & SENSOR_STATE_MASK);
+    mHwEnabled = mEnabled;
+    for (int code=0 ; mEnabled && code<=ABS_MAX ; code++) {
+        if (mAxes[code].slot >= 0 && (mEnabled & (1<<mAxes[code].slot))) {
+            if (!ioctl(data_fd, EVIOCGABS(code), &absinfo)) {
+                processEvent(code, absinfo.value);
             }
         }
     }
+    mPendingMask = 0;
 
     // disable temperature sensor, since it is not reported
     flags = 0;
     ioctl(dev_fd, ECS_IOCTL_APP_SET_TFLAG, &flags);
 
     if (!mEnabled) {
-        close_device();
+        close_device(true);
     }
 }
 
@@ -122,61 +133,73 @@ AkmSensor::~AkmSensor() {
 
 int AkmSensor::enable(int32_t handle, int en)
 {
-    int what = -1;
-    switch (handle) {
-        case ID_A: what = Accelerometer; break;
-        case ID_M: what = MagneticField; break;
-        case ID_O: what = Orientation;   break;
-    }
-
+    int what = handleToSlot(handle, DRIVER_AKM);
     if (uint32_t(what) >= numSensors)
         return -EINVAL;
 
-    int newState  = en ? 1 : 0;
-    int err = 0;
+    uint32_t enabled = en ? (mEnabled | (1<<what)) : (mEnabled & ~(1<<what));
+    if (enabled == mEnabled)
+        return 0;
 
-    if ((uint32_t(newState)<<what) != (mEnabled & (1<<what))) {
-        if (!mEnabled) {
-            open_device();
+    int err = setHwEnabled(hwSensorsFor(enabled));
+    if (!err) {
+        if ((enabled & sStepMask) && !(mEnabled & sStepMask)) {
+            mSteps.reset();
         }
-        int cmd;
-        switch (what) {
-            case Accelerometer: cmd = ECS_IOCTL_APP_SET_AFLAG;  break;
-            case MagneticField: cmd = ECS_IOCTL_APP_SET_MVFLAG; break;
-            case Orientation:   cmd = ECS_IOCTL_APP_SET_MFLAG;  break;
-        }
-        short flags = newState;
-        err = ioctl(dev_fd, cmd, &flags);
-        err = err<0 ? -errno : 0;
-        LOGE_IF(err, "ECS_IOCTL_APP_SET_XXX failed (%s)", strerror(-err));
-        if (!err) {
-            mEnabled &= ~(1<<what);
-            mEnabled |= (uint32_t(flags)<<what);
-            update_delay();
+        if ((enabled & ~mEnabled) & (1<<StepCounter)) {
+            // the counter reports its current value when activated
+            mReportSteps = true;
         }
+        mEnabled = enabled;
         if (!mEnabled) {
-            close_device();
+            mStill = false;
+            mHaveMean = false;
         }
+        update_delay();
     }
     return err;
 }
 
-int AkmSensor::setDelay(int32_t handle, int64_t ns)
+int AkmSensor::setHwEnabled(uint32_t wanted)
 {
-#ifdef ECS_IOCTL_APP_SET_DELAY
-    int what = -1;
-    switch (handle) {
-        case ID_A: what = Accelerometer; break;
-        case ID_M: what = MagneticField; break;
-        case ID_O: what = Orientation;   break;
+    if (wanted == mHwEnabled)
+        return 0;
+
+    int err = 0;
+    if (!mHwEnabled) {
+        open_device();
+    }
+    for (int i=0 ; i<numHwSensors ; i++) {
+        if ((wanted ^ mHwEnabled) & (1<<i)) {
+            short flags = (wanted >> i) & 1;
+            if (ioctl(dev_fd, sSetFlagCmd[i], &flags) < 0) {
+                err = -errno;
+                LOGE("ECS_IOCTL_APP_SET_XXX failed (%s)", strerror(-err));
+                break;
+            }
+            mHwEnabled ^= 1<<i;
+        }
     }
+    if (!mHwEnabled) {
+        close_device();
+    }
+    return err;
+}
 
+int AkmSensor::setDelay(int32_t handle, int64_t ns)
+{
+#ifdef ECS_IOCTL_APP_SET_DELAY
+    int what = handleToSlot(handle, DRIVER_AKM);
     if (uint32_t(what) >= numSensors)
         return -EINVAL;
 
     if (ns < 0)
         return -EINVAL;
 
+    if (what >= numHwSensors) {
+        // the step sensors run the accelerometer at STEP_DELAY_NS
+        return 0;
+    }
     mDelays[what] = ns;
     return update_delay();
 #else
@@ -194,6 +217,9 @@ int AkmSensor::update_delay()
                 wanted = wanted < ns ? wanted : ns;
             }
         }
+        if (mStill && wanted < uint64_t(AKM_STILL_DELAY_NS))
+            wanted = AKM_STILL_DELAY_NS;
+        mHwDelayNs = wanted;
         short delay = int64_t(wanted) / 1000000;
         if (ioctl(dev_fd, ECS_IOCTL_APP_SET_DELAY, &delay)) {
             return -errno;
@@ -202,94 +228,249 @@ int AkmSensor::update_delay()
     return 0;
 }
 
+void AkmSensor::getStats(sensor_driver_stats_t* stats) const
+{
+    stats->evdevEvents = mInputReader.getEventsRead();
+    stats->partialReads = mInputReader.getPartialReads();
+    stats->ringFull = mInputReader.getRingFull();
+    stats->dropped = mDropped + mFifo.getDropped() + mFifo.getOutOfOrder();
+}
+
 int AkmSensor::readEvents(sensors_event_t* data, int count)
 {
+    SENSORS_TRACE_CALL("AkmSensor::readEvents");
     if (count < 1)
         return -EINVAL;
 
     ssize_t n = mInputReader.fill(data_fd);
-    if (n < 0)
-        return n;
 
-    int numEventReceived = 0;
-    input_event const* event;
-
-    while (count && mInputReader.readEvent(&event)) {
-        int type = event->type;
-        if (type == EV_ABS) {
-            processEvent(event->code, event->value);
-            mInputReader.next();
-        } else if (type == EV_SYN) {
-            int64_t time = timevalToNano(event->time);
-            for (int j=0 ; count && mPendingMask && j<numSensors ; j++) {
-                if (mPendingMask & (1<<j)) {
-                    mPendingMask &= ~(1<<j);
-                    mPendingEvents[j].timestamp = time;
-                    if (mEnabled & (1<<j)) {
-                        *data++ = mPendingEvents[j];
-                        count--;
-                        numEventReceived++;
+    // everything in the ring is decoded right away into compact samples,
+    // they are expanded only as far as the caller has room for
+    input_event const* events;
+    ssize_t avail;
+
+    while ((avail = mInputReader.getSpan(&events))) {
+        for (ssize_t i=0 ; i<avail ; i++) {
+            input_event const* event = &events[i];
+            int type = event->type;
+            if (type == EV_ABS) {
+                processEvent(event->code, event->value);
+            } else if (type == EV_SYN) {
+                int64_t time = eventTimestamp(event->time);
+                if (mStill) {
+                    // the repeats dated before this reading go first
+                    synthesizeHeld(time - 1);
+                }
+                if ((mPendingMask & (1<<Accelerometer)) && AKM_STILL_DELAY_NS) {
+                    processMotion(time);
+                }
+                if ((mPendingMask & (1<<Accelerometer)) && (mEnabled & sStepMask)) {
+                    processSteps(time);
+                    if (!(mEnabled & (1<<Accelerometer)))
+                        mPendingMask &= ~(1<<Accelerometer);
+                }
+                for (int j=0 ; mPendingMask && j<numHwSensors ; j++) {
+                    if (mPendingMask & (1<<j)) {
+                        if (mEnabled & (1<<j)) {
+                            queueSample(j, time, mRaw[j], mStatus[j]);
+                            mLastEmit[j] = time;
+                        } else {
+                            mDropped++;
+                        }
                     }
                 }
+                mPendingMask = 0;
+            } else {
+                LOGE("AkmSensor: unknown event (type=%d, code=%d)",
+                        type, event->code);
             }
-            if (!mPendingMask) {
-                mInputReader.next();
-            }
-        } else {
-            LOGE("AkmSensor: unknown event (type=%d, code=%d)",
-                    type, event->code);
-            mInputReader.next();
         }
+        mInputReader.consume(avail);
     }
 
-    return numEventReceived;
+    if (mStill || mReportSteps) {
+        const int64_t now = getTimestamp();
+        if (mStill) {
+            synthesizeHeld(now - AKM_INPUT_LATENCY_NS);
+        }
+        if (mReportSteps && (mEnabled & (1<<StepCounter))) {
+            // dated like a repeat, but never before what is queued
+            uint32_t steps = mSteps.getSteps();
+            int16_t raw[3] = { int16_t(steps), int16_t(steps >> 16), 0 };
+            int64_t time = now - AKM_INPUT_LATENCY_NS;
+            if (time < mFifo.getNewest())
+                time = mFifo.getNewest();
+            queueSample(StepCounter, time, raw, 0);
+        }
+        mReportSteps = false;
+    }
+
+    if (n < 0 && mFifo.empty())
+        return n;
+    return deliverSamples(data, count);
 }
 
-void AkmSensor::processEvent(int code, int value)
+// samples go into the fifo in timestamp order; one dated before what is
+// already queued would be delivered out of order, so it is dropped
+void AkmSensor::queueSample(int slot, int64_t time, int16_t const* raw, int status)
 {
-    switch (code) {
-        case EVENT_TYPE_ACCEL_X:
-            mPendingMask |= 1<<Accelerometer;
-            mPendingEvents[Accelerometer].acceleration.x = value * CONVERT_A_X;
-            break;
-        case EVENT_TYPE_ACCEL_Y:
-            mPendingMask |= 1<<Accelerometer;
-            mPendingEvents[Accelerometer].acceleration.y = value * CONVERT_A_Y;
-            break;
-        case EVENT_TYPE_ACCEL_Z:
-            mPendingMask |= 1<<Accelerometer;
-            mPendingEvents[Accelerometer].acceleration.z = value * CONVERT_A_Z;
-            break;
+    if (!mFifo.push(slot, time, raw, status)) {
+        LOGW("AkmSensor: dropped sample of sensor %d dated %lld, before the "
+                "last one queued", slot, (long long)time);
+    }
+}
 
-        case EVENT_TYPE_MAGV_X:
-            mPendingMask |= 1<<MagneticField;
-            mPendingEvents[MagneticField].magnetic.x = value * CONVERT_M_X;
-            break;
-        case EVENT_TYPE_MAGV_Y:
-            mPendingMask |= 1<<MagneticField;
-            mPendingEvents[MagneticField].magnetic.y = value * CONVERT_M_Y;
-            break;
-        case EVENT_TYPE_MAGV_Z:
-            mPendingMask |= 1<<MagneticField;
-            mPendingEvents[MagneticField].magnetic.z = value * CONVERT_M_Z;
-            break;
+void AkmSensor::processSteps(int64_t time)
+{
+    const int16_t* raw = mRaw[Accelerometer];
+    const float* scale = mScales[Accelerometer];
+    int steps = mSteps.process(raw[0] * scale[0], raw[1] * scale[1],
+            raw[2] * scale[2], time);
+    if (!steps)
+        return;
+
+    static const int16_t none[3] = { 0, 0, 0 };
+    for (int i=0 ; i<steps && (mEnabled & (1<<StepDetector)) ; i++) {
+        queueSample(StepDetector, time, none, 0);
+    }
+    if (mEnabled & (1<<StepCounter)) {
+        uint32_t total = mSteps.getSteps();
+        int16_t count[3] = { int16_t(total), int16_t(total >> 16), 0 };
+        queueSample(StepCounter, time, count, 0);
+    }
+}
 
-        case EVENT_TYPE_YAW:
-            mPendingMask |= 1<<Orientation;
-            mPendingEvents[Orientation].orientation.azimuth = value * CONVERT_O_Y;
-            break;
-        case EVENT_TYPE_PITCH:
-            mPendingMask |= 1<<Orientation;
-            mPendingEvents[Orientation].orientation.pitch = value * CONVERT_O_P;
-            break;
-        case EVENT_TYPE_ROLL:
-            mPendingMask |= 1<<Orientation;
-            mPendingEvents[Orientation].orientation.roll = value * CONVERT_O_R;
-            break;
-        case EVENT_TYPE_ORIENT_STATUS:
-            mPendingMask |= 1<<Orientation;
-            mPendingEvents[Orientation].orientation.status =
-                    uint8_t(value & SENSOR_STATE_MASK);
+void AkmSensor::processMotion(int64_t time)
+{
+    const int16_t* raw = mRaw[Accelerometer];
+    const float* scale = mScales[Accelerometer];
+    bool moving = !mHaveMean;
+    for (int k=0 ; k<3 ; k++) {
+        const float a = raw[k] * scale[k];
+        if (!mHaveMean) {
+            mAccelMean[k] = a;
+        } else if (fabsf(a - mAccelMean[k]) > AKM_MOTION_THRESHOLD) {
+            moving = true;
+        }
+        mAccelMean[k] += (a - mAccelMean[k]) * 0.25f;
+    }
+    mHaveMean = true;
+
+    if (moving) {
+        mLastMotion = time;
+        if (mStill) {
+            mStill = false;
+            update_delay();
+        }
+    } else if (!mStill && time - mLastMotion >= AKM_STILL_NS) {
+        mStill = true;
+        for (int j=0 ; j<numHwSensors ; j++) {
+            mLastEmit[j] = time;
+        }
+        update_delay();
+    }
+}
+
+// rate at which the readings of slot are repeated while the chip is slowed
+// down, or 0 if the chip still runs fast enough for it
+int64_t AkmSensor::heldPeriod(int slot) const
+{
+    if (!(mEnabled & (1<<slot)) || int64_t(mDelays[slot]) >= mHwDelayNs)
+        return 0;
+    // setDelay(0) means as fast as possible, which the chip isn't anyway
+    return mDelays[slot] > 10000000 ? int64_t(mDelays[slot]) : 10000000;
+}
+
+// queues the repeats due up to now, of all sensors merged in timestamp order
+void AkmSensor::synthesizeHeld(int64_t now)
+{
+    int64_t period[numHwSensors];
+    for (int j=0 ; j<numHwSensors ; j++) {
+        period[j] = heldPeriod(j);
+        if (period[j] && now - mLastEmit[j] > 2*mHwDelayNs) {
+            // we weren't polled for a while, don't make up a burst
+            mLastEmit[j] = now - period[j];
+        }
+    }
+    for (;;) {
+        int next = -1;
+        for (int j=0 ; j<numHwSensors ; j++) {
+            if (period[j] && mLastEmit[j] + period[j] <= now && (next < 0 ||
+                    mLastEmit[j] + period[j] < mLastEmit[next] + period[next]))
+                next = j;
+        }
+        if (next < 0)
             break;
+        mLastEmit[next] += period[next];
+        queueSample(next, mLastEmit[next], mRaw[next], mStatus[next]);
+    }
+}
+
+int64_t AkmSensor::getPendingDeadline() const
+{
+    int64_t deadline = -1;
+    for (int j=0 ; mStill && j<numHwSensors ; j++) {
+        const int64_t period = heldPeriod(j);
+        if (period && (deadline < 0 || mLastEmit[j] + period < deadline))
+            deadline = mLastEmit[j] + period;
+    }
+    return deadline < 0 ? deadline : deadline + AKM_INPUT_LATENCY_NS;
+}
+
+bool AkmSensor::hasPendingEvents() const
+{
+    if (!mFifo.empty() || mReportSteps)
+        return true;
+    int64_t deadline = getPendingDeadline();
+    return deadline >= 0 && getTimestamp() >= deadline;
+}
+
+int AkmSensor::deliverSamples(sensors_event_t* data, int count)
+{
+    int numEventReceived = 0;
+    sensor_sample_t sample;
+    int64_t time;
+
+    while (count && mFifo.pop(&sample, &time)) {
+        const int j = sample.slot;
+        if (!(mEnabled & (1<<j))) {
+            // disabled since it was buffered
+            mDropped++;
+            continue;
+        }
+        *data = mPendingEvents[j];
+        if (j == StepDetector) {
+            data->data[0] = 1.0f;
+        } else if (j == StepCounter) {
+            data->data[0] = float(uint16_t(sample.raw[0]) |
+                    (uint32_t(uint16_t(sample.raw[1])) << 16));
+        } else {
+            data->acceleration.x = sample.raw[0] * mScales[j][0];
+            data->acceleration.y = sample.raw[1] * mScales[j][1];
+            data->acceleration.z = sample.raw[2] * mScales[j][2];
+            data->acceleration.status = sample.status;
+        }
+        data->timestamp = time;
+        data++;
+        count--;
+        numEventReceived++;
+    }
+
+    return numEventReceived;
+}
+
+void AkmSensor::processEvent(int code, int value)
+{
+    if (uint32_t(code) > ABS_MAX)
+        return;
+    const axis_t& a(mAxes[code]);
+    if (a.slot < 0)
+        return;
+    mPendingMask |= 1<<a.slot;
+    // the AK8973 and BMA150 values are at most 12 bits wide
+    if (a.axis == AXIS_STATUS) {
+        mStatus[a.slot] = uint8_t(value & SENSOR_STATE_MASK);
+    } else {
+        mRaw[a.slot][a.axis] = int16_t(value);
     }
 }
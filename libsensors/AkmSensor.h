@@ -24,14 +24,16 @@
 
 
 #include "nusensors.h"
-#include "SensorBase.h"
+#include "SensorDriver.h"
 #include "InputEventReader.h"
+#include "SampleFifo.h"
+#include "StepDetector.h"
 
 /*****************************************************************************/
 
 struct input_event;
 
-class AkmSensor : public SensorBase {
+class AkmSensor : public SensorDriver<AkmSensor> {
 public:
             AkmSensor();
     virtual ~AkmSensor();
@@ -40,21 +42,62 @@ public:
         Accelerometer   = 0,
         MagneticField   = 1,
         Orientation     = 2,
+        numHwSensors,
+        // computed from the accelerometer
+        StepDetector    = numHwSensors,
+        StepCounter,
         numSensors
     };
 
     virtual int setDelay(int32_t handle, int64_t ns);
     virtual int enable(int32_t handle, int enabled);
     virtual int readEvents(sensors_event_t* data, int count);
+    virtual bool hasPendingEvents() const;
+    virtual int64_t getPendingDeadline() const;
+    virtual void getStats(sensor_driver_stats_t* stats) const;
     void processEvent(int code, int value);
 
 private:
+    // what an ABS code of the compass input device updates, slot is -1
+    // for codes that aren't reported
+    struct axis_t {
+        int8_t slot;
+        int8_t axis;
+    };
+
     int update_delay();
+    int setHwEnabled(uint32_t wanted);
+    void processSteps(int64_t time);
+    void processMotion(int64_t time);
+    int64_t heldPeriod(int slot) const;
+    void synthesizeHeld(int64_t now);
+    void queueSample(int slot, int64_t time, int16_t const* raw, int status);
+    int deliverSamples(sensors_event_t* data, int count);
+    axis_t mAxes[ABS_MAX+1];
+    float mScales[numSensors][3];
     uint32_t mEnabled;
+    uint32_t mHwEnabled;        // ECS_IOCTL_APP_SET_*FLAG state
     uint32_t mPendingMask;
     InputEventCircularReader mInputReader;
+    // readings are buffered raw and only expanded from these templates
     sensors_event_t mPendingEvents[numSensors];
+    int16_t mRaw[numSensors][3];
+    uint8_t mStatus[numSensors];
+    SampleFifo mFifo;
+    ::StepDetector mSteps;
+    // the counter's value is reported once the input read at its
+    // activation is queued, so that it isn't dated before any of it
+    bool mReportSteps;
+
+    // motion adaptive rate, see AKM_STILL_DELAY_NS
+    bool mStill;
+    bool mHaveMean;
+    float mAccelMean[3];
+    int64_t mLastMotion;
+    int64_t mHwDelayNs;
+    int64_t mLastEmit[numHwSensors];
     uint64_t mDelays[numSensors];
+    uint32_t mDropped;
 };
 
 /*****************************************************************************/
@@ -28,6 +28,10 @@ LOCAL_MODULE_PATH := $(TARGET_OUT_SHARED_LIBRARIES)/hw
 LOCAL_MODULE_TAGS := optional
 
 LOCAL_CFLAGS := -DLOG_TAG=\"Sensors\"
+# trace points, see HalTrace.h
+#LOCAL_CFLAGS += -DSENSORS_TRACE
+LOCAL_C_INCLUDES := $(LOCAL_PATH)/../libhaltrace
+LOCAL_STATIC_LIBRARIES := libhaltrace.leo
 LOCAL_SRC_FILES := 						\
 				sensors.c 				\
 				nusensors.cpp 			\
@@ -35,7 +39,12 @@ LOCAL_SRC_FILES := 						\
 				SensorBase.cpp			\
 				LightSensor.cpp			\
 				ProximitySensor.cpp		\
-				AkmSensor.cpp
+				AkmSensor.cpp			\
+				OnChangeFilter.cpp		\
+				SampleFifo.cpp			\
+				SensorMux.cpp			\
+				StepDetector.cpp		\
+				HalTrace.cpp
 				
 LOCAL_SHARED_LIBRARIES := liblog libcutils
 LOCAL_PRELINK_MODULE := false
@@ -43,3 +52,5 @@ LOCAL_PRELINK_MODULE := false
 include $(BUILD_SHARED_LIBRARY)
 
 endif # !TARGET_SIMULATOR
+
+include $(call all-makefiles-under,$(LOCAL_PATH))
@@ -0,0 +1,71 @@
+/*
+ * Copyright (C) 2011 The CyanogenMod Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_HAL_TRACE_H
+#define ANDROID_HAL_TRACE_H
+
+#include <stdint.h>
+#include <sys/cdefs.h>
+
+/*****************************************************************************/
+
+/*
+ * Begin/end spans and counters for the HAL hot paths, recorded by the
+ * shared libhaltrace. Compiled in with SENSORS_TRACE (see Android.mk) and
+ * switched on with "setprop debug.sensors.trace 1" before the HAL is
+ * opened; while off every trace point costs one not-taken branch.
+ */
+
+#ifdef SENSORS_TRACE
+
+#include "haltrace.h"
+
+extern struct hal_trace sensors_trace;
+
+class SensorsScopedTrace {
+    const int mActive;
+public:
+    inline SensorsScopedTrace(const char* name)
+        : mActive(__builtin_expect(sensors_trace.enabled, 0)) {
+        if (mActive)
+            hal_trace_record(&sensors_trace, 'B', name, 0);
+    }
+    inline ~SensorsScopedTrace() {
+        if (mActive)
+            hal_trace_record(&sensors_trace, 'E', "", 0);
+    }
+};
+
+#define SENSORS_TRACE_INIT()            hal_trace_init(&sensors_trace)
+#define SENSORS_TRACE_CALL(name)        SensorsScopedTrace sensorsTrace_(name)
+#define SENSORS_TRACE_INT(name, value)  do {                        \
+        if (__builtin_expect(sensors_trace.enabled, 0))             \
+            hal_trace_record(&sensors_trace, 'C', name, value);     \
+    } while (0)
+#define SENSORS_TRACE_DUMP(fd)          hal_trace_dump(&sensors_trace, fd)
+
+#else
+
+#define SENSORS_TRACE_INIT()            ((void)0)
+#define SENSORS_TRACE_CALL(name)        ((void)0)
+#define SENSORS_TRACE_INT(name, value)  ((void)0)
+#define SENSORS_TRACE_DUMP(fd)          ((void)0)
+
+#endif
+
+/*****************************************************************************/
+
+#endif  // ANDROID_HAL_TRACE_H
@@ -27,6 +27,7 @@
 #include <cutils/log.h>
 
 #include "InputEventReader.h"
+#include "HalTrace.h"
 
 /*****************************************************************************/
 
@@ -37,7 +38,10 @@ InputEventCircularReader::InputEventCircularReader(size_t numEvents)
       mBufferEnd(mBuffer + numEvents),
       mHead(mBuffer),
       mCurr(mBuffer),
-      mFreeSpace(numEvents)
+      mFreeSpace(numEvents),
+      mEventsRead(0),
+      mPartialReads(0),
+      mRingFull(0)
 {
 }
 
@@ -48,15 +52,21 @@ InputEventCircularReader::~InputEventCircularReader()
 
 ssize_t InputEventCircularReader::fill(int fd)
 {
+    SENSORS_TRACE_CALL("fill");
     size_t numEventsRead = 0;
     if (mFreeSpace) {
         const ssize_t nread = read(fd, mHead, mFreeSpace * sizeof(input_event));
         if (nread<0 || nread % sizeof(input_event)) {
             // we got a partial event!!
+            if (nread >= 0) {
+                mPartialReads++;
+                LOGW("partial input event read (%d bytes)", int(nread));
+            }
             return nread<0 ? -errno : -EINVAL;
         }
 
         numEventsRead = nread / sizeof(input_event);
+        mEventsRead += numEventsRead;
         if (numEventsRead) {
             mHead += numEventsRead;
             mFreeSpace -= numEventsRead;
@@ -66,6 +76,9 @@ ssize_t InputEventCircularReader::fill(int fd)
                 mHead = mBuffer + s;
             }
         }
+    } else {
+        // the driver still has unconsumed events, the kernel keeps queueing
+        mRingFull++;
     }
 
     return numEventsRead;
@@ -78,6 +91,23 @@ ssize_t InputEventCircularReader::readEvent(input_event const** events)
     return available ? 1 : 0;
 }
 
+ssize_t InputEventCircularReader::getSpan(input_event const** events) const
+{
+    *events = mCurr;
+    ssize_t available = (mBufferEnd - mBuffer) - mFreeSpace;
+    ssize_t contiguous = mBufferEnd - mCurr;
+    return available < contiguous ? available : contiguous;
+}
+
+void InputEventCircularReader::consume(size_t n)
+{
+    mCurr += n;
+    mFreeSpace += n;
+    if (mCurr >= mBufferEnd) {
+        mCurr = mBuffer;
+    }
+}
+
 void InputEventCircularReader::next()
 {
     mCurr++;
@@ -34,12 +34,26 @@ class InputEventCircularReader
     struct input_event* mCurr;
     ssize_t mFreeSpace;
 
+    uint32_t mEventsRead;
+    uint32_t mPartialReads;
+    uint32_t mRingFull;
+
 public:
     InputEventCircularReader(size_t numEvents);
     ~InputEventCircularReader();
     ssize_t fill(int fd);
     ssize_t readEvent(input_event const** events);
     void next();
+
+    // the buffered events that are contiguous in memory starting at the
+    // oldest one, i.e. up to the wrap point; consume() then releases the
+    // first n of them. Call again after consume() to get the rest.
+    ssize_t getSpan(input_event const** events) const;
+    void consume(size_t n);
+
+    uint32_t getEventsRead() const { return mEventsRead; }
+    uint32_t getPartialReads() const { return mPartialReads; }
+    uint32_t getRingFull() const { return mRingFull; }
 };
 
 /*****************************************************************************/
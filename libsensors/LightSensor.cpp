@@ -27,14 +27,17 @@
 #include <cutils/log.h>
 
 #include "LightSensor.h"
+#include "HalTrace.h"
 
 /*****************************************************************************/
 
 LightSensor::LightSensor()
-    : SensorBase(LS_DEVICE_NAME, "lightsensor-level"),
+    : SensorDriver<LightSensor>(LS_DEVICE_NAME, "lightsensor-level"),
       mEnabled(0),
       mInputReader(4),
-      mHasPendingEvent(false)
+      mHasPendingEvent(false),
+      mFilter(LIGHT_JITTER_STEPS, LIGHT_DEBOUNCE_NS),
+      mIndex(0)
 {
     mPendingEvent.version = sizeof(sensors_event_t);
     mPendingEvent.sensor = ID_L;
@@ -52,7 +55,7 @@ LightSensor::LightSensor()
     }
 
     if (!mEnabled) {
-        close_device();
+        close_device(true);
     }
 }
 
@@ -62,7 +65,11 @@ LightSensor::~LightSensor() {
 int LightSensor::setInitialState() {
     struct input_absinfo absinfo;
     if (!ioctl(data_fd, EVIOCGABS(EVENT_TYPE_LIGHT), &absinfo)) {
-        mPendingEvent.light = indexToValue(absinfo.value);
+        // always report the current level, changes are filtered against it
+        mIndex = absinfo.value;
+        mFilter.reset();
+        mFilter.filter(mIndex, getTimestamp());
+        mPendingEvent.light = indexToValue(mIndex);
         mHasPendingEvent = true;
     }
     return 0;
@@ -82,6 +89,9 @@ int LightSensor::enable(int32_t, int en) {
             mEnabled = en ? 1 : 0;
             if (en) {
                 setInitialState();
+            } else {
+                LOGD("LightSensor: %u of %u events suppressed",
+                        mFilter.getSuppressed(), mFilter.getReceived());
             }
         }
         if (!mEnabled) {
@@ -92,17 +102,48 @@ int LightSensor::enable(int32_t, int en) {
 }
 
 bool LightSensor::hasPendingEvents() const {
-    return mHasPendingEvent;
+    if (mHasPendingEvent)
+        return true;
+    int64_t deadline = mFilter.getDeadline();
+    return deadline >= 0 && getTimestamp() >= deadline;
+}
+
+int64_t LightSensor::getPendingDeadline() const {
+    return mFilter.getDeadline();
+}
+
+int LightSensor::setDelay(int32_t, int64_t ns) {
+    if (ns < 0)
+        return -EINVAL;
+    // on-change sensor: the delay only bounds how often we report
+    mFilter.setMinInterval(ns);
+    return 0;
+}
+
+void LightSensor::getStats(sensor_driver_stats_t* stats) const {
+    stats->evdevEvents = mInputReader.getEventsRead();
+    stats->partialReads = mInputReader.getPartialReads();
+    stats->ringFull = mInputReader.getRingFull();
+    stats->dropped = mFilter.getSuppressed();
 }
 
 int LightSensor::readEvents(sensors_event_t* data, int count)
 {
+    SENSORS_TRACE_CALL("LightSensor::readEvents");
     if (count < 1)
         return -EINVAL;
 
     if (mHasPendingEvent) {
         mHasPendingEvent = false;
-        mPendingEvent.timestamp = getTimestamp();
+        mPendingEvent.timestamp = alignTimestamp(getTimestamp());
+        *data = mPendingEvent;
+        return mEnabled ? 1 : 0;
+    }
+
+    int index;
+    if (mFilter.takeDeferred(getTimestamp(), &index)) {
+        mPendingEvent.light = indexToValue(index);
+        mPendingEvent.timestamp = alignTimestamp(getTimestamp());
         *data = mPendingEvent;
         return mEnabled ? 1 : 0;
     }
@@ -112,29 +153,35 @@ int LightSensor::readEvents(sensors_event_t* data, int count)
         return n;
 
     int numEventReceived = 0;
-    input_event const* event;
-
-    while (count && mInputReader.readEvent(&event)) {
-        int type = event->type;
-        if (type == EV_ABS) {
-            if (event->code == EVENT_TYPE_LIGHT) {
-                if (event->value != -1) {
+    input_event const* events;
+    ssize_t avail;
+
+    while (count && (avail = mInputReader.getSpan(&events))) {
+        ssize_t i;
+        for (i=0 ; count && i<avail ; i++) {
+            input_event const* event = &events[i];
+            int type = event->type;
+            if (type == EV_ABS) {
+                if (event->code == EVENT_TYPE_LIGHT && event->value != -1) {
                     // FIXME: not sure why we're getting -1 sometimes
-                    mPendingEvent.light = indexToValue(event->value);
+                    mIndex = event->value;
                 }
+            } else if (type == EV_SYN) {
+                if (mFilter.filter(mIndex, getTimestamp())) {
+                    mPendingEvent.light = indexToValue(mIndex);
+                    mPendingEvent.timestamp = eventTimestamp(event->time);
+                    if (mEnabled) {
+                        *data++ = mPendingEvent;
+                        count--;
+                        numEventReceived++;
+                    }
+                }
+            } else {
+                LOGE("LightSensor: unknown event (type=%d, code=%d)",
+                        type, event->code);
             }
-        } else if (type == EV_SYN) {
-            mPendingEvent.timestamp = timevalToNano(event->time);
-            if (mEnabled) {
-                *data++ = mPendingEvent;
-                count--;
-                numEventReceived++;
-            }
-        } else {
-            LOGE("LightSensor: unknown event (type=%d, code=%d)",
-                    type, event->code);
         }
-        mInputReader.next();
+        mInputReader.consume(i);
     }
 
     return numEventReceived;
@@ -23,18 +23,21 @@
 #include <sys/types.h>
 
 #include "nusensors.h"
-#include "SensorBase.h"
+#include "SensorDriver.h"
 #include "InputEventReader.h"
+#include "OnChangeFilter.h"
 
 /*****************************************************************************/
 
 struct input_event;
 
-class LightSensor : public SensorBase {
+class LightSensor : public SensorDriver<LightSensor> {
     int mEnabled;
     InputEventCircularReader mInputReader;
     sensors_event_t mPendingEvent;
     bool mHasPendingEvent;
+    OnChangeFilter mFilter;
+    int mIndex;
 
     float indexToValue(size_t index) const;
     int setInitialState();
@@ -44,7 +47,10 @@ public:
     virtual ~LightSensor();
     virtual int readEvents(sensors_event_t* data, int count);
     virtual bool hasPendingEvents() const;
+    virtual int64_t getPendingDeadline() const;
+    virtual int setDelay(int32_t handle, int64_t ns);
     virtual int enable(int32_t handle, int enabled);
+    virtual void getStats(sensor_driver_stats_t* stats) const;
 };
 
 /*****************************************************************************/
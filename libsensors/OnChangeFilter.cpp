@@ -0,0 +1,95 @@
+/*
+ * Copyright (C) 2011 The CyanogenMod Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "OnChangeFilter.h"
+
+/*****************************************************************************/
+
+OnChangeFilter::OnChangeFilter(int jitterSteps, int64_t debounceNs)
+    : mJitterSteps(jitterSteps),
+      mDebounceNs(debounceNs),
+      mMinIntervalNs(0),
+      mReceived(0),
+      mDelivered(0)
+{
+    reset();
+}
+
+void OnChangeFilter::reset()
+{
+    mHasLast = false;
+    mLast = 0;
+    mLastTime = 0;
+    mDeferred = false;
+    mDeferredValue = 0;
+    mDeferredDue = 0;
+}
+
+void OnChangeFilter::report(int value, int64_t now)
+{
+    mHasLast = true;
+    mLast = value;
+    mLastTime = now;
+    mDeferred = false;
+    mDelivered++;
+}
+
+bool OnChangeFilter::filter(int value, int64_t now)
+{
+    mReceived++;
+
+    if (!mHasLast) {
+        report(value, now);
+        return true;
+    }
+
+    if (value == mLast) {
+        // back where we were, whatever was held back was jitter
+        mDeferred = false;
+        return false;
+    }
+
+    int64_t due = mLastTime + mMinIntervalNs;
+    if (abs(value - mLast) <= mJitterSteps) {
+        // keep the deadline of a reading we are already debouncing
+        int64_t settled = (mDeferred && mDeferredValue == value) ?
+                mDeferredDue : now + mDebounceNs;
+        if (settled > due)
+            due = settled;
+    }
+
+    if (due <= now) {
+        report(value, now);
+        return true;
+    }
+
+    mDeferred = true;
+    mDeferredValue = value;
+    mDeferredDue = due;
+    return false;
+}
+
+bool OnChangeFilter::takeDeferred(int64_t now, int* value)
+{
+    if (!mDeferred || now < mDeferredDue)
+        return false;
+    *value = mDeferredValue;
+    report(mDeferredValue, now);
+    return true;
+}
@@ -0,0 +1,74 @@
+/*
+ * Copyright (C) 2011 The CyanogenMod Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_ON_CHANGE_FILTER_H
+#define ANDROID_ON_CHANGE_FILTER_H
+
+#include <stdint.h>
+#include <sys/cdefs.h>
+#include <sys/types.h>
+
+/*****************************************************************************/
+
+/*
+ * Decides which readings of an on-change sensor reach the framework.
+ *
+ * Readings are the raw evdev values (bucket index for the light sensor).
+ * A reading equal to the last reported one is dropped. A reading within
+ * jitterSteps of it has to stay put for debounceNs before it is reported,
+ * and no two reports are closer than the min interval set from setDelay().
+ * Held back readings are reported once their deadline passes, see
+ * takeDeferred().
+ */
+class OnChangeFilter
+{
+    int mJitterSteps;
+    int64_t mDebounceNs;
+    int64_t mMinIntervalNs;
+
+    bool mHasLast;
+    int mLast;
+    int64_t mLastTime;
+
+    bool mDeferred;
+    int mDeferredValue;
+    int64_t mDeferredDue;
+
+    uint32_t mReceived;
+    uint32_t mDelivered;
+
+    void report(int value, int64_t now);
+
+public:
+    OnChangeFilter(int jitterSteps, int64_t debounceNs);
+
+    void reset();
+    void setMinInterval(int64_t ns) { mMinIntervalNs = ns; }
+
+    // returns true if value must be reported now
+    bool filter(int value, int64_t now);
+    // returns true and the held back value if its deadline has passed
+    bool takeDeferred(int64_t now, int* value);
+    // absolute deadline of the held back value, -1 if there is none
+    int64_t getDeadline() const { return mDeferred ? mDeferredDue : -1; }
+
+    uint32_t getReceived() const { return mReceived; }
+    uint32_t getSuppressed() const { return mReceived - mDelivered; }
+};
+
+/*****************************************************************************/
+
+#endif  // ANDROID_ON_CHANGE_FILTER_H
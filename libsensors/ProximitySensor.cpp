@@ -27,14 +27,17 @@
 #include <cutils/log.h>
 
 #include "ProximitySensor.h"
+#include "HalTrace.h"
 
 /*****************************************************************************/
 
 ProximitySensor::ProximitySensor()
-    : SensorBase(CM_DEVICE_NAME, "proximity"),
+    : SensorDriver<ProximitySensor>(CM_DEVICE_NAME, "proximity"),
       mEnabled(0),
       mInputReader(4),
-      mHasPendingEvent(false)
+      mHasPendingEvent(false),
+      mFilter(PROXIMITY_JITTER_STEPS, PROXIMITY_DEBOUNCE_NS),
+      mIndex(0)
 {
     mPendingEvent.version = sizeof(sensors_event_t);
     mPendingEvent.sensor = ID_P;
@@ -51,7 +54,7 @@ ProximitySensor::ProximitySensor()
         }
     }
     if (!mEnabled) {
-        close_device();
+        close_device(true);
     }
 }
 
@@ -62,8 +65,11 @@ int ProximitySensor::setInitialState() {
     struct input_absinfo absinfo;
     if (!ioctl(data_fd, EVIOCGABS(EVENT_TYPE_PROXIMITY), &absinfo)) {
         // make sure to report an event immediately
+        mIndex = absinfo.value;
+        mFilter.reset();
+        mFilter.filter(mIndex, getTimestamp());
         mHasPendingEvent = true;
-        mPendingEvent.distance = indexToValue(absinfo.value);
+        mPendingEvent.distance = indexToValue(mIndex);
     }
     return 0;
 }
@@ -83,6 +89,9 @@ int ProximitySensor::enable(int32_t, int en) {
             mEnabled = newState;
             if (en) {
                 setInitialState();
+            } else {
+                LOGD("ProximitySensor: %u of %u events suppressed",
+                        mFilter.getSuppressed(), mFilter.getReceived());
             }
         }
         if (!mEnabled) {
@@ -96,14 +105,31 @@ bool ProximitySensor::hasPendingEvents() const {
     return mHasPendingEvent;
 }
 
+int ProximitySensor::setDelay(int32_t, int64_t ns) {
+    if (ns < 0)
+        return -EINVAL;
+    // near/far changes are rare and each one matters (the screen goes off
+    // during a call), so unlike light they are never rate limited: mFilter
+    // only drops repeats of the last reported value
+    return 0;
+}
+
+void ProximitySensor::getStats(sensor_driver_stats_t* stats) const {
+    stats->evdevEvents = mInputReader.getEventsRead();
+    stats->partialReads = mInputReader.getPartialReads();
+    stats->ringFull = mInputReader.getRingFull();
+    stats->dropped = mFilter.getSuppressed();
+}
+
 int ProximitySensor::readEvents(sensors_event_t* data, int count)
 {
+    SENSORS_TRACE_CALL("ProximitySensor::readEvents");
     if (count < 1)
         return -EINVAL;
 
     if (mHasPendingEvent) {
         mHasPendingEvent = false;
-        mPendingEvent.timestamp = getTimestamp();
+        mPendingEvent.timestamp = alignTimestamp(getTimestamp());
         *data = mPendingEvent;
         return mEnabled ? 1 : 0;
     }
@@ -113,26 +139,34 @@ int ProximitySensor::readEvents(sensors_event_t* data, int count)
         return n;
 
     int numEventReceived = 0;
-    input_event const* event;
-
-    while (count && mInputReader.readEvent(&event)) {
-        int type = event->type;
-        if (type == EV_ABS) {
-            if (event->code == EVENT_TYPE_PROXIMITY) {
-                mPendingEvent.distance = indexToValue(event->value);
-            }
-        } else if (type == EV_SYN) {
-            mPendingEvent.timestamp = timevalToNano(event->time);
-            if (mEnabled) {
-                *data++ = mPendingEvent;
-                count--;
-                numEventReceived++;
+    input_event const* events;
+    ssize_t avail;
+
+    while (count && (avail = mInputReader.getSpan(&events))) {
+        ssize_t i;
+        for (i=0 ; count && i<avail ; i++) {
+            input_event const* event = &events[i];
+            int type = event->type;
+            if (type == EV_ABS) {
+                if (event->code == EVENT_TYPE_PROXIMITY) {
+                    mIndex = event->value;
+                }
+            } else if (type == EV_SYN) {
+                if (mFilter.filter(mIndex, getTimestamp())) {
+                    mPendingEvent.distance = indexToValue(mIndex);
+                    mPendingEvent.timestamp = eventTimestamp(event->time);
+                    if (mEnabled) {
+                        *data++ = mPendingEvent;
+                        count--;
+                        numEventReceived++;
+                    }
+                }
+            } else {
+                LOGE("ProximitySensor: unknown event (type=%d, code=%d)",
+                        type, event->code);
             }
-        } else {
-            LOGE("ProximitySensor: unknown event (type=%d, code=%d)",
-                    type, event->code);
         }
-        mInputReader.next();
+        mInputReader.consume(i);
     }
 
     return numEventReceived;
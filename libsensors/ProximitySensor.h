@@ -23,18 +23,21 @@
 #include <sys/types.h>
 
 #include "nusensors.h"
-#include "SensorBase.h"
+#include "SensorDriver.h"
 #include "InputEventReader.h"
+#include "OnChangeFilter.h"
 
 /*****************************************************************************/
 
 struct input_event;
 
-class ProximitySensor : public SensorBase {
+class ProximitySensor : public SensorDriver<ProximitySensor> {
     int mEnabled;
     InputEventCircularReader mInputReader;
     sensors_event_t mPendingEvent;
     bool mHasPendingEvent;
+    OnChangeFilter mFilter;
+    int mIndex;
 
     int setInitialState();
     float indexToValue(size_t index) const;
@@ -44,7 +47,9 @@ public:
     virtual ~ProximitySensor();
     virtual int readEvents(sensors_event_t* data, int count);
     virtual bool hasPendingEvents() const;
+    virtual int setDelay(int32_t handle, int64_t ns);
     virtual int enable(int32_t handle, int enabled);
+    virtual void getStats(sensor_driver_stats_t* stats) const;
 };
 
 /*****************************************************************************/
@@ -0,0 +1,87 @@
+/*
+ * Copyright (C) 2011 The CyanogenMod Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdint.h>
+
+#include "SampleFifo.h"
+
+/*****************************************************************************/
+
+SampleFifo::SampleFifo(size_t capacity)
+    : mRecords(new sensor_sample_t[capacity]),
+      mCapacity(capacity),
+      mHead(0),
+      mCount(0),
+      mHeadUs(0),
+      mTailUs(0),
+      mDropped(0),
+      mOutOfOrder(0)
+{
+}
+
+SampleFifo::~SampleFifo()
+{
+    delete [] mRecords;
+}
+
+bool SampleFifo::push(int slot, int64_t timestamp, int16_t const* raw, int status)
+{
+    const int64_t us = timestamp / 1000;
+    if (us < mHeadUs) {
+        // even once drained, the reader saw the newer one already
+        mOutOfOrder++;
+        return false;
+    }
+    if (!mCount) {
+        // restart the delta chain, whatever the gap since the last record
+        mHeadUs = mTailUs = us;
+    } else if (mCount == mCapacity) {
+        sensor_sample_t dummy;
+        int64_t t;
+        pop(&dummy, &t);
+        mDropped++;
+    }
+
+    int64_t delta = us - mHeadUs;
+    if (delta > 0xFFFFFFFFLL)
+        delta = 0xFFFFFFFFLL;   // over an hour, can't happen with a drained fifo
+    mHeadUs += delta;
+
+    sensor_sample_t& r(mRecords[mHead]);
+    r.deltaUs = uint32_t(delta);
+    r.raw[0] = raw[0];
+    r.raw[1] = raw[1];
+    r.raw[2] = raw[2];
+    r.slot = uint8_t(slot);
+    r.status = uint8_t(status);
+    mHead = mHead+1 < mCapacity ? mHead+1 : 0;
+    mCount++;
+    return true;
+}
+
+bool SampleFifo::pop(sensor_sample_t* sample, int64_t* timestamp)
+{
+    if (!mCount)
+        return false;
+    size_t tail = mHead + mCapacity - mCount;
+    if (tail >= mCapacity)
+        tail -= mCapacity;
+    *sample = mRecords[tail];
+    mTailUs += sample->deltaUs;
+    *timestamp = mTailUs * 1000;
+    mCount--;
+    return true;
+}
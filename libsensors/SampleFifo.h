@@ -0,0 +1,77 @@
+/*
+ * Copyright (C) 2011 The CyanogenMod Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_SAMPLE_FIFO_H
+#define ANDROID_SAMPLE_FIFO_H
+
+#include <stdint.h>
+#include <sys/cdefs.h>
+#include <sys/types.h>
+
+/*****************************************************************************/
+
+/*
+ * A reading as it is buffered in the HAL: the raw evdev values and a
+ * timestamp stored as the microseconds elapsed since the previous record,
+ * 12 bytes instead of a sensors_event_t. Drivers expand records into
+ * sensors_event_t only when handing them to pollEvents().
+ */
+struct sensor_sample_t {
+    uint32_t deltaUs;
+    int16_t raw[3];
+    uint8_t slot;       // sensor index inside its driver
+    uint8_t status;
+};
+
+/*
+ * Fixed size ring of sensor_sample_t. When full, the oldest record is
+ * dropped to make room. Timestamps keep microsecond resolution, which is
+ * what evdev reports anyway. Records must be pushed in timestamp order,
+ * one older than the last record pushed is refused.
+ */
+class SampleFifo
+{
+    sensor_sample_t* const mRecords;
+    const size_t mCapacity;
+    size_t mHead;
+    size_t mCount;
+    int64_t mHeadUs;    // time of the newest record, kept when emptied
+    int64_t mTailUs;    // time of the record before the oldest one
+    uint32_t mDropped;
+    uint32_t mOutOfOrder;
+
+public:
+    SampleFifo(size_t capacity);
+    ~SampleFifo();
+
+    // returns false, and stores nothing, if timestamp is older than the
+    // previous record's
+    bool push(int slot, int64_t timestamp, int16_t const* raw, int status);
+    // returns false if empty, the timestamp is in nanoseconds
+    bool pop(sensor_sample_t* sample, int64_t* timestamp);
+    void clear() { mCount = 0; }
+
+    size_t size() const { return mCount; }
+    bool empty() const { return !mCount; }
+    uint32_t getDropped() const { return mDropped; }
+    uint32_t getOutOfOrder() const { return mOutOfOrder; }
+    // the time of the last record pushed, in nanoseconds
+    int64_t getNewest() const { return mHeadUs * 1000; }
+};
+
+/*****************************************************************************/
+
+#endif  // ANDROID_SAMPLE_FIFO_H
@@ -15,6 +15,8 @@
  */
 
 #include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
 #include <errno.h>
 #include <math.h>
 #include <poll.h>
@@ -26,6 +28,7 @@
 
 #include <linux/input.h>
 
+#include "nusensors.h"
 #include "SensorBase.h"
 
 /*****************************************************************************/
@@ -33,10 +36,25 @@
 SensorBase::SensorBase(
         const char* dev_name,
         const char* data_name)
-    : dev_name(dev_name), data_name(data_name),
+    : mCloseDeadline(-1),
+      mMonotonicEvents(false),
+      mClockOffset(0),
+      mClockOffsetStamp(-1),
+      mLastEventTime(0),
+      dev_name(dev_name), data_name(data_name),
       dev_fd(-1), data_fd(-1)
 {
+    pthread_mutex_init(&mDeviceLock, NULL);
     data_fd = openInput(data_name);
+    if (data_fd >= 0) {
+        // drivers with buffered or synthesized events get read without
+        // the fd being readable
+        fcntl(data_fd, F_SETFL, O_NONBLOCK);
+        int clk = CLOCK_MONOTONIC;
+        mMonotonicEvents = !ioctl(data_fd, EVIOCSCLOCKID, &clk);
+        LOGD_IF(!mMonotonicEvents, "%s: no EVIOCSCLOCKID, estimating clock offset",
+                data_name);
+    }
 }
 
 SensorBase::~SensorBase() {
@@ -46,22 +64,45 @@ SensorBase::~SensorBase() {
     if (dev_fd >= 0) {
         close(dev_fd);
     }
+    pthread_mutex_destroy(&mDeviceLock);
 }
 
 int SensorBase::open_device() {
+    pthread_mutex_lock(&mDeviceLock);
+    mCloseDeadline = -1;
     if (dev_fd<0 && dev_name) {
-        dev_fd = open(dev_name, O_RDONLY);
+        char path[PATH_MAX];
+        dev_fd = open(devicePath(path, sizeof(path), dev_name), O_RDONLY);
         LOGE_IF(dev_fd<0, "Couldn't open %s (%s)", dev_name, strerror(errno));
     }
+    pthread_mutex_unlock(&mDeviceLock);
     return 0;
 }
 
-int SensorBase::close_device() {
+int SensorBase::close_device(bool immediate) {
+    pthread_mutex_lock(&mDeviceLock);
     if (dev_fd >= 0) {
+        if (!immediate && CONTROL_CLOSE_GRACE_NS > 0) {
+            mCloseDeadline = getTimestamp() + CONTROL_CLOSE_GRACE_NS;
+        } else {
+            close(dev_fd);
+            dev_fd = -1;
+        }
+    }
+    pthread_mutex_unlock(&mDeviceLock);
+    return 0;
+}
+
+int64_t SensorBase::expireDevice(int64_t now) {
+    pthread_mutex_lock(&mDeviceLock);
+    if (mCloseDeadline >= 0 && now >= mCloseDeadline) {
         close(dev_fd);
         dev_fd = -1;
+        mCloseDeadline = -1;
     }
-    return 0;
+    int64_t deadline = mCloseDeadline;
+    pthread_mutex_unlock(&mDeviceLock);
+    return deadline;
 }
 
 int SensorBase::getFd() const {
@@ -76,6 +117,26 @@ bool SensorBase::hasPendingEvents() const {
     return false;
 }
 
+int64_t SensorBase::getPendingDeadline() const {
+    return -1;
+}
+
+void SensorBase::getStats(sensor_driver_stats_t* stats) const {
+    memset(stats, 0, sizeof(*stats));
+}
+
+const char* SensorBase::devicePath(char* buf, size_t size, const char* path) {
+#ifdef SENSORS_HOST_TEST
+    const char* root = getenv(SENSORS_ROOT_ENV);
+    if (!root || !root[0])
+        return path;
+    snprintf(buf, size, "%s%s", root, path);
+    return buf;
+#else
+    return path;
+#endif
+}
+
 int64_t SensorBase::getTimestamp() {
     struct timespec t;
     t.tv_sec = t.tv_nsec = 0;
@@ -83,9 +144,53 @@ int64_t SensorBase::getTimestamp() {
     return int64_t(t.tv_sec)*1000000000LL + t.tv_nsec;
 }
 
+// REALTIME - MONOTONIC, taken from the tightest of a few bracketed reads
+int64_t SensorBase::estimateClockOffset() {
+    int64_t offset = 0;
+    int64_t bestWidth = -1;
+    for (int i=0 ; i<3 ; i++) {
+        struct timespec m0, r, m1;
+        clock_gettime(CLOCK_MONOTONIC, &m0);
+        clock_gettime(CLOCK_REALTIME, &r);
+        clock_gettime(CLOCK_MONOTONIC, &m1);
+        int64_t before = int64_t(m0.tv_sec)*1000000000LL + m0.tv_nsec;
+        int64_t after = int64_t(m1.tv_sec)*1000000000LL + m1.tv_nsec;
+        if (bestWidth < 0 || after - before < bestWidth) {
+            bestWidth = after - before;
+            offset = int64_t(r.tv_sec)*1000000000LL + r.tv_nsec
+                    - (before + bestWidth/2);
+        }
+    }
+    return offset;
+}
+
+int64_t SensorBase::eventTimestamp(timeval const& t) {
+    const int64_t now = getTimestamp();
+    int64_t time = timevalToNano(t);
+    if (!mMonotonicEvents) {
+        // re-estimated regularly so that wall clock changes are followed
+        if (mClockOffsetStamp < 0 || now - mClockOffsetStamp >= CLOCK_OFFSET_REFRESH_NS) {
+            mClockOffset = estimateClockOffset();
+            mClockOffsetStamp = now;
+        }
+        time -= mClockOffset;
+    }
+    if (time > now)
+        time = now;
+    return alignTimestamp(time);
+}
+
+int64_t SensorBase::alignTimestamp(int64_t time) {
+    if (time < mLastEventTime)
+        time = mLastEventTime;
+    mLastEventTime = time;
+    return time;
+}
+
 int SensorBase::openInput(const char* inputName) {
     int fd = -1;
-    const char *dirname = "/dev/input";
+    char dirbuf[PATH_MAX];
+    const char *dirname = devicePath(dirbuf, sizeof(dirbuf), "/dev/input");
     char devname[PATH_MAX];
     char *filename;
     DIR *dir;
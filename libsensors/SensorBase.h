@@ -19,6 +19,7 @@
 
 #include <stdint.h>
 #include <errno.h>
+#include <pthread.h>
 #include <sys/cdefs.h>
 #include <sys/types.h>
 
@@ -27,7 +28,26 @@
 
 struct sensors_event_t;
 
+struct sensor_driver_stats_t {
+    uint32_t evdevEvents;   // input_events read from the evdev node
+    uint32_t partialReads;  // reads that returned a partial input_event
+    uint32_t ringFull;      // fill() calls that found the ring full
+    uint32_t dropped;       // readings not delivered (disabled or filtered)
+};
+
 class SensorBase {
+    pthread_mutex_t mDeviceLock;
+    int64_t mCloseDeadline;     // -1 unless a close is pending
+
+    // evdev timestamps are CLOCK_REALTIME on kernels without EVIOCSCLOCKID,
+    // mClockOffset is then the estimated REALTIME - MONOTONIC difference
+    bool mMonotonicEvents;
+    int64_t mClockOffset;
+    int64_t mClockOffsetStamp;
+    int64_t mLastEventTime;
+
+    static int64_t estimateClockOffset();
+
 protected:
     const char* dev_name;
     const char* data_name;
@@ -35,6 +55,7 @@ protected:
     int         data_fd;
 
     static int openInput(const char* inputName);
+    static const char* devicePath(char* buf, size_t size, const char* path);
     static int64_t getTimestamp();
 
 
@@ -42,8 +63,17 @@ protected:
         return t.tv_sec*1000000000LL + t.tv_usec*1000;
     }
 
+    // converts an evdev timestamp to CLOCK_MONOTONIC, the timeline shared
+    // with getTimestamp() and the other drivers, never going backwards or
+    // into the future
+    int64_t eventTimestamp(timeval const& t);
+    // keeps a CLOCK_MONOTONIC timestamp from going backwards
+    int64_t alignTimestamp(int64_t time);
+
+    // close_device() keeps dev_fd open for the grace period so that an
+    // enable shortly after a disable is a single ioctl
     int open_device();
-    int close_device();
+    int close_device(bool immediate = false);
 
 public:
             SensorBase(
@@ -54,9 +84,17 @@ public:
 
     virtual int readEvents(sensors_event_t* data, int count) = 0;
     virtual bool hasPendingEvents() const;
+    // CLOCK_MONOTONIC time at which hasPendingEvents() will become true, -1 if none
+    virtual int64_t getPendingDeadline() const;
     virtual int getFd() const;
     virtual int setDelay(int32_t handle, int64_t ns);
     virtual int enable(int32_t handle, int enabled) = 0;
+    // may be called from another thread, values are only approximate
+    virtual void getStats(sensor_driver_stats_t* stats) const;
+
+    // closes the control device once its grace period is over and returns
+    // the CLOCK_MONOTONIC time at which it has to be called again, or -1
+    int64_t expireDevice(int64_t now);
 };
 
 /*****************************************************************************/
@@ -0,0 +1,47 @@
+/*
+ * Copyright (C) 2011 The CyanogenMod Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_SENSOR_DRIVER_H
+#define ANDROID_SENSOR_DRIVER_H
+
+#include "SensorBase.h"
+
+/*****************************************************************************/
+
+/*
+ * Base of the concrete drivers. The SensorBase interface stays virtual for
+ * anyone holding a SensorBase*, while the poll loop, which knows the type of
+ * each of its drivers, calls them through pollHasPendingEvents() and
+ * pollReadEvents() without going through the vtable.
+ */
+template <typename T>
+class SensorDriver : public SensorBase {
+protected:
+    SensorDriver(const char* dev_name, const char* data_name)
+        : SensorBase(dev_name, data_name) { }
+
+public:
+    bool pollHasPendingEvents() const {
+        return static_cast<T const*>(this)->T::hasPendingEvents();
+    }
+    int pollReadEvents(sensors_event_t* data, int count) {
+        return static_cast<T*>(this)->T::readEvents(data, count);
+    }
+};
+
+/*****************************************************************************/
+
+#endif  // ANDROID_SENSOR_DRIVER_H
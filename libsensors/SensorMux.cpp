@@ -0,0 +1,308 @@
+/*
+ * Copyright (C) 2011 The CyanogenMod Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <fcntl.h>
+#include <errno.h>
+#include <poll.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <sys/socket.h>
+
+#include <cutils/log.h>
+#include <cutils/sockets.h>
+
+#include "SensorMux.h"
+
+/*****************************************************************************/
+
+SensorMux::SensorMux(demand_callback_t onDemand, void* cookie)
+    : mOnDemand(onDemand),
+      mCookie(cookie),
+      mNumClients(0),
+      mSubscriptions(0),
+      mWriteSeq(0),
+      mServerFd(-1),
+      mQuit(false)
+{
+    pthread_mutex_init(&mLock, NULL);
+    mWakeFds[0] = mWakeFds[1] = -1;
+
+    mServerFd = socket_local_server(MUX_SOCKET_NAME,
+            ANDROID_SOCKET_NAMESPACE_ABSTRACT, SOCK_SEQPACKET);
+    LOGE_IF(mServerFd<0, "couldn't create %s socket (%s)",
+            MUX_SOCKET_NAME, strerror(errno));
+    if (mServerFd < 0)
+        return;
+    fcntl(mServerFd, F_SETFD, FD_CLOEXEC);
+
+    if (pipe(mWakeFds) < 0) {
+        LOGE("error creating mux wake pipe (%s)", strerror(errno));
+        close(mServerFd);
+        mServerFd = -1;
+        return;
+    }
+    fcntl(mWakeFds[0], F_SETFL, O_NONBLOCK);
+    fcntl(mWakeFds[1], F_SETFL, O_NONBLOCK);
+
+    if (pthread_create(&mThread, NULL, threadLoop, this)) {
+        close(mServerFd);
+        mServerFd = -1;
+    }
+}
+
+SensorMux::~SensorMux()
+{
+    if (mServerFd >= 0) {
+        mQuit = true;
+        write(mWakeFds[1], "Q", 1);
+        pthread_join(mThread, NULL);
+        for (int i=mNumClients-1 ; i>=0 ; i--) {
+            close(mClients[i].fd);
+        }
+        close(mServerFd);
+    }
+    if (mWakeFds[0] >= 0) {
+        close(mWakeFds[0]);
+        close(mWakeFds[1]);
+    }
+    pthread_mutex_destroy(&mLock);
+}
+
+bool SensorMux::getDemand(int handle, int64_t* periodNs)
+{
+    bool wanted = false;
+    int64_t period = 0;
+    pthread_mutex_lock(&mLock);
+    for (int i=0 ; i<mNumClients ; i++) {
+        int64_t p = mClients[i].period[handle];
+        if (p >= 0 && (!wanted || p < period)) {
+            period = p;
+            wanted = true;
+        }
+    }
+    pthread_mutex_unlock(&mLock);
+    *periodNs = period;
+    return wanted;
+}
+
+void SensorMux::publish(sensors_event_t const* data, int count)
+{
+    pthread_mutex_lock(&mLock);
+    if (!mSubscriptions) {
+        pthread_mutex_unlock(&mLock);
+        return;
+    }
+    for (int i=0 ; i<count ; i++) {
+        mRing[mWriteSeq++ & (MUX_RING_SIZE-1)] = data[i];
+    }
+    pthread_mutex_unlock(&mLock);
+    // coalesces with any wakeup still in the pipe
+    write(mWakeFds[1], "W", 1);
+}
+
+void SensorMux::dump(int fd)
+{
+    char buf[128];
+    pthread_mutex_lock(&mLock);
+    for (int i=0 ; i<mNumClients ; i++) {
+        const client_t& c(mClients[i]);
+        int len = snprintf(buf, sizeof(buf),
+                "mux client %d sent %u dropped %u overrun %u\n",
+                i, c.sent, c.dropped, c.overrun);
+        write(fd, buf, len);
+    }
+    pthread_mutex_unlock(&mLock);
+}
+
+void* SensorMux::threadLoop(void* arg)
+{
+    static_cast<SensorMux*>(arg)->run();
+    return NULL;
+}
+
+void SensorMux::run()
+{
+    struct pollfd fds[2 + MUX_MAX_CLIENTS];
+    while (!mQuit) {
+        // only the mux thread changes the client list, no lock needed to read it
+        int nfds = 0;
+        fds[nfds].fd = mServerFd;
+        fds[nfds++].events = POLLIN;
+        fds[nfds].fd = mWakeFds[0];
+        fds[nfds++].events = POLLIN;
+        for (int i=0 ; i<mNumClients ; i++) {
+            fds[nfds].fd = mClients[i].fd;
+            fds[nfds++].events = POLLIN;
+        }
+        for (int i=0 ; i<nfds ; i++) {
+            fds[i].revents = 0;
+        }
+
+        if (poll(fds, nfds, -1) < 0) {
+            if (errno == EINTR)
+                continue;
+            LOGE("mux poll() failed (%s)", strerror(errno));
+            break;
+        }
+
+        if (fds[1].revents & POLLIN) {
+            char msg[16];
+            while (read(mWakeFds[0], msg, sizeof(msg)) > 0)
+                ;
+        }
+        // backwards, removeClient() moves the last client into the hole
+        for (int i=nfds-1 ; i>=2 ; i--) {
+            if (fds[i].revents & POLLIN) {
+                command(i-2);
+            } else if (fds[i].revents & (POLLHUP|POLLERR)) {
+                removeClient(i-2);
+            }
+        }
+        if (fds[0].revents & POLLIN) {
+            int fd = accept(mServerFd, NULL, NULL);
+            if (fd >= 0 && !sensors_peer_allowed(fd)) {
+                close(fd);
+            } else if (fd >= 0) {
+                addClient(fd);
+            }
+        }
+
+        for (int i=0 ; i<mNumClients ; i++) {
+            flush(mClients[i]);
+        }
+    }
+}
+
+void SensorMux::addClient(int fd)
+{
+    if (mNumClients == MUX_MAX_CLIENTS) {
+        LOGW("too many mux clients");
+        close(fd);
+        return;
+    }
+    fcntl(fd, F_SETFD, FD_CLOEXEC);
+
+    pthread_mutex_lock(&mLock);
+    client_t& c(mClients[mNumClients]);
+    memset(&c, 0, sizeof(c));
+    c.fd = fd;
+    c.cursor = mWriteSeq;
+    for (int h=0 ; h<NUM_SENSOR_HANDLES ; h++) {
+        c.period[h] = -1;
+    }
+    mNumClients++;
+    pthread_mutex_unlock(&mLock);
+}
+
+void SensorMux::removeClient(int i)
+{
+    bool changed[NUM_SENSOR_HANDLES];
+
+    pthread_mutex_lock(&mLock);
+    client_t& c(mClients[i]);
+    close(c.fd);
+    for (int h=0 ; h<NUM_SENSOR_HANDLES ; h++) {
+        changed[h] = c.period[h] >= 0;
+        if (changed[h])
+            mSubscriptions--;
+    }
+    mClients[i] = mClients[--mNumClients];
+    pthread_mutex_unlock(&mLock);
+
+    for (int h=0 ; h<NUM_SENSOR_HANDLES ; h++) {
+        if (changed[h])
+            mOnDemand(mCookie, h);
+    }
+}
+
+void SensorMux::command(int i)
+{
+    char buf[64];
+    ssize_t n = recv(mClients[i].fd, buf, sizeof(buf)-1, MSG_DONTWAIT);
+    if (n <= 0) {
+        if (n == 0 || errno != EAGAIN)
+            removeClient(i);
+        return;
+    }
+    buf[n] = 0;
+
+    int handle;
+    long long period;
+    if (sscanf(buf, "subscribe %d %lld", &handle, &period) == 2) {
+        if (period < 0)
+            period = 0;
+    } else if (sscanf(buf, "unsubscribe %d", &handle) == 1) {
+        period = -1;
+    } else {
+        LOGW("unknown mux command '%s'", buf);
+        return;
+    }
+    if (uint32_t(handle) >= uint32_t(NUM_SENSOR_HANDLES))
+        return;
+
+    pthread_mutex_lock(&mLock);
+    client_t& c(mClients[i]);
+    mSubscriptions += (period >= 0) - (c.period[handle] >= 0);
+    c.period[handle] = period;
+    c.due[handle] = 0;
+    pthread_mutex_unlock(&mLock);
+
+    mOnDemand(mCookie, handle);
+}
+
+// sends what the client hasn't seen yet, keeping one event per period of
+// each of its handles
+void SensorMux::flush(client_t& c)
+{
+    sensors_event_t batch[MUX_BATCH];
+
+    for (;;) {
+        int nb = 0;
+        pthread_mutex_lock(&mLock);
+        const uint32_t end = mWriteSeq;
+        if (end - c.cursor > MUX_RING_SIZE) {
+            c.overrun += end - c.cursor - MUX_RING_SIZE;
+            c.cursor = end - MUX_RING_SIZE;
+        }
+        while (c.cursor != end && nb < MUX_BATCH) {
+            sensors_event_t const& e(mRing[c.cursor++ & (MUX_RING_SIZE-1)]);
+            const int h = e.sensor;
+            if (uint32_t(h) >= uint32_t(NUM_SENSOR_HANDLES) || c.period[h] < 0)
+                continue;
+            // an eighth of a period early is fine, the hardware rate jitters
+            if (e.timestamp < c.due[h] - c.period[h]/8)
+                continue;
+            c.due[h] = (e.timestamp - c.due[h] < c.period[h]) ?
+                    c.due[h] + c.period[h] : e.timestamp + c.period[h];
+            batch[nb++] = e;
+        }
+        const bool done = (c.cursor == end);
+        pthread_mutex_unlock(&mLock);
+
+        if (nb) {
+            if (send(c.fd, batch, nb * sizeof(sensors_event_t),
+                    MSG_DONTWAIT | MSG_NOSIGNAL) < 0) {
+                c.dropped += nb;
+            } else {
+                c.sent += nb;
+            }
+        }
+        if (done)
+            break;
+    }
+}
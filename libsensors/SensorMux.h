@@ -0,0 +1,102 @@
+/*
+ * Copyright (C) 2011 The CyanogenMod Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_SENSOR_MUX_H
+#define ANDROID_SENSOR_MUX_H
+
+#include <stdint.h>
+#include <pthread.h>
+#include <sys/cdefs.h>
+#include <sys/types.h>
+
+#include "nusensors.h"
+
+/*****************************************************************************/
+
+// abstract SOCK_SEQPACKET socket, see SensorMux
+#define MUX_SOCKET_NAME     "sensors-mux"
+#define MUX_MAX_CLIENTS     8
+#define MUX_RING_SIZE       256     // events, a power of two
+#define MUX_BATCH           16      // events per packet
+
+/*
+ * Fans the event stream out to native clients, so that they don't have to
+ * open the input devices and fight the HAL over the sensor rates.
+ *
+ * A client sends one command per packet:
+ *     "subscribe <handle> <period_ns>"
+ *     "unsubscribe <handle>"
+ * and receives packets of up to MUX_BATCH sensors_event_t, decimated to the
+ * period it asked for. The poll thread publishes every event it reads into
+ * a single ring, clients that fall more than MUX_RING_SIZE events behind
+ * skip ahead and the gap is counted as overrun.
+ *
+ * The mux doesn't touch the drivers: whenever the subscriptions for a
+ * handle change, onDemand() is called from the mux thread and the owner
+ * combines getDemand() with its own state.
+ */
+class SensorMux
+{
+public:
+    typedef void (*demand_callback_t)(void* cookie, int handle);
+
+    SensorMux(demand_callback_t onDemand, void* cookie);
+    ~SensorMux();
+
+    // true if a client subscribed to handle, period is the shortest one
+    bool getDemand(int handle, int64_t* periodNs);
+    void publish(sensors_event_t const* data, int count);
+    void dump(int fd);
+
+private:
+    struct client_t {
+        int fd;
+        uint32_t cursor;
+        int64_t period[NUM_SENSOR_HANDLES];     // -1 if not subscribed
+        int64_t due[NUM_SENSOR_HANDLES];
+        uint32_t sent;
+        uint32_t dropped;                       // socket buffer full
+        uint32_t overrun;                       // too far behind the ring
+    };
+
+    static void* threadLoop(void* arg);
+    void run();
+    void addClient(int fd);
+    void removeClient(int i);
+    void command(int i);
+    void flush(client_t& c);
+
+    demand_callback_t mOnDemand;
+    void* mCookie;
+
+    // guards the subscriptions and the ring, the mux thread is the only
+    // one that changes the client list
+    pthread_mutex_t mLock;
+    client_t mClients[MUX_MAX_CLIENTS];
+    int mNumClients;
+    int mSubscriptions;
+    sensors_event_t mRing[MUX_RING_SIZE];
+    uint32_t mWriteSeq;
+
+    int mServerFd;
+    int mWakeFds[2];
+    volatile bool mQuit;
+    pthread_t mThread;
+};
+
+/*****************************************************************************/
+
+#endif  // ANDROID_SENSOR_MUX_H
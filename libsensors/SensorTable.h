@@ -0,0 +1,57 @@
+/*
+ * Copyright (C) 2011 The CyanogenMod Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_SENSOR_TABLE_H
+#define ANDROID_SENSOR_TABLE_H
+
+#include <stdint.h>
+#include <errno.h>
+
+#include "nusensors.h"
+
+/*****************************************************************************/
+
+// handle dispatch generated from SENSOR_TABLE, see nusensors.h
+
+struct sensor_route_t {
+    int8_t driver;
+    int8_t slot;
+};
+
+#define SENSOR_ROUTE(id, name, vendor, type, range, res, power, driver, slot) \
+        { driver, slot },
+static const sensor_route_t sSensorRoutes[NUM_SENSOR_HANDLES] = {
+    SENSOR_TABLE(SENSOR_ROUTE)
+};
+#undef SENSOR_ROUTE
+
+static inline int handleToDriver(int handle) {
+    if (uint32_t(handle) >= uint32_t(NUM_SENSOR_HANDLES))
+        return -EINVAL;
+    return sSensorRoutes[handle].driver;
+}
+
+// index of the sensor inside its driver, or -EINVAL if the handle doesn't
+// belong to that driver
+static inline int handleToSlot(int handle, int driver) {
+    if (handleToDriver(handle) != driver)
+        return -EINVAL;
+    return sSensorRoutes[handle].slot;
+}
+
+/*****************************************************************************/
+
+#endif  // ANDROID_SENSOR_TABLE_H
@@ -0,0 +1,89 @@
+/*
+ * Copyright (C) 2011 The CyanogenMod Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdint.h>
+#include <math.h>
+
+#include "StepDetector.h"
+
+/*****************************************************************************/
+
+// the smoothed acceleration has to rise above HIGH and fall back below LOW
+#define STEP_THRESHOLD_HIGH     1.2f            // m/s^2
+#define STEP_THRESHOLD_LOW      0.2f            // m/s^2
+#define STEP_MIN_INTERVAL_NS    250000000LL     // 4 steps/s, running
+#define STEP_MAX_INTERVAL_NS    2000000000LL    // longer pauses restart
+#define GRAVITY_TAU_S           1.0f
+#define SMOOTHING_TAU_S         0.05f
+
+StepDetector::StepDetector()
+    : mSteps(0)
+{
+    reset();
+}
+
+void StepDetector::reset()
+{
+    mLastTime = -1;
+    mGravity = 0;
+    mSmoothed = 0;
+    mRising = false;
+    mLastStep = -1;
+    mTentative = false;
+}
+
+int StepDetector::process(float x, float y, float z, int64_t time)
+{
+    const float magnitude = sqrtf(x*x + y*y + z*z);
+    if (mLastTime < 0 || time - mLastTime > STEP_MAX_INTERVAL_NS) {
+        // first sample, or the accelerometer was off for a while
+        mLastTime = time;
+        mGravity = magnitude;
+        mSmoothed = 0;
+        mRising = false;
+        mTentative = false;
+        return 0;
+    }
+
+    const float dt = (time - mLastTime) * 1e-9f;
+    mLastTime = time;
+    mGravity += (magnitude - mGravity) * dt / (GRAVITY_TAU_S + dt);
+    mSmoothed += (magnitude - mGravity - mSmoothed) * dt / (SMOOTHING_TAU_S + dt);
+
+    if (!mRising) {
+        mRising = mSmoothed > STEP_THRESHOLD_HIGH;
+        return 0;
+    }
+    if (mSmoothed > STEP_THRESHOLD_LOW)
+        return 0;
+    mRising = false;
+
+    if (mLastStep >= 0 && time - mLastStep < STEP_MIN_INTERVAL_NS)
+        return 0;
+
+    int steps;
+    if (mLastStep < 0 || time - mLastStep > STEP_MAX_INTERVAL_NS) {
+        // hold it until we know this is walking
+        mTentative = true;
+        steps = 0;
+    } else {
+        steps = mTentative ? 2 : 1;
+        mTentative = false;
+    }
+    mLastStep = time;
+    mSteps += steps;
+    return steps;
+}
@@ -0,0 +1,56 @@
+/*
+ * Copyright (C) 2011 The CyanogenMod Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_STEP_DETECTOR_H
+#define ANDROID_STEP_DETECTOR_H
+
+#include <stdint.h>
+#include <sys/cdefs.h>
+#include <sys/types.h>
+
+/*****************************************************************************/
+
+/*
+ * Finds steps in accelerometer samples (m/s^2).
+ *
+ * The magnitude of the acceleration minus a slow estimate of gravity is
+ * smoothed and run through a Schmitt trigger, every fall after a rise is a
+ * step unless it comes too soon after the previous one. After a pause,
+ * a single step is only reported together with the one following it, so
+ * that picking up or putting down the phone isn't counted.
+ */
+class StepDetector
+{
+    int64_t mLastTime;
+    float mGravity;
+    float mSmoothed;
+    bool mRising;
+    int64_t mLastStep;
+    bool mTentative;
+    uint32_t mSteps;
+
+public:
+    StepDetector();
+
+    void reset();
+    // returns the number of steps completed by this sample, 0 to 2
+    int process(float x, float y, float z, int64_t time);
+    uint32_t getSteps() const { return mSteps; }
+};
+
+/*****************************************************************************/
+
+#endif  // ANDROID_STEP_DETECTOR_H
@@ -25,16 +25,49 @@
 
 #include <linux/input.h>
 
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+
 #include <cutils/atomic.h>
 #include <cutils/log.h>
+#include <cutils/sockets.h>
+#include <private/android_filesystem_config.h>
 
 #include "nusensors.h"
+#include "HalTrace.h"
+#include "SensorTable.h"
+#include "SensorMux.h"
 #include "LightSensor.h"
 #include "ProximitySensor.h"
 #include "AkmSensor.h"
 
 /*****************************************************************************/
 
+// abstract local socket serving a text dump of the statistics below
+#define STATS_SOCKET_NAME   "sensors-stats"
+
+// delivery latency histograms use power of two millisecond buckets:
+// [0,1) [1,2) [2,4) ... with the last one catching everything above
+#define LATENCY_BUCKETS     12
+
+struct sensor_handle_stats_t {
+    uint32_t delivered;
+    int64_t lastTimestamp;
+    int64_t avgIntervalNs;      // moving average, 0 until two events
+    // events whose latency is negative or over 10 s, left out of the
+    // histogram; eventTimestamp() keeps evdev timestamps on our clock, so
+    // anything here means a driver stamped an event wrong
+    uint32_t unaligned;
+    uint32_t latency[LATENCY_BUCKETS];
+};
+
+// what a handle should be doing, see sensors_poll_context_t::applyConfig()
+struct handle_config_t {
+    bool enabled;
+    bool fwEnabled;     // events are delivered to the framework
+    int64_t delay;
+};
+
 struct sensors_poll_context_t {
     struct sensors_poll_device_t device; // must be first
 
@@ -45,134 +78,532 @@ struct sensors_poll_context_t {
     int pollEvents(sensors_event_t* data, int count);
 
 private:
+    SensorBase* getDriver(int index);
+    void publishHandle(int handle);
+    void applyConfig(int64_t now);
+    static void onMuxDemand(void* cookie, int handle);
+    void wakePoll();
+    template <typename T>
+    int readDriver(int index, sensors_event_t*& data, int& count);
+    void syncDrivers();
+    int64_t expireDevices(int64_t now);
+    int pollTimeout(int64_t now);
+    void recordDelivery(sensors_event_t const* data, int count);
+    void dumpStats(int fd);
+    static void* statsThread(void* arg);
+
     enum {
-        light           = 0,
-        proximity       = 1,
-        akm             = 2,
+        light           = DRIVER_LIGHT,
+        proximity       = DRIVER_PROXIMITY,
+        akm             = DRIVER_AKM,
         numSensorDrivers,
         numFds,
     };
 
     static const size_t wake = numFds - 1;
-    static const char WAKE_MESSAGE = 'W';
-    struct pollfd mPollFds[numFds];
-    int mWritePipeFd;
-    SensorBase* mSensors[numSensorDrivers];
+    struct pollfd mPollFds[numFds];     // mPollFds[wake] is an eventfd
 
-    int handleToDriver(int handle) const {
-        switch (handle) {
-            case ID_A:
-            case ID_M:
-            case ID_O:
-                return akm;
-            case ID_P:
-                return proximity;
-            case ID_L:
-                return light;
-        }
-        return -EINVAL;
-    }
+    // drivers are only constructed when one of their handles is first
+    // enabled, by the poll thread; mSensors is guarded by mDriverLock for
+    // the stats thread and mPollSensors is the poll thread's own copy
+    pthread_mutex_t mDriverLock;
+    SensorBase* mSensors[numSensorDrivers];
+    SensorBase* mPollSensors[numSensorDrivers];
+
+    static const int numHandles = NUM_SENSOR_HANDLES;
+
+    // a handle is enabled in its driver while the framework or a mux
+    // client wants it. Binder and mux threads only record the wanted
+    // state in mPending and flag it in mDirty, under mConfigLock; the poll
+    // thread applies it to the drivers between two reads, so the drivers
+    // are never reconfigured while they are being read
+    pthread_mutex_t mConfigLock;
+    bool mFwEnabled[numHandles];
+    int64_t mFwDelay[numHandles];
+    handle_config_t mPending[numHandles];
+    uint32_t mDirty;
+    handle_config_t mApplied[numHandles];   // poll thread only
+    uint32_t mPollFwMask;                   // poll thread only
+    // handles a driver refused to enable or disable, applied again at
+    // mRetryDeadline (-1 if none)
+    uint32_t mRetry;                        // poll thread only
+    int64_t mRetryDeadline;                 // poll thread only
+    // when control devices are next due to be closed, -1 if none is
+    // pending; checked every round of pollEvents(), busy or idle
+    int64_t mExpireDeadline;                // poll thread only
+    SensorMux* mMux;
+
+    pthread_mutex_t mStatsLock;
+    sensor_handle_stats_t mHandleStats[numHandles];
+    int mStatsFd;
+    pthread_t mStatsThread;
 };
 
 /*****************************************************************************/
 
 sensors_poll_context_t::sensors_poll_context_t()
 {
-    mSensors[light] = new LightSensor();
-    mPollFds[light].fd = mSensors[light]->getFd();
-    mPollFds[light].events = POLLIN;
-    mPollFds[light].revents = 0;
-
-    mSensors[proximity] = new ProximitySensor();
-    mPollFds[proximity].fd = mSensors[proximity]->getFd();
-    mPollFds[proximity].events = POLLIN;
-    mPollFds[proximity].revents = 0;
-
-    mSensors[akm] = new AkmSensor();
-    mPollFds[akm].fd = mSensors[akm]->getFd();
-    mPollFds[akm].events = POLLIN;
-    mPollFds[akm].revents = 0;
-
-    int wakeFds[2];
-    int result = pipe(wakeFds);
-    LOGE_IF(result<0, "error creating wake pipe (%s)", strerror(errno));
-    fcntl(wakeFds[0], F_SETFL, O_NONBLOCK);
-    fcntl(wakeFds[1], F_SETFL, O_NONBLOCK);
-    mWritePipeFd = wakeFds[1];
-
-    mPollFds[wake].fd = wakeFds[0];
+    pthread_mutex_init(&mDriverLock, NULL);
+    pthread_mutex_init(&mConfigLock, NULL);
+    for (int h=0 ; h<numHandles ; h++) {
+        mFwEnabled[h] = false;
+        mFwDelay[h] = 200000000;    // 200 ms until setDelay()
+        mPending[h].enabled = false;
+        mPending[h].fwEnabled = false;
+        mPending[h].delay = mFwDelay[h];
+        mApplied[h] = mPending[h];
+        mApplied[h].delay = -1;     // whatever the driver defaults to
+    }
+    mDirty = 0;
+    mPollFwMask = 0;
+    mRetry = 0;
+    mRetryDeadline = -1;
+    mExpireDeadline = -1;
+    for (int i=0 ; i<numSensorDrivers ; i++) {
+        mSensors[i] = 0;
+        mPollSensors[i] = 0;
+        // poll() ignores negative fds until the driver exists
+        mPollFds[i].fd = -1;
+        mPollFds[i].events = POLLIN;
+        mPollFds[i].revents = 0;
+    }
+
+    mPollFds[wake].fd = eventfd(0, 0);
+    LOGE_IF(mPollFds[wake].fd<0, "error creating wake eventfd (%s)", strerror(errno));
+    fcntl(mPollFds[wake].fd, F_SETFL, O_NONBLOCK);
     mPollFds[wake].events = POLLIN;
     mPollFds[wake].revents = 0;
+
+    pthread_mutex_init(&mStatsLock, NULL);
+    memset(mHandleStats, 0, sizeof(mHandleStats));
+    mStatsFd = socket_local_server(STATS_SOCKET_NAME,
+            ANDROID_SOCKET_NAMESPACE_ABSTRACT, SOCK_STREAM);
+    LOGE_IF(mStatsFd<0, "couldn't create %s socket (%s)",
+            STATS_SOCKET_NAME, strerror(errno));
+    if (mStatsFd >= 0) {
+        fcntl(mStatsFd, F_SETFD, FD_CLOEXEC);
+        if (pthread_create(&mStatsThread, NULL, statsThread, this)) {
+            close(mStatsFd);
+            mStatsFd = -1;
+        }
+    }
+
+    mMux = new SensorMux(onMuxDemand, this);
 }
 
 sensors_poll_context_t::~sensors_poll_context_t() {
+    if (mStatsFd >= 0) {
+        // wakes up accept() in the stats thread
+        shutdown(mStatsFd, SHUT_RDWR);
+        pthread_join(mStatsThread, NULL);
+        close(mStatsFd);
+    }
+    // first, the mux thread publishes configuration changes
+    delete mMux;
     for (int i=0 ; i<numSensorDrivers ; i++) {
         delete mSensors[i];
     }
     close(mPollFds[wake].fd);
-    close(mWritePipeFd);
+    pthread_mutex_destroy(&mStatsLock);
+    pthread_mutex_destroy(&mDriverLock);
+    pthread_mutex_destroy(&mConfigLock);
 }
 
-int sensors_poll_context_t::activate(int handle, int enabled) {
-    int index = handleToDriver(handle);
-    if (index < 0) return index;
-    int err =  mSensors[index]->enable(handle, enabled);
-    if (enabled && !err) {
-        const char wakeMessage(WAKE_MESSAGE);
-        int result = write(mWritePipeFd, &wakeMessage, 1);
-        LOGE_IF(result<0, "error sending wake message (%s)", strerror(errno));
+// the constructors scan /dev/input and query the control devices, which
+// used to make every open of the HAL pay for all three drivers
+SensorBase* sensors_poll_context_t::getDriver(int index)
+{
+    pthread_mutex_lock(&mDriverLock);
+    SensorBase* sensor = mSensors[index];
+    if (!sensor) {
+        SENSORS_TRACE_CALL("createDriver");
+        switch (index) {
+            case light:     sensor = new LightSensor();     break;
+            case proximity: sensor = new ProximitySensor(); break;
+            case akm:       sensor = new AkmSensor();       break;
+        }
+        mSensors[index] = sensor;
     }
-    return err;
+    pthread_mutex_unlock(&mDriverLock);
+    return sensor;
+}
+
+// picks up drivers created by applyConfig() since the last poll
+void sensors_poll_context_t::syncDrivers()
+{
+    pthread_mutex_lock(&mDriverLock);
+    for (int i=0 ; i<numSensorDrivers ; i++) {
+        if (!mPollSensors[i] && mSensors[i]) {
+            mPollSensors[i] = mSensors[i];
+            mPollFds[i].fd = mSensors[i]->getFd();
+            mPollFds[i].revents = 0;
+        }
+    }
+    pthread_mutex_unlock(&mDriverLock);
+}
+
+void sensors_poll_context_t::wakePoll() {
+    // new configuration to apply, or a control device to close later
+    const uint64_t one = 1;
+    int result = write(mPollFds[wake].fd, &one, sizeof(one));
+    LOGE_IF(result<0, "error sending wake event (%s)", strerror(errno));
+}
+
+// records what the framework and the mux clients want from handle, called
+// with mConfigLock held; the caller then wakes the poll thread
+void sensors_poll_context_t::publishHandle(int handle) {
+    int64_t muxPeriod;
+    const bool muxWanted = mMux->getDemand(handle, &muxPeriod);
+    handle_config_t& c(mPending[handle]);
+    c.fwEnabled = mFwEnabled[handle];
+    c.enabled = c.fwEnabled || muxWanted;
+    c.delay = (c.fwEnabled || !muxWanted) ? mFwDelay[handle] : muxPeriod;
+    if (muxWanted && muxPeriod < c.delay)
+        c.delay = muxPeriod;
+    mDirty |= 1<<handle;
+}
+
+// runs on the poll thread, between two rounds of reads
+void sensors_poll_context_t::applyConfig(int64_t now) {
+    handle_config_t config[numHandles];
+    pthread_mutex_lock(&mConfigLock);
+    uint32_t dirty = mDirty;
+    mDirty = 0;
+    memcpy(config, mPending, sizeof(config));
+    pthread_mutex_unlock(&mConfigLock);
+
+    if (mRetryDeadline >= 0 && now >= mRetryDeadline) {
+        dirty |= mRetry;
+        mRetry = 0;
+        mRetryDeadline = -1;
+    }
+
+    for (int h=0 ; dirty && h<numHandles ; h++) {
+        if (!(dirty & (1<<h)))
+            continue;
+        dirty &= ~(1<<h);
+        SENSORS_TRACE_INT("config", h);
+
+        const handle_config_t& c(config[h]);
+        handle_config_t& applied(mApplied[h]);
+        const int index = handleToDriver(h);
+        pthread_mutex_lock(&mDriverLock);
+        const bool created = mSensors[index] != 0;
+        pthread_mutex_unlock(&mDriverLock);
+        if (!created && !c.enabled) {
+            // nothing to tell a driver that doesn't exist yet, the delay
+            // is applied when it gets enabled
+            continue;
+        }
+
+        SensorBase* const sensor = getDriver(index);
+        if (c.enabled != applied.enabled) {
+            // a disable may have scheduled a close of the control device
+            mExpireDeadline = 0;
+            int err = sensor->enable(h, c.enabled);
+            LOGE_IF(err, "couldn't %s handle %d (%s)",
+                    c.enabled ? "enable" : "disable", h, strerror(-err));
+            if (!err) {
+                applied.enabled = c.enabled;
+            } else {
+                mRetry |= 1<<h;
+                if (mRetryDeadline < 0)
+                    mRetryDeadline = now + CONFIG_RETRY_NS;
+            }
+        }
+        if (c.enabled == applied.enabled)
+            mRetry &= ~(1<<h);
+        if (c.delay != applied.delay) {
+            if (!sensor->setDelay(h, c.delay))
+                applied.delay = c.delay;
+        }
+        applied.fwEnabled = c.fwEnabled;
+        if (applied.fwEnabled && applied.enabled)
+            mPollFwMask |= 1<<h;
+        else
+            mPollFwMask &= ~(1<<h);
+    }
+}
+
+void sensors_poll_context_t::onMuxDemand(void* cookie, int handle) {
+    sensors_poll_context_t* ctx = static_cast<sensors_poll_context_t*>(cookie);
+    pthread_mutex_lock(&ctx->mConfigLock);
+    ctx->publishHandle(handle);
+    pthread_mutex_unlock(&ctx->mConfigLock);
+    ctx->wakePoll();
+}
+
+// activate() and setDelay() return as soon as the change is recorded, the
+// poll thread applies it; a driver that refuses an enable or a disable is
+// logged and asked again every CONFIG_RETRY_NS
+int sensors_poll_context_t::activate(int handle, int enabled) {
+    SENSORS_TRACE_CALL("activate");
+    if (handleToDriver(handle) < 0) return -EINVAL;
+
+    pthread_mutex_lock(&mConfigLock);
+    mFwEnabled[handle] = enabled != 0;
+    publishHandle(handle);
+    pthread_mutex_unlock(&mConfigLock);
+    wakePoll();
+    return 0;
 }
 
 int sensors_poll_context_t::setDelay(int handle, int64_t ns) {
+    SENSORS_TRACE_CALL("setDelay");
+    if (handleToDriver(handle) < 0) return -EINVAL;
+    if (ns < 0) return -EINVAL;
+
+    pthread_mutex_lock(&mConfigLock);
+    mFwDelay[handle] = ns;
+    publishHandle(handle);
+    pthread_mutex_unlock(&mConfigLock);
+    wakePoll();
+    return 0;
+}
 
-    int index = handleToDriver(handle);
-    if (index < 0) return index;
-    return mSensors[index]->setDelay(handle, ns);
+static int64_t monotonicNow()
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return int64_t(t.tv_sec)*1000000000LL + t.tv_nsec;
+}
+
+// closes control devices whose grace period is over, returns when the next
+// one is due or -1
+int64_t sensors_poll_context_t::expireDevices(int64_t now)
+{
+    int64_t deadline = -1;
+    for (int i=0 ; i<numSensorDrivers ; i++) {
+        SensorBase* const sensor(mPollSensors[i]);
+        if (!sensor)
+            continue;
+        int64_t d = sensor->expireDevice(now);
+        if (d >= 0 && (deadline < 0 || d < deadline))
+            deadline = d;
+    }
+    return deadline;
+}
+
+// how long poll() may sleep before a driver has something held back to
+// report, a control device is to be closed or a refused change retried
+int sensors_poll_context_t::pollTimeout(int64_t now)
+{
+    int64_t deadline = mExpireDeadline;
+    if (mRetryDeadline >= 0 && (deadline < 0 || mRetryDeadline < deadline))
+        deadline = mRetryDeadline;
+    for (int i=0 ; i<numSensorDrivers ; i++) {
+        SensorBase* const sensor(mPollSensors[i]);
+        if (!sensor)
+            continue;
+        int64_t d = sensor->getPendingDeadline();
+        if (d >= 0 && (deadline < 0 || d < deadline))
+            deadline = d;
+    }
+    if (deadline < 0)
+        return -1;
+
+    if (deadline <= now)
+        return 0;
+    // round up so we don't wake up just before the deadline
+    return int((deadline - now + 999999) / 1000000);
+}
+
+void sensors_poll_context_t::recordDelivery(sensors_event_t const* data, int count)
+{
+    const int64_t now = monotonicNow();
+
+    pthread_mutex_lock(&mStatsLock);
+    for (int i=0 ; i<count ; i++) {
+        if (uint32_t(data[i].sensor) >= uint32_t(numHandles))
+            continue;
+        sensor_handle_stats_t& s(mHandleStats[data[i].sensor]);
+        const int64_t ts = data[i].timestamp;
+        if (s.delivered && ts > s.lastTimestamp) {
+            const int64_t interval = ts - s.lastTimestamp;
+            s.avgIntervalNs = s.avgIntervalNs ?
+                    s.avgIntervalNs + (interval - s.avgIntervalNs) / 8 : interval;
+        }
+        s.delivered++;
+        s.lastTimestamp = ts;
+
+        const int64_t latency = now - ts;
+        if (latency < 0 || latency > 10000000000LL) {
+            s.unaligned++;
+            continue;
+        }
+        int64_t ms = latency / 1000000;
+        int b = 0;
+        while (ms && b < LATENCY_BUCKETS-1) {
+            ms >>= 1;
+            b++;
+        }
+        s.latency[b]++;
+    }
+    pthread_mutex_unlock(&mStatsLock);
+}
+
+void sensors_poll_context_t::dumpStats(int fd)
+{
+    static const char* const driverNames[numSensorDrivers] = {
+            "light", "proximity", "akm" };
+    char buf[512];
+    int len;
+
+    for (int i=0 ; i<numSensorDrivers ; i++) {
+        pthread_mutex_lock(&mDriverLock);
+        SensorBase* const sensor(mSensors[i]);
+        pthread_mutex_unlock(&mDriverLock);
+        if (!sensor) {
+            len = snprintf(buf, sizeof(buf), "driver %s not created\n",
+                    driverNames[i]);
+            write(fd, buf, len);
+            continue;
+        }
+        sensor_driver_stats_t d;
+        sensor->getStats(&d);
+        len = snprintf(buf, sizeof(buf),
+                "driver %s evdev_events %u partial_reads %u ring_full %u dropped %u\n",
+                driverNames[i], d.evdevEvents, d.partialReads, d.ringFull, d.dropped);
+        write(fd, buf, len);
+    }
+
+    sensor_handle_stats_t stats[numHandles];
+    pthread_mutex_lock(&mStatsLock);
+    memcpy(stats, mHandleStats, sizeof(stats));
+    pthread_mutex_unlock(&mStatsLock);
+
+    for (int h=0 ; h<numHandles ; h++) {
+        const sensor_handle_stats_t& s(stats[h]);
+        len = snprintf(buf, sizeof(buf),
+                "handle %d delivered %u rate_mhz %lld unaligned %u latency_ms_log2",
+                h, s.delivered,
+                s.avgIntervalNs ? 1000000000000LL / s.avgIntervalNs : 0LL,
+                s.unaligned);
+        for (int b=0 ; b<LATENCY_BUCKETS ; b++) {
+            len += snprintf(buf+len, sizeof(buf)-len, " %u", s.latency[b]);
+        }
+        len += snprintf(buf+len, sizeof(buf)-len, "\n");
+        write(fd, buf, len);
+    }
+
+    mMux->dump(fd);
+    SENSORS_TRACE_DUMP(fd);
+}
+
+int sensors_peer_allowed(int fd)
+{
+    struct ucred cred;
+    socklen_t len = sizeof(cred);
+    if (getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &cred, &len) < 0) {
+        LOGE("SO_PEERCRED failed (%s)", strerror(errno));
+        return 0;
+    }
+    if (cred.uid != AID_ROOT && cred.uid != AID_SYSTEM) {
+        LOGW("refusing socket client pid %d uid %d", cred.pid, cred.uid);
+        return 0;
+    }
+    return 1;
+}
+
+// one text dump per connection, e.g. "socat - ABSTRACT-CONNECT:sensors-stats"
+void* sensors_poll_context_t::statsThread(void* arg)
+{
+    sensors_poll_context_t* ctx = static_cast<sensors_poll_context_t*>(arg);
+    for (;;) {
+        int fd = accept(ctx->mStatsFd, NULL, NULL);
+        if (fd < 0) {
+            if (errno == EINTR)
+                continue;
+            break;
+        }
+        if (sensors_peer_allowed(fd))
+            ctx->dumpStats(fd);
+        close(fd);
+    }
+    return NULL;
+}
+
+// reads a driver through its concrete type, so that the calls into it are
+// resolved at compile time; advances data and count past what was read
+template <typename T>
+inline int sensors_poll_context_t::readDriver(int index,
+        sensors_event_t*& data, int& count)
+{
+    T* const sensor = static_cast<T*>(mPollSensors[index]);
+    if (!sensor || !count)
+        return 0;
+    if (!(mPollFds[index].revents & POLLIN) && !sensor->pollHasPendingEvents())
+        return 0;
+
+    int nb = sensor->pollReadEvents(data, count);
+    if (nb < count) {
+        // no more data for this sensor
+        mPollFds[index].revents = 0;
+    }
+    if (nb <= 0)
+        return 0;
+
+    // mux clients see everything, the framework only what it enabled
+    mMux->publish(data, nb);
+    int kept = 0;
+    for (int i=0 ; i<nb ; i++) {
+        if (mPollFwMask & (1<<data[i].sensor)) {
+            if (kept != i)
+                data[kept] = data[i];
+            kept++;
+        }
+    }
+    nb = kept;
+    if (!nb)
+        return 0;
+
+    recordDelivery(data, nb);
+    count -= nb;
+    data += nb;
+    return nb;
 }
 
 int sensors_poll_context_t::pollEvents(sensors_event_t* data, int count)
 {
+    SENSORS_TRACE_CALL("pollEvents");
     int nbEvents = 0;
     int n = 0;
 
     do {
+        int64_t now = monotonicNow();
+        applyConfig(now);
+        syncDrivers();
+
+        // a driver that streams keeps us from ever sleeping in poll(), the
+        // devices of the idle ones must be closed all the same
+        if (mExpireDeadline >= 0 && now >= mExpireDeadline)
+            mExpireDeadline = expireDevices(now);
+
         // see if we have some leftover from the last poll()
-        for (int i=0 ; count && i<numSensorDrivers ; i++) {
-            SensorBase* const sensor(mSensors[i]);
-            if ((mPollFds[i].revents & POLLIN) || (sensor->hasPendingEvents())) {
-                int nb = sensor->readEvents(data, count);
-                if (nb < count) {
-                    // no more data for this sensor
-                    mPollFds[i].revents = 0;
-                }
-                count -= nb;
-                nbEvents += nb;
-                data += nb;
-            }
-        }
+        nbEvents += readDriver<LightSensor>(light, data, count);
+        nbEvents += readDriver<ProximitySensor>(proximity, data, count);
+        nbEvents += readDriver<AkmSensor>(akm, data, count);
 
         if (count) {
             // we still have some room, so try to see if we can get
             // some events immediately or just wait if we don't have
             // anything to return
-            n = poll(mPollFds, numFds, nbEvents ? 0 : -1);
+            n = poll(mPollFds, numFds, nbEvents ? 0 : pollTimeout(now));
             if (n<0) {
                 LOGE("poll() failed (%s)", strerror(errno));
                 return -errno;
             }
             if (mPollFds[wake].revents & POLLIN) {
-                char msg;
-                int result = read(mPollFds[wake].fd, &msg, 1);
-                LOGE_IF(result<0, "error reading from wake pipe (%s)", strerror(errno));
-                LOGE_IF(msg != WAKE_MESSAGE, "unknown message on wake queue (0x%02x)", int(msg));
+                uint64_t wakeups;
+                int result = read(mPollFds[wake].fd, &wakeups, sizeof(wakeups));
+                LOGE_IF(result<0, "error reading wake event (%s)", strerror(errno));
                 mPollFds[wake].revents = 0;
             }
         }
         // if we have events and space, go read them
     } while (n && count);
 
+    SENSORS_TRACE_INT("events", nbEvents);
     return nbEvents;
 }
 
@@ -211,6 +642,7 @@ int init_nusensors(hw_module_t const* module, hw_device_t** device)
 {
     int status = -EINVAL;
 
+    SENSORS_TRACE_INIT();
     sensors_poll_context_t *dev = new sensors_poll_context_t();
     memset(&dev->device, 0, sizeof(sensors_poll_device_t));
 
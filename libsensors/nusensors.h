@@ -33,15 +33,70 @@ __BEGIN_DECLS
 
 int init_nusensors(hw_module_t const* module, hw_device_t** device);
 
+/* the HAL's local sockets (stats, mux) only serve root and system, this
+ * returns 0 and logs anyone else connected to fd */
+int sensors_peer_allowed(int fd);
+
 /*****************************************************************************/
 
 #define ARRAY_SIZE(a) (sizeof(a) / sizeof(a[0]))
 
-#define ID_A  (0)
-#define ID_M  (1)
-#define ID_O  (2)
-#define ID_P  (3)
-#define ID_L  (4)
+/* computed from the accelerometer in AkmSensor, this platform's sensors.h
+ * predates them so the values of later releases are used. Both report in
+ * data[0]: 1 for each step, and the steps counted since the HAL was opened */
+#ifndef SENSOR_TYPE_STEP_DETECTOR
+#define SENSOR_TYPE_STEP_DETECTOR   18
+#endif
+#ifndef SENSOR_TYPE_STEP_COUNTER
+#define SENSOR_TYPE_STEP_COUNTER    19
+#endif
+
+/* drivers behind the sensors, see sensors_poll_context_t */
+#define DRIVER_LIGHT        0
+#define DRIVER_PROXIMITY    1
+#define DRIVER_AKM          2
+
+/*
+ * One line per sensor, in handle order:
+ *   ENTRY(id, name, vendor, type, maxRange, resolution, power, driver, slot)
+ * where slot is the sensor's index inside its driver. This is expanded into
+ * the ID_* handles below, the sensor list in sensors.c and the dispatch
+ * tables in SensorTable.h, so adding a sensor only takes a line here.
+ *
+ * the AK8973 has a 8-bit ADC but the firmware seems to average 16 samples,
+ * or at least makes its calibration on 12-bits values. This increases the
+ * resolution by 4 bits.
+ */
+#define SENSOR_TABLE(ENTRY)                                                 \
+    ENTRY(A, "BMA150 3-axis Accelerometer", "Bosh",                         \
+            SENSOR_TYPE_ACCELEROMETER, 4.0f*9.81f, (4.0f*9.81f)/256.0f,     \
+            0.2f, DRIVER_AKM, 0)                                            \
+    ENTRY(M, "AK8973 3-axis Magnetic field sensor", "Asahi Kasei",          \
+            SENSOR_TYPE_MAGNETIC_FIELD, 2000.0f, 1.0f/16.0f,                \
+            6.8f, DRIVER_AKM, 1)                                            \
+    ENTRY(O, "AK8973 Orientation sensor", "Asahi Kasei",                    \
+            SENSOR_TYPE_ORIENTATION, 360.0f, 1.0f,                          \
+            7.0f, DRIVER_AKM, 2)                                            \
+    ENTRY(P, "CM3602 Proximity sensor", "Capella Microsystems",             \
+            SENSOR_TYPE_PROXIMITY, PROXIMITY_THRESHOLD_CM,                  \
+            PROXIMITY_THRESHOLD_CM, 0.5f, DRIVER_PROXIMITY, 0)              \
+    ENTRY(L, "CM3602 Light sensor", "Capella Microsystems",                 \
+            SENSOR_TYPE_LIGHT, 10240.0f, 1.0f,                              \
+            0.5f, DRIVER_LIGHT, 0)                                          \
+    ENTRY(SD, "Step detector", "The CyanogenMod Project",                   \
+            SENSOR_TYPE_STEP_DETECTOR, 1.0f, 1.0f,                          \
+            0.2f, DRIVER_AKM, 3)                                            \
+    ENTRY(SC, "Step counter", "The CyanogenMod Project",                    \
+            SENSOR_TYPE_STEP_COUNTER, 1e9f, 1.0f,                           \
+            0.2f, DRIVER_AKM, 4)
+
+#define SENSOR_ID(id, name, vendor, type, range, res, power, driver, slot) \
+        ID_##id,
+enum {
+    SENSOR_TABLE(SENSOR_ID)
+    NUM_SENSOR_HANDLES
+};
+#undef SENSOR_ID
 
 /*****************************************************************************/
 
@@ -52,9 +107,59 @@ int init_nusensors(hw_module_t const* module, hw_device_t** device);
 /* the CM3602 is a binary proximity sensor that triggers around 9 cm on
  * this hardware */
 #define PROXIMITY_THRESHOLD_CM  9.0f
+/* every near/far change is reported at once, only repeats are dropped */
+#define PROXIMITY_JITTER_STEPS  0
+#define PROXIMITY_DEBOUNCE_NS   0
+
+/* the light level jitters between adjacent lux buckets, a one bucket change
+ * is only reported once it held for this long */
+#define LIGHT_JITTER_STEPS      1
+#define LIGHT_DEBOUNCE_NS       500000000LL
+
+/* control devices stay open this long after the last sensor of a driver is
+ * disabled, listeners are often re-registered right away. 0 closes them at
+ * once */
+#ifndef CONTROL_CLOSE_GRACE_NS
+#define CONTROL_CLOSE_GRACE_NS  5000000000LL
+#endif
+
+/* a handle its driver failed to enable or disable is tried again after this
+ * long, until the driver takes the change or it is undone */
+#define CONFIG_RETRY_NS         200000000LL
+
+/* how often the REALTIME to MONOTONIC offset is re-estimated for input
+ * devices that can't report monotonic timestamps themselves */
+#define CLOCK_OFFSET_REFRESH_NS 1000000000LL
+
+/* compass readings buffered in the HAL when the framework reads less than
+ * the hardware produces, see SampleFifo */
+#define AKM_FIFO_SAMPLES        256
+
+/* accelerometer rate kept up for the step sensors */
+#define STEP_DELAY_NS           20000000LL
+
+/* once the accelerometer moved less than AKM_MOTION_THRESHOLD (m/s^2) for
+ * AKM_STILL_NS, the chip is slowed down to AKM_STILL_DELAY_NS and the last
+ * readings are repeated at the requested rates; the first sample showing
+ * motion restores the full rate. 0 disables this */
+#define AKM_STILL_DELAY_NS      200000000LL
+#define AKM_STILL_NS            2000000000LL
+#define AKM_MOTION_THRESHOLD    0.3f
+/* a repeat is only made up this long after its date, by then a real reading
+ * of the same time would have come through the input layer */
+#define AKM_INPUT_LATENCY_NS    5000000LL
+
+#ifndef EVIOCSCLOCKID
+#define EVIOCSCLOCKID           _IOW('E', 0xa0, int)
+#endif
 
 /*****************************************************************************/
 
+/* when set in the environment of a host test build (SENSORS_HOST_TEST), the
+ * device nodes below and /dev/input are looked up under this directory
+ * instead of / */
+#define SENSORS_ROOT_ENV    "SENSORS_ROOT"
+
 #define AKM_DEVICE_NAME     "/dev/akm8973_aot"
 #define CM_DEVICE_NAME      "/dev/cm3602"
 #define LS_DEVICE_NAME      "/dev/lightsensor"
@@ -101,6 +206,27 @@ int init_nusensors(hw_module_t const* module, hw_device_t** device);
 
 #define SENSOR_STATE_MASK           (0x7FFF)
 
+/*
+ * evdev ABS codes of the compass input device:
+ *   ENTRY(code, id, axis, scale)
+ * axis indexes the sensor's vector, AXIS_STATUS takes the status byte of
+ * the value instead. The accelerometer status and the temperature are not
+ * reported.
+ */
+#define AXIS_STATUS                 3
+
+#define AKM_AXIS_TABLE(ENTRY)                               \
+    ENTRY(EVENT_TYPE_ACCEL_X,       A, 0, CONVERT_A_X)      \
+    ENTRY(EVENT_TYPE_ACCEL_Y,       A, 1, CONVERT_A_Y)      \
+    ENTRY(EVENT_TYPE_ACCEL_Z,       A, 2, CONVERT_A_Z)      \
+    ENTRY(EVENT_TYPE_MAGV_X,        M, 0, CONVERT_M_X)      \
+    ENTRY(EVENT_TYPE_MAGV_Y,        M, 1, CONVERT_M_Y)      \
+    ENTRY(EVENT_TYPE_MAGV_Z,        M, 2, CONVERT_M_Z)      \
+    ENTRY(EVENT_TYPE_YAW,           O, 0, CONVERT_O_Y)      \
+    ENTRY(EVENT_TYPE_PITCH,         O, 1, CONVERT_O_P)      \
+    ENTRY(EVENT_TYPE_ROLL,          O, 2, CONVERT_O_R)      \
+    ENTRY(EVENT_TYPE_ORIENT_STATUS, O, AXIS_STATUS, 1.0f)
+
 /*****************************************************************************/
 
 __END_DECLS
@@ -24,35 +24,12 @@
  * The SENSORS Module
  */
 
-/*
- * the AK8973 has a 8-bit ADC but the firmware seems to average 16 samples,
- * or at least makes its calibration on 12-bits values. This increases the
- * resolution by 4 bits.
- */
+#define SENSOR_INFO(id, name, vendor, type, range, res, power, driver, slot) \
+        { name, vendor, 1, SENSORS_HANDLE_BASE+ID_##id,                     \
+                type, range, res, power, 0, { } },
 
 static const struct sensor_t sSensorList[] = {
-        { "BMA150 3-axis Accelerometer",
-                "Bosh",
-                1, SENSORS_HANDLE_BASE+ID_A,
-                SENSOR_TYPE_ACCELEROMETER, 4.0f*9.81f, (4.0f*9.81f)/256.0f, 0.2f, 0, { } },
-        { "AK8973 3-axis Magnetic field sensor",
-                "Asahi Kasei",
-                1, SENSORS_HANDLE_BASE+ID_M,
-                SENSOR_TYPE_MAGNETIC_FIELD, 2000.0f, 1.0f/16.0f, 6.8f, 0, { } },
-        { "AK8973 Orientation sensor",
-                "Asahi Kasei",
-                1, SENSORS_HANDLE_BASE+ID_O,
-                SENSOR_TYPE_ORIENTATION, 360.0f, 1.0f, 7.0f, 0, { } },
-        { "CM3602 Proximity sensor",
-                "Capella Microsystems",
-                1, SENSORS_HANDLE_BASE+ID_P,
-                SENSOR_TYPE_PROXIMITY,
-                PROXIMITY_THRESHOLD_CM, PROXIMITY_THRESHOLD_CM,
-                0.5f, 0, { } },
-        { "CM3602 Light sensor",
-                "Capella Microsystems",
-                1, SENSORS_HANDLE_BASE+ID_L,
-                SENSOR_TYPE_LIGHT, 10240.0f, 1.0f, 0.5f, 0, { } },
+        SENSOR_TABLE(SENSOR_INFO)
 };
 
 static int open_sensors(const struct hw_module_t* module, const char* name,
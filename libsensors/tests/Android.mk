@@ -0,0 +1,132 @@
+# Copyright (C) 2011 The CyanogenMod Project
+#
+# Host tests and benchmarks for the sensors HAL. Those that run the drivers
+# do it over fake_kernel.c, which puts the device nodes under a temporary
+# $SENSORS_ROOT and answers their ioctls.
+
+LOCAL_PATH := $(call my-dir)
+
+sensors_test_includes := $(LOCAL_PATH)/.. hardware/libhardware/include $(KERNEL_HEADERS)
+sensors_test_cflags := -D_GNU_SOURCE -DLOG_TAG=\"Sensors\" -DSENSORS_HOST_TEST
+
+sensors_hal_sources := \
+	../nusensors.cpp \
+	../InputEventReader.cpp \
+	../SensorBase.cpp \
+	../LightSensor.cpp \
+	../ProximitySensor.cpp \
+	../AkmSensor.cpp \
+	../OnChangeFilter.cpp \
+	../SampleFifo.cpp \
+	../SensorMux.cpp \
+	../StepDetector.cpp \
+	../HalTrace.cpp \
+	fake_kernel.c \
+	hal_harness.cpp
+
+include $(CLEAR_VARS)
+LOCAL_MODULE_TAGS := tests
+LOCAL_SRC_FILES := onchange_filter_test.cpp ../OnChangeFilter.cpp
+LOCAL_C_INCLUDES := $(sensors_test_includes)
+LOCAL_MODULE := sensors_onchange_filter_test
+include $(BUILD_HOST_EXECUTABLE)
+
+include $(CLEAR_VARS)
+LOCAL_MODULE_TAGS := tests
+LOCAL_SRC_FILES := sensors_sample_fifo_test.cpp ../SampleFifo.cpp
+LOCAL_C_INCLUDES := $(sensors_test_includes)
+LOCAL_LDLIBS := -lrt
+LOCAL_MODULE := sensors_sample_fifo_test
+include $(BUILD_HOST_EXECUTABLE)
+
+include $(CLEAR_VARS)
+LOCAL_MODULE_TAGS := tests
+LOCAL_SRC_FILES := sensors_input_reader_bench.cpp ../InputEventReader.cpp
+LOCAL_C_INCLUDES := $(sensors_test_includes)
+LOCAL_CFLAGS := $(sensors_test_cflags)
+LOCAL_STATIC_LIBRARIES := libcutils liblog
+LOCAL_LDLIBS := -lrt
+LOCAL_MODULE := sensors_input_reader_bench
+include $(BUILD_HOST_EXECUTABLE)
+
+# with a short grace period, so that the expiry check doesn't take long
+include $(CLEAR_VARS)
+LOCAL_MODULE_TAGS := tests
+LOCAL_SRC_FILES := sensors_device_bench.cpp $(sensors_hal_sources)
+LOCAL_C_INCLUDES := $(sensors_test_includes)
+LOCAL_CFLAGS := $(sensors_test_cflags) -DCONTROL_CLOSE_GRACE_NS=300000000LL
+LOCAL_STATIC_LIBRARIES := libcutils liblog
+LOCAL_LDLIBS := -lpthread -lrt
+LOCAL_MODULE := sensors_device_bench
+include $(BUILD_HOST_EXECUTABLE)
+
+# the drivers as they were: open and close the control device every time
+include $(CLEAR_VARS)
+LOCAL_MODULE_TAGS := tests
+LOCAL_SRC_FILES := sensors_device_bench.cpp $(sensors_hal_sources)
+LOCAL_C_INCLUDES := $(sensors_test_includes)
+LOCAL_CFLAGS := $(sensors_test_cflags) -DCONTROL_CLOSE_GRACE_NS=0
+LOCAL_STATIC_LIBRARIES := libcutils liblog
+LOCAL_LDLIBS := -lpthread -lrt
+LOCAL_MODULE := sensors_device_bench_nograce
+include $(BUILD_HOST_EXECUTABLE)
+
+include $(CLEAR_VARS)
+LOCAL_MODULE_TAGS := tests
+LOCAL_SRC_FILES := sensors_stats_test.cpp $(sensors_hal_sources)
+LOCAL_C_INCLUDES := $(sensors_test_includes)
+LOCAL_CFLAGS := $(sensors_test_cflags)
+LOCAL_STATIC_LIBRARIES := libcutils liblog
+LOCAL_LDLIBS := -lpthread -lrt
+LOCAL_MODULE := sensors_stats_test
+include $(BUILD_HOST_EXECUTABLE)
+
+include $(CLEAR_VARS)
+LOCAL_MODULE_TAGS := tests
+LOCAL_SRC_FILES := sensors_mux_test.cpp $(sensors_hal_sources)
+LOCAL_C_INCLUDES := $(sensors_test_includes)
+LOCAL_CFLAGS := $(sensors_test_cflags)
+LOCAL_STATIC_LIBRARIES := libcutils liblog
+LOCAL_LDLIBS := -lpthread -lrt
+LOCAL_MODULE := sensors_mux_test
+include $(BUILD_HOST_EXECUTABLE)
+
+include $(CLEAR_VARS)
+LOCAL_MODULE_TAGS := tests
+LOCAL_SRC_FILES := sensors_config_stress_test.cpp $(sensors_hal_sources)
+LOCAL_C_INCLUDES := $(sensors_test_includes)
+LOCAL_CFLAGS := $(sensors_test_cflags)
+LOCAL_STATIC_LIBRARIES := libcutils liblog
+LOCAL_LDLIBS := -lpthread -lrt
+LOCAL_MODULE := sensors_config_stress_test
+include $(BUILD_HOST_EXECUTABLE)
+
+include $(CLEAR_VARS)
+LOCAL_MODULE_TAGS := tests
+LOCAL_SRC_FILES := sensors_akm_still_test.cpp $(sensors_hal_sources)
+LOCAL_C_INCLUDES := $(sensors_test_includes)
+LOCAL_CFLAGS := $(sensors_test_cflags)
+LOCAL_STATIC_LIBRARIES := libcutils liblog
+LOCAL_LDLIBS := -lpthread -lrt
+LOCAL_MODULE := sensors_akm_still_test
+include $(BUILD_HOST_EXECUTABLE)
+
+include $(CLEAR_VARS)
+LOCAL_MODULE_TAGS := tests
+LOCAL_SRC_FILES := sensors_step_test.cpp $(sensors_hal_sources)
+LOCAL_C_INCLUDES := $(sensors_test_includes)
+LOCAL_CFLAGS := $(sensors_test_cflags)
+LOCAL_STATIC_LIBRARIES := libcutils liblog
+LOCAL_LDLIBS := -lpthread -lrt
+LOCAL_MODULE := sensors_step_test
+include $(BUILD_HOST_EXECUTABLE)
+
+include $(CLEAR_VARS)
+LOCAL_MODULE_TAGS := tests
+LOCAL_SRC_FILES := sensors_dispatch_bench.cpp $(sensors_hal_sources)
+LOCAL_C_INCLUDES := $(sensors_test_includes)
+LOCAL_CFLAGS := $(sensors_test_cflags)
+LOCAL_STATIC_LIBRARIES := libcutils liblog
+LOCAL_LDLIBS := -lpthread -lrt
+LOCAL_MODULE := sensors_dispatch_bench
+include $(BUILD_HOST_EXECUTABLE)
@@ -0,0 +1,384 @@
+/*
+ * Copyright (C) 2011 The CyanogenMod Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <ftw.h>
+#include <dirent.h>
+#include <limits.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+
+#include <linux/akm8973.h>
+#include <linux/capella_cm3602.h>
+#include <linux/lightsensor.h>
+
+#include "nusensors.h"
+#include "fake_kernel.h"
+
+/*****************************************************************************/
+
+#define MAX_INPUTS      8
+#define MAX_COMMANDS    32
+
+struct fake_input {
+    char name[80];
+    int fd;                 /* our end of the FIFO, O_RDWR */
+    int abs[ABS_MAX + 1];
+};
+
+struct fake_command {
+    unsigned long cmd;
+    unsigned calls;
+    int value;
+    int fail_err;
+    int fail_times;
+};
+
+static char s_root[64];
+static pthread_mutex_t s_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct fake_input s_inputs[MAX_INPUTS];
+static int s_num_inputs;
+static struct fake_command s_commands[MAX_COMMANDS];
+static int s_num_commands;
+
+/* GET commands and the SET whose value they read back */
+static const unsigned long s_get_set[][2] = {
+    { ECS_IOCTL_APP_GET_AFLAG, ECS_IOCTL_APP_SET_AFLAG },
+    { ECS_IOCTL_APP_GET_MFLAG, ECS_IOCTL_APP_SET_MFLAG },
+    { ECS_IOCTL_APP_GET_MVFLAG, ECS_IOCTL_APP_SET_MVFLAG },
+    { ECS_IOCTL_APP_GET_TFLAG, ECS_IOCTL_APP_SET_TFLAG },
+    { CAPELLA_CM3602_IOCTL_GET_ENABLED, CAPELLA_CM3602_IOCTL_ENABLE },
+    { LIGHTSENSOR_IOCTL_GET_ENABLED, LIGHTSENSOR_IOCTL_ENABLE },
+};
+
+/*****************************************************************************/
+
+int64_t fake_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static int remove_entry(const char *path, const struct stat *sb, int flag,
+        struct FTW *ftw)
+{
+    return remove(path);
+}
+
+int fake_kernel_init(void)
+{
+    char path[PATH_MAX];
+
+    strcpy(s_root, "/tmp/sensors-root-XXXXXX");
+    if (!mkdtemp(s_root)) {
+        perror("mkdtemp");
+        s_root[0] = '\0';
+        return -1;
+    }
+    snprintf(path, sizeof(path), "%s/dev", s_root);
+    mkdir(path, 0755);
+    snprintf(path, sizeof(path), "%s/dev/input", s_root);
+    mkdir(path, 0755);
+    setenv(SENSORS_ROOT_ENV, s_root, 1);
+    return 0;
+}
+
+void fake_kernel_exit(void)
+{
+    int i;
+
+    for (i = 0; i < s_num_inputs; i++)
+        close(s_inputs[i].fd);
+    s_num_inputs = 0;
+    if (s_root[0])
+        nftw(s_root, remove_entry, 8, FTW_DEPTH | FTW_PHYS);
+    s_root[0] = '\0';
+    unsetenv(SENSORS_ROOT_ENV);
+}
+
+const char *fake_kernel_root(void)
+{
+    return s_root;
+}
+
+int fake_input_add(const char *name)
+{
+    struct fake_input *in;
+    char path[PATH_MAX];
+
+    if (s_num_inputs == MAX_INPUTS)
+        return -1;
+    in = &s_inputs[s_num_inputs];
+    snprintf(path, sizeof(path), "%s/dev/input/event%d", s_root, s_num_inputs);
+    if (mkfifo(path, 0644) < 0) {
+        perror(path);
+        return -1;
+    }
+    /* read-write, so that the HAL's open doesn't wait for a writer */
+    in->fd = open(path, O_RDWR);
+    if (in->fd < 0) {
+        perror(path);
+        return -1;
+    }
+    snprintf(in->name, sizeof(in->name), "%s", name);
+    memset(in->abs, 0, sizeof(in->abs));
+    return s_num_inputs++;
+}
+
+void fake_input_set_abs(int dev, int code, int value)
+{
+    pthread_mutex_lock(&s_lock);
+    s_inputs[dev].abs[code] = value;
+    pthread_mutex_unlock(&s_lock);
+}
+
+int fake_input_frame(int dev, const int *codes, const int *values, int n,
+        int64_t time)
+{
+    struct input_event ev[ABS_MAX + 2];
+    int i;
+
+    if (n > ABS_MAX + 1)
+        return -EINVAL;
+    memset(ev, 0, sizeof(ev));
+    for (i = 0; i <= n; i++) {
+        ev[i].time.tv_sec = time / 1000000000LL;
+        ev[i].time.tv_usec = (time % 1000000000LL) / 1000;
+        ev[i].type = i < n ? EV_ABS : EV_SYN;
+        ev[i].code = i < n ? codes[i] : SYN_REPORT;
+        ev[i].value = i < n ? values[i] : 0;
+    }
+    /* a frame is at most a few hundred bytes, written atomically */
+    return write(s_inputs[dev].fd, ev, (n + 1) * sizeof(ev[0])) < 0 ? -errno : 0;
+}
+
+int fake_control_add(const char *path)
+{
+    char full[PATH_MAX];
+    int fd;
+
+    snprintf(full, sizeof(full), "%s%s", s_root, path);
+    fd = open(full, O_CREAT | O_WRONLY, 0644);
+    if (fd < 0) {
+        perror(full);
+        return -1;
+    }
+    close(fd);
+    return 0;
+}
+
+int fake_control_opened(const char *path)
+{
+    char full[PATH_MAX], link[PATH_MAX], target[PATH_MAX];
+    struct dirent *de;
+    DIR *dir;
+    ssize_t len;
+    int count = 0;
+
+    snprintf(full, sizeof(full), "%s%s", s_root, path);
+    dir = opendir("/proc/self/fd");
+    if (!dir)
+        return -1;
+    while ((de = readdir(dir))) {
+        snprintf(link, sizeof(link), "/proc/self/fd/%s", de->d_name);
+        len = readlink(link, target, sizeof(target) - 1);
+        if (len < 0)
+            continue;
+        target[len] = '\0';
+        if (!strcmp(target, full))
+            count++;
+    }
+    closedir(dir);
+    return count;
+}
+
+/*****************************************************************************/
+
+/* called with s_lock held */
+static struct fake_command *command_locked(unsigned long cmd)
+{
+    int i;
+
+    for (i = 0; i < s_num_commands; i++) {
+        if (s_commands[i].cmd == cmd)
+            return &s_commands[i];
+    }
+    if (s_num_commands == MAX_COMMANDS)
+        return NULL;
+    memset(&s_commands[i], 0, sizeof(s_commands[i]));
+    s_commands[i].cmd = cmd;
+    s_num_commands++;
+    return &s_commands[i];
+}
+
+unsigned fake_ioctl_calls(unsigned long cmd)
+{
+    unsigned calls;
+
+    pthread_mutex_lock(&s_lock);
+    calls = command_locked(cmd)->calls;
+    pthread_mutex_unlock(&s_lock);
+    return calls;
+}
+
+int fake_ioctl_value(unsigned long cmd)
+{
+    int value;
+
+    pthread_mutex_lock(&s_lock);
+    value = command_locked(cmd)->value;
+    pthread_mutex_unlock(&s_lock);
+    return value;
+}
+
+void fake_ioctl_set(unsigned long cmd, int value)
+{
+    pthread_mutex_lock(&s_lock);
+    command_locked(cmd)->value = value;
+    pthread_mutex_unlock(&s_lock);
+}
+
+void fake_ioctl_fail(unsigned long cmd, int err, int times)
+{
+    struct fake_command *c;
+
+    pthread_mutex_lock(&s_lock);
+    c = command_locked(cmd);
+    c->fail_err = err;
+    c->fail_times = times;
+    pthread_mutex_unlock(&s_lock);
+}
+
+void fake_ioctl_reset(void)
+{
+    int i;
+
+    pthread_mutex_lock(&s_lock);
+    for (i = 0; i < s_num_commands; i++) {
+        s_commands[i].calls = 0;
+        s_commands[i].fail_times = 0;
+    }
+    pthread_mutex_unlock(&s_lock);
+}
+
+/* the fake input device fd refers to, -1 for a control device, -2 if not ours */
+static int fake_device(int fd)
+{
+    char link[32], target[PATH_MAX];
+    size_t rootlen = strlen(s_root);
+    ssize_t len;
+    int dev;
+
+    if (!rootlen)
+        return -2;
+    snprintf(link, sizeof(link), "/proc/self/fd/%d", fd);
+    len = readlink(link, target, sizeof(target) - 1);
+    if (len < 0)
+        return -2;
+    target[len] = '\0';
+    if (strncmp(target, s_root, rootlen))
+        return -2;
+    if (sscanf(target + rootlen, "/dev/input/event%d", &dev) == 1)
+        return dev < s_num_inputs ? dev : -2;
+    return -1;
+}
+
+static int input_ioctl(struct fake_input *in, unsigned long cmd, void *arg)
+{
+    if (_IOC_TYPE(cmd) == 'E' && _IOC_NR(cmd) == _IOC_NR(EVIOCGNAME(0))) {
+        size_t len = _IOC_SIZE(cmd);
+        size_t n = strlen(in->name) + 1;
+        if (n > len)
+            n = len;
+        memcpy(arg, in->name, n);
+        return n;
+    }
+    if (cmd == EVIOCSCLOCKID)
+        return 0;
+    if (_IOC_TYPE(cmd) == 'E' && (_IOC_NR(cmd) & ~ABS_MAX) == _IOC_NR(EVIOCGABS(0))) {
+        struct input_absinfo *info = arg;
+        memset(info, 0, sizeof(*info));
+        info->value = in->abs[_IOC_NR(cmd) & ABS_MAX];
+        return 0;
+    }
+    errno = EINVAL;
+    return -1;
+}
+
+static int control_ioctl(unsigned long cmd, void *arg)
+{
+    struct fake_command *c;
+    unsigned long from = cmd;
+    size_t i;
+    int value;
+
+    c = command_locked(cmd);
+    if (!c) {
+        errno = ENOMEM;
+        return -1;
+    }
+    c->calls++;
+    if (c->fail_times) {
+        c->fail_times--;
+        errno = c->fail_err;
+        return -1;
+    }
+    for (i = 0; i < sizeof(s_get_set) / sizeof(s_get_set[0]); i++) {
+        if (s_get_set[i][0] == cmd)
+            from = s_get_set[i][1];
+    }
+    if (from != cmd) {
+        value = command_locked(from)->value;
+        if (_IOC_SIZE(cmd) == sizeof(short))
+            *(short *)arg = value;
+        else
+            *(int *)arg = value;
+    } else if (arg) {
+        c->value = _IOC_SIZE(cmd) == sizeof(short) ? *(short *)arg : *(int *)arg;
+    }
+    return 0;
+}
+
+int ioctl(int fd, unsigned long cmd, ...)
+{
+    va_list ap;
+    void *arg;
+    int dev, ret;
+
+    va_start(ap, cmd);
+    arg = va_arg(ap, void *);
+    va_end(ap);
+
+    dev = fake_device(fd);
+    if (dev == -2)
+        return syscall(SYS_ioctl, fd, cmd, arg);
+
+    pthread_mutex_lock(&s_lock);
+    ret = dev >= 0 ? input_ioctl(&s_inputs[dev], cmd, arg) : control_ioctl(cmd, arg);
+    pthread_mutex_unlock(&s_lock);
+    return ret;
+}
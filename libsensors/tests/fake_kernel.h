@@ -0,0 +1,72 @@
+/*
+ * Copyright (C) 2011 The CyanogenMod Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef _FAKE_KERNEL_H_
+#define _FAKE_KERNEL_H_
+
+#include <stdint.h>
+
+#include <linux/input.h>
+
+/*
+ * Stand-in for the sensor drivers of the kernel, for running the HAL on a
+ * host. The device nodes are created under a temporary $SENSORS_ROOT:
+ * input devices are FIFOs that the test writes input_events to, control
+ * devices are plain files. ioctl() is defined here and answers the
+ * requests the HAL makes on them, counting each command, anything else
+ * goes to the real ioctl.
+ *
+ * Control commands are remembered by number: a GET_* returns what the
+ * matching SET_* or ENABLE last stored.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+int fake_kernel_init(void);
+void fake_kernel_exit(void);
+const char *fake_kernel_root(void);
+
+/* a /dev/input/eventN node answering EVIOCGNAME with name */
+int fake_input_add(const char *name);
+/* what EVIOCGABS(code) returns */
+void fake_input_set_abs(int dev, int code, int value);
+/* writes EV_ABS codes[i]=values[i] and an EV_SYN stamped time (CLOCK_MONOTONIC
+ * ns, the HAL gets EVIOCSCLOCKID) as one frame */
+int fake_input_frame(int dev, const int *codes, const int *values, int n,
+        int64_t time);
+
+/* a control device at path (e.g. /dev/cm3602) under the root */
+int fake_control_add(const char *path);
+/* how many fds of this process have it open */
+int fake_control_opened(const char *path);
+
+unsigned fake_ioctl_calls(unsigned long cmd);
+int fake_ioctl_value(unsigned long cmd);
+void fake_ioctl_set(unsigned long cmd, int value);
+/* the next times calls of cmd fail with -1/err */
+void fake_ioctl_fail(unsigned long cmd, int err, int times);
+void fake_ioctl_reset(void);
+
+int64_t fake_now(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
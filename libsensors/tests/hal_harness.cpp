@@ -0,0 +1,185 @@
+/*
+ * Copyright (C) 2011 The CyanogenMod Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <stdio.h>
+#include <string.h>
+#include <signal.h>
+#include <time.h>
+
+#include <linux/akm8973.h>
+
+#include "hal_harness.h"
+
+/*****************************************************************************/
+
+static hw_module_t sModule;
+
+int harness_open(hal_harness_t* h)
+{
+    memset(h, 0, sizeof(*h));
+    pthread_mutex_init(&h->lock, NULL);
+    h->pollCount = 16;
+    for (int i=0 ; i<NUM_SENSOR_HANDLES ; i++)
+        h->delay[i] = 200000000;
+
+    if (fake_kernel_init() < 0)
+        return -1;
+    h->light = fake_input_add("lightsensor-level");
+    h->proximity = fake_input_add("proximity");
+    h->compass = fake_input_add("compass");
+    if (h->light < 0 || h->proximity < 0 || h->compass < 0 ||
+            fake_control_add(LS_DEVICE_NAME) < 0 ||
+            fake_control_add(CM_DEVICE_NAME) < 0 ||
+            fake_control_add(AKM_DEVICE_NAME) < 0) {
+        fake_kernel_exit();
+        return -1;
+    }
+
+    hw_device_t* device;
+    if (init_nusensors(&sModule, &device)) {
+        fake_kernel_exit();
+        return -1;
+    }
+    h->dev = (sensors_poll_device_t*)device;
+    return 0;
+}
+
+void harness_close(hal_harness_t* h)
+{
+    if (h->dev) {
+        harness_stop_polling(h);
+        h->dev->common.close(&h->dev->common);
+        h->dev = NULL;
+    }
+    fake_kernel_exit();
+    pthread_mutex_destroy(&h->lock);
+}
+
+static void* pollLoop(void* arg)
+{
+    hal_harness_t* h = static_cast<hal_harness_t*>(arg);
+    sensors_event_t buf[16];
+
+    while (!h->quit) {
+        int n = h->dev->poll(h->dev, buf, h->pollCount);
+        if (n < 0) {
+            if (!h->quit)
+                fprintf(stderr, "poll failed (%s)\n", strerror(-n));
+            break;
+        }
+        const int64_t now = fake_now();
+        pthread_mutex_lock(&h->lock);
+        h->polls++;
+        for (int i=0 ; i<n ; i++) {
+            sensors_event_t const& e(buf[i]);
+            if (uint32_t(e.sensor) >= uint32_t(NUM_SENSOR_HANDLES))
+                continue;
+            hal_handle_stats_t& s(h->stats[e.sensor]);
+            if (!s.events)
+                s.firstTimestamp = e.timestamp;
+            else if (e.timestamp < s.lastTimestamp)
+                s.backwards++;
+            s.events++;
+            s.lastTimestamp = e.timestamp;
+            const int64_t latency = now - e.timestamp;
+            s.latencyTotalNs += latency;
+            if (latency > s.latencyMaxNs)
+                s.latencyMaxNs = latency;
+            if (h->onEvent)
+                h->onEvent(h->cookie, &e, now);
+        }
+        pthread_mutex_unlock(&h->lock);
+    }
+    h->stopped = true;
+    return NULL;
+}
+
+static void onStopSignal(int)
+{
+}
+
+int harness_start_polling(hal_harness_t* h)
+{
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = onStopSignal;  // no SA_RESTART, poll() returns EINTR
+    sigaction(SIGUSR1, &sa, NULL);
+
+    h->quit = false;
+    h->stopped = false;
+    return pthread_create(&h->poller, NULL, pollLoop, h) ? -1 : 0;
+}
+
+void harness_stop_polling(hal_harness_t* h)
+{
+    if (h->quit || !h->poller)
+        return;
+    h->quit = true;
+    // like the framework's, our poll() only returns with events or on
+    // an error; the signal makes it fail with EINTR. Repeated in case it
+    // came before the thread got into poll()
+    while (!h->stopped) {
+        pthread_kill(h->poller, SIGUSR1);
+        harness_sleep_ms(10);
+    }
+    pthread_join(h->poller, NULL);
+    h->poller = 0;
+}
+
+int harness_activate(hal_harness_t* h, int handle, int enabled)
+{
+    return h->dev->activate(h->dev, handle, enabled);
+}
+
+int harness_set_delay(hal_harness_t* h, int handle, int64_t ns)
+{
+    h->delay[handle] = ns;
+    return h->dev->setDelay(h->dev, handle, ns);
+}
+
+void harness_stats(hal_harness_t* h, int handle, hal_handle_stats_t* stats)
+{
+    pthread_mutex_lock(&h->lock);
+    *stats = h->stats[handle];
+    pthread_mutex_unlock(&h->lock);
+}
+
+void harness_clear_stats(hal_harness_t* h)
+{
+    pthread_mutex_lock(&h->lock);
+    memset(h->stats, 0, sizeof(h->stats));
+    h->polls = 0;
+    pthread_mutex_unlock(&h->lock);
+}
+
+int harness_akm_frame(hal_harness_t* h, int ax, int ay, int az,
+        int mx, int my, int mz, int64_t time)
+{
+    const int codes[] = {
+            EVENT_TYPE_ACCEL_X, EVENT_TYPE_ACCEL_Y, EVENT_TYPE_ACCEL_Z,
+            EVENT_TYPE_MAGV_X, EVENT_TYPE_MAGV_Y, EVENT_TYPE_MAGV_Z };
+    const int values[] = { ax, ay, az, mx, my, mz };
+    return fake_input_frame(h->compass, codes, values, 6, time);
+}
+
+void harness_sleep_ms(int ms)
+{
+    struct timespec ts;
+    ts.tv_sec = ms / 1000;
+    ts.tv_nsec = (ms % 1000) * 1000000L;
+    nanosleep(&ts, NULL);
+}
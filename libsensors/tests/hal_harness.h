@@ -0,0 +1,87 @@
+/*
+ * Copyright (C) 2011 The CyanogenMod Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef ANDROID_HAL_HARNESS_H
+#define ANDROID_HAL_HARNESS_H
+
+#include <stdint.h>
+#include <pthread.h>
+
+#include "nusensors.h"
+#include "fake_kernel.h"
+
+/*****************************************************************************/
+
+/*
+ * Opens the sensors HAL on a host over the fake kernel, with the three input
+ * devices and control devices of the Leo, and polls it from its own thread
+ * the way the framework does. What comes out is counted per handle.
+ */
+
+struct hal_handle_stats_t {
+    uint32_t events;
+    uint32_t backwards;         // timestamp older than the previous one
+    int64_t firstTimestamp;
+    int64_t lastTimestamp;
+    int64_t latencyTotalNs;     // receipt time - timestamp
+    int64_t latencyMaxNs;
+};
+
+struct hal_harness_t {
+    sensors_poll_device_t* dev;
+    int light;                  // fake input devices
+    int proximity;
+    int compass;
+
+    pthread_t poller;
+    volatile bool quit;
+    volatile bool stopped;
+    int pollCount;              // events asked for per poll(), 16 by default
+    uint32_t polls;             // poll() calls that returned
+    int64_t delay[NUM_SENSOR_HANDLES];
+
+    // called on the poll thread for every event, with lock held
+    void (*onEvent)(void* cookie, sensors_event_t const* e, int64_t now);
+    void* cookie;
+
+    pthread_mutex_t lock;
+    hal_handle_stats_t stats[NUM_SENSOR_HANDLES];
+};
+
+int harness_open(hal_harness_t* h);
+void harness_close(hal_harness_t* h);
+
+int harness_start_polling(hal_harness_t* h);
+void harness_stop_polling(hal_harness_t* h);
+
+int harness_activate(hal_harness_t* h, int handle, int enabled);
+int harness_set_delay(hal_harness_t* h, int handle, int64_t ns);
+
+// a copy of the counters of handle, and clearing them
+void harness_stats(hal_harness_t* h, int handle, hal_handle_stats_t* stats);
+void harness_clear_stats(hal_harness_t* h);
+
+// one frame of the compass input device: accelerometer in raw LSG
+// (720 per g) and magnetic field in 1/16 uT
+int harness_akm_frame(hal_harness_t* h, int ax, int ay, int az,
+        int mx, int my, int mz, int64_t time);
+
+void harness_sleep_ms(int ms);
+
+/*****************************************************************************/
+
+#endif  // ANDROID_HAL_HARNESS_H
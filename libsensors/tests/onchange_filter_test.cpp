@@ -0,0 +1,157 @@
+/*
+ * Copyright (C) 2011 The CyanogenMod Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/*
+ * Replays proximity and light traces through OnChangeFilter, configured the
+ * way ProximitySensor and LightSensor configure it, and checks when each
+ * reading is reported.
+ *
+ *   onchange_filter_test [proximity trace]
+ *
+ * A trace file has one "<ms> <index>" reading per line, as logged from the
+ * evdev node. Every change in it must be reported when it arrives.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include "nusensors.h"
+#include "OnChangeFilter.h"
+
+/*****************************************************************************/
+
+#define MS  1000000LL
+
+enum { READ, POLL, SET_DELAY };
+
+struct step {
+    int op;
+    int64_t ms;
+    int value;
+    int expect;     // READ: 1 if reported, POLL: the value let out or -1
+};
+
+// near/far flipping faster than any delay the framework asks for
+static const step sProximityTrace[] = {
+    { SET_DELAY,   0, 200,  0 },
+    { READ,        0,   1,  1 },
+    { READ,       10,   0,  1 },
+    { READ,       20,   0,  0 },
+    { READ,       25,   1,  1 },
+    { POLL,       26,   0, -1 },
+    { READ,       40,   0,  1 },
+    { READ,       41,   1,  1 },
+    { READ,       41,   1,  0 },
+    { POLL,      500,   0, -1 },
+};
+
+// a one bucket step is held back for LIGHT_DEBOUNCE_NS, bigger ones only
+// by the delay the framework asked for
+static const step sLightTrace[] = {
+    { SET_DELAY,   0, 200,  0 },
+    { READ,        0,   5,  1 },
+    { READ,      100,   6,  0 },
+    { POLL,      499,   0, -1 },
+    { POLL,      600,   0,  6 },
+    { READ,      700,   9,  0 },
+    { POLL,      799,   0, -1 },
+    { POLL,      800,   0,  9 },
+    { READ,     1200,  10,  0 },
+    { READ,     1300,   9,  0 },    // jitter back, nothing to report
+    { POLL,     2000,   0, -1 },
+};
+
+static int replay(const char* name, OnChangeFilter& filter, bool rateLimited,
+        const step* trace, int n)
+{
+    int failures = 0;
+    for (int i = 0; i < n; i++) {
+        const step& s = trace[i];
+        int64_t now = s.ms * MS;
+        int got;
+        switch (s.op) {
+        case SET_DELAY:
+            if (rateLimited)
+                filter.setMinInterval(s.value * MS);
+            continue;
+        case READ:
+            got = filter.filter(s.value, now) ? 1 : 0;
+            break;
+        default:
+            if (!filter.takeDeferred(now, &got))
+                got = -1;
+            break;
+        }
+        if (got != s.expect) {
+            printf("FAIL: %s step %d at %lld ms: got %d, want %d\n",
+                    name, i, (long long)s.ms, got, s.expect);
+            failures++;
+        }
+    }
+    printf("%s: %u readings, %u suppressed\n", name,
+            filter.getReceived(), filter.getSuppressed());
+    return failures;
+}
+
+static int replayFile(const char* path)
+{
+    FILE* f = fopen(path, "r");
+    if (!f) {
+        printf("FAIL: can't open %s\n", path);
+        return 1;
+    }
+
+    OnChangeFilter filter(PROXIMITY_JITTER_STEPS, PROXIMITY_DEBOUNCE_NS);
+    long long ms;
+    int value, last = -1, changes = 0, failures = 0, line = 0;
+    while (fscanf(f, "%lld %d", &ms, &value) == 2) {
+        line++;
+        bool reported = filter.filter(value, ms * MS);
+        if (reported != (value != last)) {
+            printf("FAIL: %s:%d: %d at %lld ms %s\n", path, line, value, ms,
+                    reported ? "reported twice" : "not reported");
+            failures++;
+        }
+        if (value != last)
+            changes++;
+        last = value;
+    }
+    fclose(f);
+    printf("%s: %d readings, %d changes, %u suppressed\n", path, line,
+            changes, filter.getSuppressed());
+    return failures;
+}
+
+int main(int argc, char** argv)
+{
+    int failures = 0;
+
+    // ProximitySensor::setDelay() leaves its filter alone
+    OnChangeFilter proximity(PROXIMITY_JITTER_STEPS, PROXIMITY_DEBOUNCE_NS);
+    failures += replay("proximity", proximity, false, sProximityTrace,
+            sizeof(sProximityTrace) / sizeof(sProximityTrace[0]));
+
+    OnChangeFilter light(LIGHT_JITTER_STEPS, LIGHT_DEBOUNCE_NS);
+    failures += replay("light", light, true, sLightTrace,
+            sizeof(sLightTrace) / sizeof(sLightTrace[0]));
+
+    for (int i = 1; i < argc; i++)
+        failures += replayFile(argv[i]);
+
+    printf("%s\n", failures ? "FAILED" : "PASSED");
+    return failures ? 1 : 0;
+}
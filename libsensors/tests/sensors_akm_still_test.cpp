@@ -0,0 +1,304 @@
+/*
+ * Copyright (C) 2011 The CyanogenMod Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/*
+ * Replays an accelerometer trace through the compass driver with a fake
+ * chip that samples at whatever rate the HAL last set, so that the chip
+ * really slows down to AKM_STILL_DELAY_NS while the device lies still.
+ * Measures how much later than with a chip at full rate the framework
+ * sees motion resume, and checks that the repeats made up while still are
+ * delivered in order with the real readings, which keep their own dates.
+ * The trace is played twice: once to a framework that reads every event
+ * right away, for the latencies, and once to one that stalls every few
+ * events, so that readings wait in the input device while repeats fall due.
+ *
+ *   sensors_akm_still_test [trace]
+ *
+ * A trace file has one "<ms> <ax> <ay> <az>" line per change, in raw LSG
+ * (720 per g). Without one, the device lies still for 3 s then moves for
+ * 1 s, twice.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <linux/akm8973.h>
+
+#include "hal_harness.h"
+
+/*****************************************************************************/
+
+#define MS              1000000LL
+#define MAX_STEPS       1024
+#define MAX_FRAMES      4096
+// not a divisor of AKM_STILL_DELAY_NS, so repeats fall between readings
+#define FAST_DELAY_NS   (30*MS)
+#define STALL_EVERY     8
+#define STALL_MS        60
+
+static int sFailures;
+
+#define CHECK(cond, ...) do { \
+        if (!(cond)) { \
+            printf("FAIL: " __VA_ARGS__); \
+            printf("\n"); \
+            sFailures++; \
+        } \
+    } while (0)
+
+struct trace_step {
+    int64_t ms;
+    int a[3];
+};
+
+struct trace_t {
+    trace_step steps[MAX_STEPS];
+    int numSteps;
+    int64_t motion[MAX_STEPS];  // times motion resumed, relative to start
+    int numMotions;
+};
+
+// the real readings written, and what the framework made of them
+struct replay_t {
+    trace_t const* trace;
+    int stallEvery;             // 0 for a framework that never stalls
+
+    int64_t start;
+    // the chip mustn't wait for a stalled framework
+    pthread_mutex_t framesLock;
+    int64_t frames[MAX_FRAMES];
+    int numFrames;
+    int64_t seen[MAX_STEPS];    // when the framework got each motion
+    int misdated;               // readings not dated when they were taken
+    int duplicates;             // events dated like the previous one
+    int64_t lastAccel;
+    int64_t delivered[MAX_FRAMES * 4];
+    int accel;
+};
+
+static const trace_step* stepAt(trace_t const* trace, int64_t ms)
+{
+    const trace_step* s = &trace->steps[0];
+    for (int i=1 ; i<trace->numSteps && trace->steps[i].ms <= ms ; i++)
+        s = &trace->steps[i];
+    return s;
+}
+
+// evdev dates readings to the microsecond; times are in increasing order
+static bool contains(int64_t const* times, int n, int64_t t)
+{
+    for (int i=n-1 ; i>=0 && times[i]/1000 >= t/1000 ; i--) {
+        if (times[i]/1000 == t/1000)
+            return true;
+    }
+    return false;
+}
+
+static void onEvent(void* cookie, sensors_event_t const* e, int64_t now)
+{
+    replay_t* r = static_cast<replay_t*>(cookie);
+    if (e->sensor != ID_A)
+        return;
+    if (r->accel && e->timestamp == r->lastAccel)
+        r->duplicates++;
+    if (r->accel < MAX_FRAMES * 4)
+        r->delivered[r->accel] = e->timestamp;
+    r->accel++;
+    r->lastAccel = e->timestamp;
+    if (r->stallEvery && !(r->accel % r->stallEvery))
+        harness_sleep_ms(STALL_MS);
+    // a reading of the moving device can't be a repeat
+    if (e->acceleration.x || e->acceleration.y) {
+        pthread_mutex_lock(&r->framesLock);
+        if (!contains(r->frames, r->numFrames, e->timestamp))
+            r->misdated++;
+        pthread_mutex_unlock(&r->framesLock);
+        for (int i=0 ; i<r->trace->numMotions ; i++) {
+            if (r->start + r->trace->motion[i] <= e->timestamp && !r->seen[i])
+                r->seen[i] = now;
+        }
+    }
+}
+
+static void defaultTrace(trace_t* r)
+{
+    int n = 0;
+    for (int cycle=0 ; cycle<2 ; cycle++) {
+        const int64_t base = cycle * 4000;
+        r->steps[n].ms = base;
+        r->steps[n].a[0] = r->steps[n].a[1] = 0;
+        r->steps[n].a[2] = 720;
+        n++;
+        // shaking, a quarter g either way every 50 ms, starting out of
+        // phase with the slowed down chip
+        for (int64_t ms = 3030 + cycle*110 ; ms < 4000 ; ms += 50) {
+            r->steps[n].ms = base + ms;
+            r->steps[n].a[0] = (ms / 50) & 1 ? 180 : -180;
+            r->steps[n].a[1] = 60;
+            r->steps[n].a[2] = 720;
+            n++;
+        }
+    }
+    r->steps[n].ms = 8000;
+    r->steps[n].a[0] = r->steps[n].a[1] = 0;
+    r->steps[n].a[2] = 720;
+    r->numSteps = n + 1;
+}
+
+static int loadTrace(trace_t* r, const char* path)
+{
+    FILE* f = fopen(path, "r");
+    if (!f) {
+        perror(path);
+        return -1;
+    }
+    long long ms;
+    int a[3];
+    r->numSteps = 0;
+    while (r->numSteps < MAX_STEPS &&
+            fscanf(f, "%lld %d %d %d", &ms, &a[0], &a[1], &a[2]) == 4) {
+        trace_step& s(r->steps[r->numSteps++]);
+        s.ms = ms;
+        s.a[0] = a[0];
+        s.a[1] = a[1];
+        s.a[2] = a[2];
+    }
+    fclose(f);
+    return r->numSteps ? 0 : -1;
+}
+
+// motion resumes where a moving step follows a still one
+static void findMotions(trace_t* r)
+{
+    r->numMotions = 0;
+    for (int i=1 ; i<r->numSteps ; i++) {
+        const trace_step& prev(r->steps[i-1]);
+        const trace_step& s(r->steps[i]);
+        if ((s.a[0] || s.a[1]) && !prev.a[0] && !prev.a[1])
+            r->motion[r->numMotions++] = s.ms * MS;
+    }
+}
+
+static void replay(trace_t const* trace, int stallEvery)
+{
+    static replay_t r;
+    memset(&r, 0, sizeof(r));
+    r.trace = trace;
+    r.stallEvery = stallEvery;
+    pthread_mutex_init(&r.framesLock, NULL);
+
+    hal_harness_t h;
+    if (harness_open(&h) < 0) {
+        sFailures++;
+        return;
+    }
+    h.onEvent = onEvent;
+    h.cookie = &r;
+    h.pollCount = 1;
+    harness_set_delay(&h, ID_A, FAST_DELAY_NS);
+    harness_activate(&h, ID_A, 1);
+    harness_start_polling(&h);
+    harness_sleep_ms(50);
+
+    // the fake chip samples the trace at the rate it is set to, a new
+    // delay applies from the last reading
+    const int64_t end = trace->steps[trace->numSteps-1].ms * MS;
+    int64_t slowest = 0;
+    r.start = fake_now();
+    for (int64_t t = r.start ; t - r.start <= end && r.numFrames < MAX_FRAMES ; ) {
+        const trace_step* s = stepAt(trace, (t - r.start) / MS);
+        pthread_mutex_lock(&r.framesLock);
+        r.frames[r.numFrames++] = t;
+        pthread_mutex_unlock(&r.framesLock);
+        harness_akm_frame(&h, s->a[0], s->a[1], s->a[2], 100, 200, 300, t);
+        int64_t delay;
+        do {
+            harness_sleep_ms(1);
+            delay = fake_ioctl_value(ECS_IOCTL_APP_SET_DELAY) * MS;
+            if (delay <= 0)
+                delay = FAST_DELAY_NS;
+        } while (fake_now() < t + delay);
+        if (delay > slowest)
+            slowest = delay;
+        t += delay;
+    }
+    harness_sleep_ms(100 + STALL_MS);
+    harness_stop_polling(&h);
+    harness_close(&h);
+    pthread_mutex_destroy(&r.framesLock);
+
+    hal_handle_stats_t st;
+    st = h.stats[ID_A];
+    const int64_t duration = r.lastAccel - r.start;
+    printf("%s framework: %d chip readings, %u accelerometer events in %lld ms, "
+            "slowest chip period %lld ms\n", stallEvery ? "stalling" : "prompt",
+            r.numFrames, st.events, (long long)(duration / MS),
+            (long long)(slowest / MS));
+    CHECK(slowest == AKM_STILL_DELAY_NS, "the chip was never slowed down");
+    CHECK(st.backwards == 0, "%u events went back in time", st.backwards);
+    // and every reading must be delivered with the date it was taken
+    for (int i=0 ; i<r.numFrames ; i++) {
+        if (!contains(r.delivered, r.accel < MAX_FRAMES*4 ? r.accel : MAX_FRAMES*4,
+                r.frames[i]))
+            r.misdated++;
+    }
+    CHECK(r.misdated == 0, "%d real readings delivered with a made up date",
+            r.misdated);
+    CHECK(r.duplicates == 0, "%d events dated like the previous one", r.duplicates);
+    // the repeats keep the requested rate while the chip is slow
+    const int64_t want = duration / FAST_DELAY_NS;
+    CHECK(st.events * 10 >= want * 9, "%u events, want about %lld", st.events,
+            (long long)want);
+
+    if (stallEvery || !trace->numMotions)
+        return;
+    int64_t total = 0, worst = 0;
+    for (int i=0 ; i<trace->numMotions ; i++) {
+        CHECK(r.seen[i], "motion at %lld ms never seen",
+                (long long)(trace->motion[i] / MS));
+        if (!r.seen[i])
+            continue;
+        const int64_t latency = r.seen[i] - (r.start + trace->motion[i]);
+        printf("motion at %lld ms seen after %lld ms\n",
+                (long long)(trace->motion[i] / MS), (long long)(latency / MS));
+        total += latency;
+        if (latency > worst)
+            worst = latency;
+    }
+    // a chip at full rate shows it within one period
+    printf("motion seen after %lld ms on average, %lld ms at worst, "
+            "%lld ms at worst with the chip at full rate\n",
+            (long long)(total / trace->numMotions / MS), (long long)(worst / MS),
+            (long long)(FAST_DELAY_NS / MS));
+    CHECK(worst <= AKM_STILL_DELAY_NS + 50*MS, "motion seen %lld ms late",
+            (long long)(worst / MS));
+}
+
+int main(int argc, char** argv)
+{
+    static trace_t trace;
+    if (argc > 1 ? loadTrace(&trace, argv[1]) : (defaultTrace(&trace), 0))
+        return 2;
+    findMotions(&trace);
+
+    replay(&trace, 0);
+    replay(&trace, STALL_EVERY);
+
+    printf("%s\n", sFailures ? "FAILED" : "PASSED");
+    return sFailures ? 1 : 0;
+}
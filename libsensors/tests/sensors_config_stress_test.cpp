@@ -0,0 +1,222 @@
+/*
+ * Copyright (C) 2011 The CyanogenMod Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/*
+ * Binder threads toggling handles on and off as fast as they can while the
+ * poll thread streams, with the fake control devices refusing some of the
+ * enables and disables. Once the togglers stop and the last state is set,
+ * every driver must end up in it, including those that refused it at first.
+ *
+ *   sensors_config_stress_test [seconds]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+
+#include <linux/akm8973.h>
+#include <linux/capella_cm3602.h>
+#include <linux/lightsensor.h>
+
+#include "SensorTable.h"
+#include "hal_harness.h"
+
+/*****************************************************************************/
+
+#define NUM_TOGGLERS    3
+
+static int sFailures;
+
+#define CHECK(cond, ...) do { \
+        if (!(cond)) { \
+            printf("FAIL: " __VA_ARGS__); \
+            printf("\n"); \
+            sFailures++; \
+        } \
+    } while (0)
+
+// the control ioctl that enables each handle's hardware
+static const unsigned long sEnableCmd[NUM_SENSOR_HANDLES] = {
+    ECS_IOCTL_APP_SET_AFLAG,        // A
+    ECS_IOCTL_APP_SET_MVFLAG,       // M
+    ECS_IOCTL_APP_SET_MFLAG,        // O
+    CAPELLA_CM3602_IOCTL_ENABLE,    // P
+    LIGHTSENSOR_IOCTL_ENABLE,       // L
+    ECS_IOCTL_APP_SET_AFLAG,        // SD
+    ECS_IOCTL_APP_SET_AFLAG,        // SC
+};
+
+struct stress_t {
+    hal_harness_t* h;
+    volatile bool quit;
+    uint32_t calls[NUM_TOGGLERS];
+};
+
+struct toggler_t {
+    stress_t* s;
+    int index;
+};
+
+static void* toggleLoop(void* arg)
+{
+    toggler_t* t = static_cast<toggler_t*>(arg);
+    stress_t* s = t->s;
+    unsigned seed = t->index;
+    while (!s->quit) {
+        const int handle = rand_r(&seed) % NUM_SENSOR_HANDLES;
+        const int r = rand_r(&seed);
+        if (r & 8)
+            s->h->dev->setDelay(s->h->dev, handle, (r % 20 + 1) * 10000000LL);
+        else
+            harness_activate(s->h, handle, r & 1);
+        s->calls[t->index]++;
+    }
+    return NULL;
+}
+
+// refuses one of the enable ioctls every millisecond or so
+static void* failLoop(void* arg)
+{
+    stress_t* s = static_cast<stress_t*>(arg);
+    unsigned seed = 42;
+    while (!s->quit) {
+        fake_ioctl_fail(sEnableCmd[rand_r(&seed) % NUM_SENSOR_HANDLES], EIO, 1);
+        harness_sleep_ms(1);
+    }
+    return NULL;
+}
+
+static void* streamLoop(void* arg)
+{
+    stress_t* s = static_cast<stress_t*>(arg);
+    int swing = 0;
+    while (!s->quit) {
+        swing = 100 - swing;
+        harness_akm_frame(s->h, swing, 0, 720, 100, 200, 300, fake_now());
+        harness_sleep_ms(10);
+    }
+    return NULL;
+}
+
+static void setAll(hal_harness_t* h, const int* enabled)
+{
+    for (int i=0 ; i<NUM_SENSOR_HANDLES ; i++) {
+        harness_activate(h, i, enabled[i]);
+        harness_set_delay(h, i, 20000000LL);
+    }
+}
+
+static void checkApplied(const char* when, const int* enabled)
+{
+    // every compass sensor keeps the accelerometer running
+    int wanted[NUM_SENSOR_HANDLES];
+    for (int i=0 ; i<NUM_SENSOR_HANDLES ; i++) {
+        wanted[i] = 0;
+        for (int j=0 ; j<NUM_SENSOR_HANDLES ; j++) {
+            if (!enabled[j])
+                continue;
+            if (sEnableCmd[j] == sEnableCmd[i] ||
+                    (sEnableCmd[i] == ECS_IOCTL_APP_SET_AFLAG &&
+                     handleToDriver(j) == DRIVER_AKM))
+                wanted[i] = 1;
+        }
+    }
+    for (int i=0 ; i<NUM_SENSOR_HANDLES ; i++) {
+        const int value = fake_ioctl_value(sEnableCmd[i]);
+        CHECK(value == wanted[i], "%s: handle %d hardware %s", when, i,
+                value ? "enabled" : "disabled");
+    }
+}
+
+int main(int argc, char** argv)
+{
+    const int seconds = argc > 1 ? atoi(argv[1]) : 2;
+
+    hal_harness_t h;
+    if (harness_open(&h) < 0)
+        return 2;
+    harness_start_polling(&h);
+
+    stress_t s;
+    s.h = &h;
+    s.quit = false;
+    toggler_t togglers[NUM_TOGGLERS];
+    pthread_t threads[NUM_TOGGLERS + 2];
+    for (int i=0 ; i<NUM_TOGGLERS ; i++) {
+        s.calls[i] = 0;
+        togglers[i].s = &s;
+        togglers[i].index = i;
+        pthread_create(&threads[i], NULL, toggleLoop, &togglers[i]);
+    }
+    pthread_create(&threads[NUM_TOGGLERS], NULL, failLoop, &s);
+    pthread_create(&threads[NUM_TOGGLERS + 1], NULL, streamLoop, &s);
+
+    harness_sleep_ms((seconds > 0 ? seconds : 1) * 1000);
+    s.quit = true;
+    uint32_t calls = 0;
+    for (int i=0 ; i<NUM_TOGGLERS + 2 ; i++) {
+        pthread_join(threads[i], NULL);
+        if (i < NUM_TOGGLERS)
+            calls += s.calls[i];
+    }
+    fake_ioctl_reset();
+    printf("%u activate/setDelay calls from %d threads in %d s, %u polls\n",
+            calls, NUM_TOGGLERS, seconds, h.polls);
+
+    // whatever the stress left behind is overridden by the last calls
+    static const int first[NUM_SENSOR_HANDLES] = { 0, 1, 0, 1, 0, 0, 0 };
+    setAll(&h, first);
+    harness_sleep_ms(CONFIG_RETRY_NS / 1000000 * 2 + 100);
+    checkApplied("after the stress", first);
+
+    // the light and the orientation refuse to be enabled, the proximity
+    // and the magnetic field to be disabled, twice each
+    static const int last[NUM_SENSOR_HANDLES] = { 1, 0, 1, 0, 1, 0, 0 };
+    fake_ioctl_fail(LIGHTSENSOR_IOCTL_ENABLE, EIO, 2);
+    fake_ioctl_fail(CAPELLA_CM3602_IOCTL_ENABLE, EIO, 2);
+    fake_ioctl_fail(ECS_IOCTL_APP_SET_MFLAG, EIO, 2);
+    fake_ioctl_fail(ECS_IOCTL_APP_SET_MVFLAG, EIO, 2);
+    harness_clear_stats(&h);
+    setAll(&h, last);
+    harness_sleep_ms(CONFIG_RETRY_NS / 1000000 * 3 + 100);
+    checkApplied("after refusals", last);
+
+    const int lightCode = EVENT_TYPE_LIGHT;
+    const int lightValue = 5;
+    fake_input_frame(h.light, &lightCode, &lightValue, 1, fake_now());
+    static const int compassCodes[] = {
+            EVENT_TYPE_ACCEL_X, EVENT_TYPE_ACCEL_Y, EVENT_TYPE_ACCEL_Z,
+            EVENT_TYPE_MAGV_X, EVENT_TYPE_MAGV_Y, EVENT_TYPE_MAGV_Z,
+            EVENT_TYPE_YAW, EVENT_TYPE_PITCH, EVENT_TYPE_ROLL };
+    for (int i=0 ; i<10 ; i++) {
+        const int values[] = { i & 1 ? 100 : 0, 0, 720, 100, 200, 300, 90, 0, 0 };
+        fake_input_frame(h.compass, compassCodes, values, 9, fake_now());
+        harness_sleep_ms(20);
+    }
+    harness_sleep_ms(50);
+    for (int i=0 ; i<NUM_SENSOR_HANDLES ; i++) {
+        hal_handle_stats_t st;
+        harness_stats(&h, i, &st);
+        CHECK(last[i] ? st.events > 0 : st.events == 0,
+                "handle %d %s but delivered %u events", i,
+                last[i] ? "enabled" : "disabled", st.events);
+    }
+
+    harness_close(&h);
+    printf("%s\n", sFailures ? "FAILED" : "PASSED");
+    return sFailures ? 1 : 0;
+}
@@ -0,0 +1,182 @@
+/*
+ * Copyright (C) 2011 The CyanogenMod Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/*
+ * Enable/disable cycles of the three drivers against fake control devices,
+ * and a check that control devices are closed when their grace period is
+ * over even while another driver keeps the poll loop busy.
+ *
+ * Built twice: sensors_device_bench with a short CONTROL_CLOSE_GRACE_NS and
+ * sensors_device_bench_nograce with 0, i.e. the open+close per cycle that
+ * the drivers used to do.
+ *
+ *   sensors_device_bench [cycles]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "LightSensor.h"
+#include "ProximitySensor.h"
+#include "AkmSensor.h"
+#include "hal_harness.h"
+
+/*****************************************************************************/
+
+static int sFailures;
+
+#define CHECK(cond, ...) do { \
+        if (!(cond)) { \
+            printf("FAIL: " __VA_ARGS__); \
+            printf("\n"); \
+            sFailures++; \
+        } \
+    } while (0)
+
+static void benchDriver(const char* name, SensorBase* sensor, int handle,
+        const char* device, int cycles)
+{
+    const int64_t start = fake_now();
+    for (int i=0 ; i<cycles ; i++) {
+        sensor->enable(handle, 1);
+        sensor->enable(handle, 0);
+    }
+    const int64_t elapsed = fake_now() - start;
+    const bool open = fake_control_opened(device) > 0;
+    printf("%-10s %d cycles: %lld cycles/s, %lld ns per enable+disable, "
+            "control device %s between cycles\n", name, cycles,
+            elapsed ? (long long)(cycles * 1000000000LL / elapsed) : 0LL,
+            (long long)(elapsed / cycles), open ? "kept open" : "closed");
+    CHECK(open == (CONTROL_CLOSE_GRACE_NS > 0), "%s: control device %s", name,
+            open ? "left open" : "closed before its grace period");
+    sensor->expireDevice(fake_now() + CONTROL_CLOSE_GRACE_NS);
+    CHECK(fake_control_opened(device) == 0, "%s: control device not closed on expiry", name);
+}
+
+static void benchDrivers(int cycles)
+{
+    if (fake_kernel_init() < 0) {
+        sFailures++;
+        return;
+    }
+    fake_input_add("lightsensor-level");
+    fake_input_add("proximity");
+    fake_input_add("compass");
+    fake_control_add(LS_DEVICE_NAME);
+    fake_control_add(CM_DEVICE_NAME);
+    fake_control_add(AKM_DEVICE_NAME);
+
+    LightSensor* light = new LightSensor();
+    ProximitySensor* proximity = new ProximitySensor();
+    AkmSensor* akm = new AkmSensor();
+    benchDriver("light", light, ID_L, LS_DEVICE_NAME, cycles);
+    benchDriver("proximity", proximity, ID_P, CM_DEVICE_NAME, cycles);
+    benchDriver("akm", akm, ID_A, AKM_DEVICE_NAME, cycles);
+    delete light;
+    delete proximity;
+    delete akm;
+    fake_kernel_exit();
+}
+
+struct flood_t {
+    hal_harness_t* h;
+    volatile bool quit;
+    uint32_t frames;
+};
+
+// as fast as the HAL takes them
+static void* floodCompass(void* arg)
+{
+    flood_t* f = static_cast<flood_t*>(arg);
+    while (!f->quit) {
+        harness_akm_frame(f->h, 0, 0, 720, 100, 200, 300, fake_now());
+        f->frames++;
+    }
+    return NULL;
+}
+
+// a framework busy with each event, the HAL always has a backlog
+static void slowReader(void*, sensors_event_t const*, int64_t now)
+{
+    while (fake_now() - now < 20000)
+        ;
+}
+
+// the light sensor is disabled while the compass keeps pollEvents() from
+// ever sleeping in poll()
+static void checkExpiryUnderLoad()
+{
+    hal_harness_t h;
+    if (harness_open(&h) < 0) {
+        sFailures++;
+        return;
+    }
+    harness_activate(&h, ID_L, 1);
+    harness_activate(&h, ID_A, 1);
+    harness_set_delay(&h, ID_A, 0);
+    // a reader that takes less than there is, every poll() finds events
+    // left over from the previous one
+    h.pollCount = 1;
+    h.onEvent = slowReader;
+    harness_start_polling(&h);
+
+    flood_t flood;
+    flood.h = &h;
+    flood.quit = false;
+    flood.frames = 0;
+    pthread_t flooder;
+    pthread_create(&flooder, NULL, floodCompass, &flood);
+    harness_sleep_ms(100);
+
+    const int64_t grace = CONTROL_CLOSE_GRACE_NS;
+    harness_activate(&h, ID_L, 0);
+    const int64_t disabled = fake_now();
+    int64_t closed = -1;
+    while (closed < 0 && fake_now() - disabled < grace + 1000000000LL) {
+        if (!fake_control_opened(LS_DEVICE_NAME))
+            closed = fake_now();
+        harness_sleep_ms(2);
+    }
+
+    flood.quit = true;
+    pthread_join(flooder, NULL);
+    hal_handle_stats_t accel;
+    harness_stats(&h, ID_A, &accel);
+    harness_close(&h);
+
+    printf("light control device closed %lld ms after disable (grace %lld ms), "
+            "%u compass frames written meanwhile\n",
+            closed >= 0 ? (long long)((closed - disabled) / 1000000) : -1LL,
+            (long long)(grace / 1000000), flood.frames);
+    CHECK(accel.events > 0, "the compass didn't stream");
+    CHECK(closed < 0 || closed - disabled >= grace,
+            "light control device closed before its grace period");
+    CHECK(closed >= 0 && closed - disabled < grace + 100000000LL,
+            "light control device not closed while the compass streams");
+}
+
+int main(int argc, char** argv)
+{
+    const int cycles = argc > 1 ? atoi(argv[1]) : 10000;
+
+    benchDrivers(cycles > 0 ? cycles : 1);
+    if (CONTROL_CLOSE_GRACE_NS > 0)
+        checkExpiryUnderLoad();
+
+    printf("%s\n", sFailures ? "FAILED" : "PASSED");
+    return sFailures ? 1 : 0;
+}
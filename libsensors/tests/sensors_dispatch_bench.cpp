@@ -0,0 +1,167 @@
+/*
+ * Copyright (C) 2011 The CyanogenMod Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/*
+ * What a poll loop wakeup costs in calls to the drivers, made the way
+ * pollEvents() makes them (pollHasPendingEvents()/pollReadEvents() of
+ * SensorDriver<T>) and through the SensorBase vtable as it used to.
+ *
+ * The three enabled drivers run over fake_kernel.c with nothing to read.
+ * An idle wakeup asks each driver whether it has pending events, a
+ * POLLIN wakeup also has each one read its empty input device, so the
+ * second shows how much of a wakeup the dispatch is next to a read().
+ *
+ *   sensors_dispatch_bench [wakeups]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "LightSensor.h"
+#include "ProximitySensor.h"
+#include "AkmSensor.h"
+#include "fake_kernel.h"
+
+/*****************************************************************************/
+
+static int sFailures;
+
+#define CHECK(cond, ...) do { \
+        if (!(cond)) { \
+            printf("FAIL: " __VA_ARGS__); \
+            printf("\n"); \
+            sFailures++; \
+        } \
+    } while (0)
+
+struct drivers_t {
+    LightSensor* light;
+    ProximitySensor* proximity;
+    AkmSensor* akm;
+    // filled at run time, so that the compiler can't see through the calls
+    SensorBase* base[3];
+};
+
+template <typename T>
+static inline int staticWakeup(T* sensor, bool readable, sensors_event_t* data)
+{
+    if (!readable && !sensor->pollHasPendingEvents())
+        return 0;
+    int nb = sensor->pollReadEvents(data, 16);
+    return nb > 0 ? nb : 0;
+}
+
+static inline int virtualWakeup(SensorBase* sensor, bool readable,
+        sensors_event_t* data)
+{
+    if (!readable && !sensor->hasPendingEvents())
+        return 0;
+    int nb = sensor->readEvents(data, 16);
+    return nb > 0 ? nb : 0;
+}
+
+static __attribute__((noinline)) int runStatic(drivers_t* d, int wakeups,
+        bool readable, sensors_event_t* data)
+{
+    int events = 0;
+    for (int i=0 ; i<wakeups ; i++) {
+        events += staticWakeup(d->light, readable, data);
+        events += staticWakeup(d->proximity, readable, data);
+        events += staticWakeup(d->akm, readable, data);
+    }
+    return events;
+}
+
+static __attribute__((noinline)) int runVirtual(drivers_t* d, int wakeups,
+        bool readable, sensors_event_t* data)
+{
+    int events = 0;
+    for (int i=0 ; i<wakeups ; i++) {
+        for (int j=0 ; j<3 ; j++)
+            events += virtualWakeup(d->base[j], readable, data);
+    }
+    return events;
+}
+
+static void bench(drivers_t* d, const char* name, int wakeups, bool readable)
+{
+    sensors_event_t data[16];
+    int64_t best[2] = { -1, -1 };
+    int events = 0;
+
+    // alternated and repeated, the best run of each is reported
+    for (int round=0 ; round<5 ; round++) {
+        for (int way=0 ; way<2 ; way++) {
+            const int64_t start = fake_now();
+            events += way ? runVirtual(d, wakeups, readable, data)
+                          : runStatic(d, wakeups, readable, data);
+            const int64_t elapsed = fake_now() - start;
+            if (best[way] < 0 || elapsed < best[way])
+                best[way] = elapsed;
+        }
+    }
+
+    const double st = double(best[0]) / wakeups;
+    const double vt = double(best[1]) / wakeups;
+    printf("%-14s %9d wakeups: static %7.1f ns, virtual %7.1f ns per wakeup "
+            "(%+.1f ns, %+.1f%%)\n", name, wakeups, st, vt, vt - st,
+            st > 0 ? (vt - st) * 100 / st : 0.0);
+    CHECK(events == 0, "%s: %d events out of empty devices", name, events);
+}
+
+int main(int argc, char** argv)
+{
+    const int wakeups = argc > 1 ? atoi(argv[1]) : 2000000;
+
+    if (fake_kernel_init() < 0)
+        return 1;
+    fake_input_add("lightsensor-level");
+    fake_input_add("proximity");
+    fake_input_add("compass");
+    fake_control_add(LS_DEVICE_NAME);
+    fake_control_add(CM_DEVICE_NAME);
+    fake_control_add(AKM_DEVICE_NAME);
+
+    drivers_t d;
+    d.light = new LightSensor();
+    d.proximity = new ProximitySensor();
+    d.akm = new AkmSensor();
+    d.base[0] = d.light;
+    d.base[1] = d.proximity;
+    d.base[2] = d.akm;
+    d.light->enable(ID_L, 1);
+    d.proximity->enable(ID_P, 1);
+    d.akm->enable(ID_A, 1);
+    d.akm->setDelay(ID_A, 200000000LL);
+
+    // the reports made on enable
+    sensors_event_t data[16];
+    for (int j=0 ; j<3 ; j++)
+        while (d.base[j]->hasPendingEvents() && d.base[j]->readEvents(data, 16) > 0)
+            ;
+
+    bench(&d, "idle", wakeups > 0 ? wakeups : 1, false);
+    bench(&d, "POLLIN, empty", wakeups > 0 ? (wakeups + 19) / 20 : 1, true);
+
+    delete d.light;
+    delete d.proximity;
+    delete d.akm;
+    fake_kernel_exit();
+
+    printf("%s\n", sFailures ? "FAILED" : "PASSED");
+    return sFailures ? 1 : 0;
+}
@@ -0,0 +1,210 @@
+/*
+ * Copyright (C) 2011 The CyanogenMod Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/*
+ * InputEventCircularReader drained a span at a time with getSpan() and
+ * consume(), as the drivers do, against one event at a time with
+ * readEvent() and next(), as they used to.
+ *
+ * Bursts of 1 to 4 compass frames (six EV_ABS and an EV_SYN each) are
+ * written to a pipe and filled into a ring of the AKM driver's size, so
+ * that most bursts cross its wrap point. Both walks must see every event
+ * once and in order; only the drain, decoding included, is timed.
+ *
+ *   sensors_input_reader_bench [bursts]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+
+#include <linux/input.h>
+
+#include "InputEventReader.h"
+
+/*****************************************************************************/
+
+#define RING_EVENTS     32
+#define FRAME_EVENTS    7
+#define MAX_FRAMES      4
+
+static int sFailures;
+
+#define CHECK(cond, ...) do { \
+        if (!(cond)) { \
+            printf("FAIL: " __VA_ARGS__); \
+            printf("\n"); \
+            sFailures++; \
+        } \
+    } while (0)
+
+static int64_t now()
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return int64_t(t.tv_sec)*1000000000LL + t.tv_nsec;
+}
+
+// what a driver does with the events, roughly: values by code, a report
+// per EV_SYN. Each EV_ABS value is its sequence number in the stream.
+struct decoder_t {
+    int raw[8];
+    int last;
+    int misordered;
+    uint32_t frames;
+    uint32_t sum;
+
+    void reset() {
+        memset(this, 0, sizeof(*this));
+        last = -1;
+    }
+    inline void decode(input_event const* event) {
+        if (event->type == EV_ABS) {
+            raw[event->code & 7] = event->value;
+            if (event->value != last + 1)
+                misordered++;
+            last = event->value;
+        } else if (event->type == EV_SYN) {
+            frames++;
+            sum += raw[0] + raw[1] + raw[2] + raw[3] + raw[4] + raw[5];
+        }
+    }
+};
+
+static __attribute__((noinline)) void drainEvents(
+        InputEventCircularReader* reader, decoder_t* d)
+{
+    input_event const* event;
+    while (reader->readEvent(&event)) {
+        d->decode(event);
+        reader->next();
+    }
+}
+
+static __attribute__((noinline)) void drainSpans(
+        InputEventCircularReader* reader, decoder_t* d)
+{
+    input_event const* events;
+    ssize_t avail;
+    while ((avail = reader->getSpan(&events))) {
+        for (ssize_t i=0 ; i<avail ; i++)
+            d->decode(&events[i]);
+        reader->consume(avail);
+    }
+}
+
+static int writeBurst(int fd, int frames, int* seq)
+{
+    input_event burst[MAX_FRAMES * FRAME_EVENTS];
+    input_event* e = burst;
+    memset(burst, 0, sizeof(burst));
+    for (int f=0 ; f<frames ; f++) {
+        for (int i=0 ; i<FRAME_EVENTS-1 ; i++, e++) {
+            e->type = EV_ABS;
+            e->code = i;
+            e->value = (*seq)++;
+        }
+        e->type = EV_SYN;
+        e++;
+    }
+    const size_t size = (e - burst) * sizeof(input_event);
+    return write(fd, burst, size) == ssize_t(size) ? 0 : -1;
+}
+
+// returns the drain time per event in ns
+static double run(const char* name, bool spans, int bursts, int64_t overhead,
+        uint32_t* sum)
+{
+    int fds[2];
+    if (pipe(fds) < 0) {
+        sFailures++;
+        return 0;
+    }
+
+    InputEventCircularReader reader(RING_EVENTS);
+    decoder_t d;
+    d.reset();
+    int seq = 0;
+    int64_t drained = 0;
+    uint32_t events = 0;
+
+    for (int b=0 ; b<bursts ; b++) {
+        const int frames = 1 + (b % MAX_FRAMES);
+        if (writeBurst(fds[1], frames, &seq) < 0 || reader.fill(fds[0]) < 0) {
+            CHECK(false, "%s: burst %d not written or read", name, b);
+            break;
+        }
+        const int64_t start = now();
+        if (spans)
+            drainSpans(&reader, &d);
+        else
+            drainEvents(&reader, &d);
+        drained += now() - start - overhead;
+        events += frames * FRAME_EVENTS;
+    }
+
+    close(fds[0]);
+    close(fds[1]);
+
+    CHECK(d.misordered == 0, "%s: %d events out of order", name, d.misordered);
+    CHECK(d.last == seq - 1, "%s: last event %d of %d", name, d.last, seq - 1);
+    CHECK(reader.getEventsRead() == events, "%s: %u events read of %u", name,
+            reader.getEventsRead(), events);
+    *sum = d.sum;
+    return events ? double(drained) / events : 0;
+}
+
+int main(int argc, char** argv)
+{
+    int bursts = argc > 1 ? atoi(argv[1]) : 200000;
+    if (bursts < MAX_FRAMES)
+        bursts = MAX_FRAMES;
+
+    // what the two clock reads around a drain cost on their own
+    int64_t overhead = -1;
+    for (int i=0 ; i<1000 ; i++) {
+        const int64_t start = now();
+        const int64_t t = now() - start;
+        if (overhead < 0 || t < overhead)
+            overhead = t;
+    }
+
+    double best[2] = { -1, -1 };
+    uint32_t sum[2];
+    for (int round=0 ; round<5 ; round++) {
+        for (int way=0 ; way<2 ; way++) {
+            const double t = run(way ? "spans" : "events", way, bursts, overhead,
+                    &sum[way]);
+            if (best[way] < 0 || t < best[way])
+                best[way] = t;
+        }
+    }
+    CHECK(sum[0] == sum[1], "walks decoded different values");
+
+    const double perBurst = (MAX_FRAMES + 1) * FRAME_EVENTS / 2.0;
+    printf("%d bursts of 1-%d frames, ring of %d events\n", bursts, MAX_FRAMES,
+            RING_EVENTS);
+    printf("readEvent/next:  %5.2f ns per event, %6.1f ns per burst\n",
+            best[0], best[0] * perBurst);
+    printf("getSpan/consume: %5.2f ns per event, %6.1f ns per burst\n",
+            best[1], best[1] * perBurst);
+
+    printf("%s\n", sFailures ? "FAILED" : "PASSED");
+    return sFailures ? 1 : 0;
+}
@@ -0,0 +1,248 @@
+/*
+ * Copyright (C) 2011 The CyanogenMod Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/*
+ * Several sensors-mux clients at different rates on a HAL running over the
+ * fake kernel, fed a 100 Hz compass stream. Checks the rate each client
+ * gets, that the chip runs at the fastest one, that clients other than
+ * root and system are refused, and reports the CPU the mux costs.
+ *
+ *   sensors_mux_test [seconds]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+
+#include <linux/akm8973.h>
+
+#include <cutils/sockets.h>
+#include <private/android_filesystem_config.h>
+
+#include "SensorMux.h"
+#include "hal_harness.h"
+
+/*****************************************************************************/
+
+#define AID_NOBODY          9999
+#define STREAM_PERIOD_NS    10000000LL
+
+static int sFailures;
+
+#define CHECK(cond, ...) do { \
+        if (!(cond)) { \
+            printf("FAIL: " __VA_ARGS__); \
+            printf("\n"); \
+            sFailures++; \
+        } \
+    } while (0)
+
+struct client_t {
+    int handle;
+    int64_t period;
+    int fd;
+    pthread_t thread;
+    volatile bool quit;
+    uint32_t events;
+    uint32_t other;             // events of handles it didn't ask for
+    int64_t first;
+    int64_t last;
+    int64_t minGap;
+};
+
+static int muxConnect()
+{
+    return socket_local_client(MUX_SOCKET_NAME,
+            ANDROID_SOCKET_NAMESPACE_ABSTRACT, SOCK_SEQPACKET);
+}
+
+static void muxCommand(int fd, const char* fmt, int handle, long long period)
+{
+    char cmd[64];
+    int len = snprintf(cmd, sizeof(cmd), fmt, handle, period);
+    send(fd, cmd, len, 0);
+}
+
+static void* clientLoop(void* arg)
+{
+    client_t* c = static_cast<client_t*>(arg);
+    sensors_event_t batch[MUX_BATCH];
+    struct pollfd pfd;
+    pfd.fd = c->fd;
+    pfd.events = POLLIN;
+    while (!c->quit) {
+        if (poll(&pfd, 1, 50) <= 0)
+            continue;
+        ssize_t n = recv(c->fd, batch, sizeof(batch), 0);
+        if (n <= 0)
+            break;
+        for (size_t i=0 ; i<n/sizeof(batch[0]) ; i++) {
+            if (batch[i].sensor != c->handle) {
+                c->other++;
+                continue;
+            }
+            const int64_t t = batch[i].timestamp;
+            if (c->events) {
+                if (c->minGap < 0 || t - c->last < c->minGap)
+                    c->minGap = t - c->last;
+            } else {
+                c->first = t;
+            }
+            c->last = t;
+            c->events++;
+        }
+    }
+    return NULL;
+}
+
+static int64_t cpuNs()
+{
+    struct rusage ru;
+    getrusage(RUSAGE_SELF, &ru);
+    return (ru.ru_utime.tv_sec + ru.ru_stime.tv_sec) * 1000000000LL +
+            (ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) * 1000LL;
+}
+
+// the device swings a little, so the compass never drops to its still rate
+static void stream(hal_harness_t* h, int64_t duration)
+{
+    const int64_t start = fake_now();
+    int swing = 0;
+    for (int64_t t = start ; t - start < duration ; t += STREAM_PERIOD_NS) {
+        while (fake_now() < t)
+            harness_sleep_ms(1);
+        swing = 100 - swing;
+        harness_akm_frame(h, swing, 0, 720, 100, 200, 300, t);
+    }
+}
+
+// 0 if a client running as uid is refused, 1 if it gets events
+static int servedAs(uid_t uid, hal_harness_t* h)
+{
+    pid_t pid = fork();
+    if (pid == 0) {
+        if (setuid(uid) < 0)
+            _exit(255);
+        int fd = muxConnect();
+        if (fd < 0)
+            _exit(255);
+        muxCommand(fd, "subscribe %d %lld", ID_M, 0);
+        struct pollfd pfd;
+        pfd.fd = fd;
+        pfd.events = POLLIN;
+        sensors_event_t batch[MUX_BATCH];
+        const int64_t end = fake_now() + 1000000000LL;
+        while (fake_now() < end) {
+            if (poll(&pfd, 1, 100) <= 0)
+                continue;
+            ssize_t n = recv(fd, batch, sizeof(batch), 0);
+            _exit(n > 0 ? 1 : 0);
+        }
+        _exit(0);
+    }
+    stream(h, 500000000LL);
+    int status;
+    if (pid < 0 || waitpid(pid, &status, 0) < 0 || !WIFEXITED(status) ||
+            WEXITSTATUS(status) == 255)
+        return -1;
+    return WEXITSTATUS(status);
+}
+
+int main(int argc, char** argv)
+{
+    const int seconds = argc > 1 ? atoi(argv[1]) : 3;
+    const int64_t duration = (seconds > 0 ? seconds : 1) * 1000000000LL;
+
+    hal_harness_t h;
+    if (harness_open(&h) < 0)
+        return 2;
+    // the framework wants the orientation, which the mux clients don't use
+    harness_activate(&h, ID_O, 1);
+    harness_start_polling(&h);
+
+    int64_t cpu = cpuNs();
+    stream(&h, duration);
+    const int64_t baseline = cpuNs() - cpu;
+
+    client_t clients[] = {
+        { ID_A, 10000000 },
+        { ID_A, 50000000 },
+        { ID_A, 200000000 },
+        { ID_M, 100000000 },
+    };
+    const int numClients = sizeof(clients) / sizeof(clients[0]);
+    for (int i=0 ; i<numClients ; i++) {
+        client_t& c(clients[i]);
+        c.fd = muxConnect();
+        c.quit = false;
+        c.events = c.other = 0;
+        c.minGap = -1;
+        CHECK(c.fd >= 0, "client %d can't connect", i);
+        muxCommand(c.fd, "subscribe %d %lld", c.handle, c.period);
+        pthread_create(&c.thread, NULL, clientLoop, &c);
+    }
+    // let the subscriptions reach the chip
+    stream(&h, 100000000LL);
+    const int delay = fake_ioctl_value(ECS_IOCTL_APP_SET_DELAY);
+    for (int i=0 ; i<numClients ; i++)
+        clients[i].events = 0;
+
+    cpu = cpuNs();
+    stream(&h, duration);
+    const int64_t muxed = cpuNs() - cpu;
+    harness_sleep_ms(100);
+
+    for (int i=0 ; i<numClients ; i++) {
+        client_t& c(clients[i]);
+        c.quit = true;
+        pthread_join(c.thread, NULL);
+        close(c.fd);
+
+        const int64_t period = c.period > STREAM_PERIOD_NS ? c.period : STREAM_PERIOD_NS;
+        const int64_t want = duration / period;
+        printf("client %d: handle %d every %lld ms: %u events, want %lld, "
+                "shortest gap %lld ms\n", i, c.handle, (long long)(c.period / 1000000),
+                c.events, (long long)want, (long long)(c.minGap / 1000000));
+        CHECK(c.events * 10 >= want * 9 && c.events * 10 <= want * 11,
+                "client %d got %u events, want about %lld", i, c.events, (long long)want);
+        CHECK(c.minGap >= period - period/8, "client %d got events %lld ms apart",
+                i, (long long)(c.minGap / 1000000));
+        CHECK(!c.other, "client %d got %u events of other handles", i, c.other);
+    }
+
+    hal_handle_stats_t fw;
+    harness_stats(&h, ID_A, &fw);
+    CHECK(fw.events == 0, "the framework got %u accelerometer events it didn't enable",
+            fw.events);
+    CHECK(delay == STREAM_PERIOD_NS / 1000000, "chip delay %d ms, want %lld", delay,
+            (long long)(STREAM_PERIOD_NS / 1000000));
+
+    printf("cpu per second of 100 Hz stream: %lld us without clients, "
+            "%lld us with %d clients\n", (long long)(baseline / seconds / 1000),
+            (long long)(muxed / seconds / 1000), numClients);
+
+    CHECK(servedAs(AID_SYSTEM, &h) == 1, "system wasn't served");
+    CHECK(servedAs(AID_NOBODY, &h) == 0, "uid %d was served", AID_NOBODY);
+
+    harness_close(&h);
+    printf("%s\n", sFailures ? "FAILED" : "PASSED");
+    return sFailures ? 1 : 0;
+}
@@ -0,0 +1,189 @@
+/*
+ * Copyright (C) 2011 The CyanogenMod Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/*
+ * SampleFifo: timestamps survive the delta encoding, a record older than
+ * the last one is refused, a full fifo drops its oldest records, and what
+ * encoding and decoding cost per sample next to a ring of sensors_event_t.
+ *
+ *   sensors_sample_fifo_test [samples]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <hardware/sensors.h>
+
+#include "SampleFifo.h"
+
+/*****************************************************************************/
+
+#define CAPACITY    256
+
+static int sFailures;
+
+#define CHECK(cond, ...) do { \
+        if (!(cond)) { \
+            printf("FAIL: " __VA_ARGS__); \
+            printf("\n"); \
+            sFailures++; \
+        } \
+    } while (0)
+
+static int64_t now()
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return int64_t(t.tv_sec)*1000000000LL + t.tv_nsec;
+}
+
+static void checkOrder()
+{
+    SampleFifo fifo(4);
+    const int16_t raw[3] = { 1, 2, 3 };
+    sensor_sample_t s;
+    int64_t t;
+
+    CHECK(fifo.push(0, 1000000000LL, raw, 0), "first push refused");
+    CHECK(fifo.push(1, 1000000000LL, raw, 0), "push of the same time refused");
+    CHECK(!fifo.push(0, 999000000LL, raw, 0), "older push taken");
+    CHECK(fifo.size() == 2 && fifo.getOutOfOrder() == 1,
+            "size %u, out of order %u", unsigned(fifo.size()), fifo.getOutOfOrder());
+
+    // once drained, a record older than those popped is still refused
+    while (fifo.pop(&s, &t))
+        ;
+    CHECK(!fifo.push(0, 999999000LL, raw, 0), "older push taken once drained");
+    CHECK(fifo.push(2, 5000000000LL, raw, 7), "push after a gap refused");
+    CHECK(fifo.pop(&s, &t) && t == 5000000000LL && s.slot == 2 && s.status == 7 &&
+            s.raw[0] == 1 && s.raw[1] == 2 && s.raw[2] == 3,
+            "record after a gap decoded as slot %d at %lld", s.slot, (long long)t);
+}
+
+static void checkOverflow()
+{
+    SampleFifo fifo(4);
+    int16_t raw[3] = { 0, 0, 0 };
+    for (int i=0 ; i<10 ; i++) {
+        raw[0] = i;
+        fifo.push(0, (i + 1) * 1000000LL + 123000, raw, 0);
+    }
+    CHECK(fifo.size() == 4 && fifo.getDropped() == 6, "size %u, dropped %u",
+            unsigned(fifo.size()), fifo.getDropped());
+    sensor_sample_t s;
+    int64_t t;
+    for (int i=6 ; fifo.pop(&s, &t) ; i++) {
+        CHECK(s.raw[0] == i && t == (i + 1) * 1000000LL + 123000,
+                "record %d decoded as %d at %lld", i, s.raw[0], (long long)t);
+    }
+}
+
+// a ring of full events, the way readings were buffered before
+struct EventRing {
+    sensors_event_t events[CAPACITY];
+    size_t head;
+    size_t count;
+};
+
+static void bench(int samples)
+{
+    static const int burst = CAPACITY / 2;
+    SampleFifo fifo(CAPACITY);
+    static EventRing ring;
+    sensor_sample_t s;
+    sensors_event_t e;
+    int64_t t = 1000000000LL, ts;
+    int16_t raw[3] = { 100, -200, 720 };
+    int64_t checksum = 0;
+
+    int64_t push = 0, pop = 0;
+    for (int done=0 ; done<samples ; done+=burst) {
+        int64_t start = now();
+        for (int i=0 ; i<burst ; i++) {
+            raw[0] = int16_t(i);
+            t += 10000000;
+            fifo.push(i % 3, t, raw, 3);
+        }
+        int64_t mid = now();
+        while (fifo.pop(&s, &ts)) {
+            e.sensor = s.slot;
+            e.acceleration.x = s.raw[0] * (9.81f / 720);
+            e.acceleration.y = s.raw[1] * (9.81f / 720);
+            e.acceleration.z = s.raw[2] * (9.81f / 720);
+            e.acceleration.status = s.status;
+            e.timestamp = ts;
+            checksum += e.timestamp + int64_t(e.acceleration.x);
+        }
+        int64_t end = now();
+        push += mid - start;
+        pop += end - mid;
+    }
+
+    int64_t evPush = 0, evPop = 0;
+    for (int done=0 ; done<samples ; done+=burst) {
+        int64_t start = now();
+        for (int i=0 ; i<burst ; i++) {
+            t += 10000000;
+            sensors_event_t& r(ring.events[ring.head]);
+            memset(&r, 0, sizeof(r));
+            r.sensor = i % 3;
+            r.acceleration.x = int16_t(i) * (9.81f / 720);
+            r.acceleration.y = raw[1] * (9.81f / 720);
+            r.acceleration.z = raw[2] * (9.81f / 720);
+            r.acceleration.status = 3;
+            r.timestamp = t;
+            ring.head = ring.head+1 < CAPACITY ? ring.head+1 : 0;
+            ring.count++;
+        }
+        int64_t mid = now();
+        while (ring.count) {
+            size_t tail = ring.head + CAPACITY - ring.count;
+            if (tail >= CAPACITY)
+                tail -= CAPACITY;
+            e = ring.events[tail];
+            ring.count--;
+            checksum += e.timestamp + int64_t(e.acceleration.x);
+        }
+        int64_t end = now();
+        evPush += mid - start;
+        evPop += end - mid;
+    }
+
+    printf("%d samples in bursts of %d:\n", samples, burst);
+    printf("  SampleFifo      %3u bytes/sample, push %lld ns, pop+expand %lld ns\n",
+            unsigned(sizeof(sensor_sample_t)), (long long)(push / samples),
+            (long long)(pop / samples));
+    printf("  sensors_event_t %3u bytes/sample, push %lld ns, pop %lld ns\n",
+            unsigned(sizeof(sensors_event_t)), (long long)(evPush / samples),
+            (long long)(evPop / samples));
+    if (checksum == 42)
+        printf("\n");   // keeps the loops from being optimized away
+}
+
+int main(int argc, char** argv)
+{
+    const int samples = argc > 1 ? atoi(argv[1]) : 1000000;
+
+    checkOrder();
+    checkOverflow();
+    bench(samples > 0 ? samples : 1000000);
+
+    printf("%s\n", sFailures ? "FAILED" : "PASSED");
+    return sFailures ? 1 : 0;
+}
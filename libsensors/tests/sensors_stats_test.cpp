@@ -0,0 +1,144 @@
+/*
+ * Copyright (C) 2011 The CyanogenMod Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/*
+ * Reads the sensors-stats dump of a HAL running over the fake kernel after
+ * streaming the compass, and checks that only root and system get it.
+ * A delay set on the light sensor without enabling it must not have
+ * created its driver.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+
+#include <cutils/sockets.h>
+#include <private/android_filesystem_config.h>
+
+#include "hal_harness.h"
+
+/*****************************************************************************/
+
+#define STATS_SOCKET_NAME   "sensors-stats"
+#define AID_NOBODY          9999
+
+static int sFailures;
+
+#define CHECK(cond, ...) do { \
+        if (!(cond)) { \
+            printf("FAIL: " __VA_ARGS__); \
+            printf("\n"); \
+            sFailures++; \
+        } \
+    } while (0)
+
+static int readDump(char* buf, size_t size)
+{
+    int fd = socket_local_client(STATS_SOCKET_NAME,
+            ANDROID_SOCKET_NAMESPACE_ABSTRACT, SOCK_STREAM);
+    if (fd < 0)
+        return -1;
+    size_t len = 0;
+    ssize_t n;
+    while (len < size-1 && (n = read(fd, buf+len, size-1-len)) > 0)
+        len += n;
+    buf[len] = 0;
+    close(fd);
+    return len;
+}
+
+// bytes of dump a client running as uid gets
+static int dumpSizeAs(uid_t uid)
+{
+    pid_t pid = fork();
+    if (pid == 0) {
+        char buf[8192];
+        if (setuid(uid) < 0)
+            _exit(255);
+        int len = readDump(buf, sizeof(buf));
+        _exit(len > 0 ? 1 : 0);
+    }
+    int status;
+    if (pid < 0 || waitpid(pid, &status, 0) < 0 || !WIFEXITED(status) ||
+            WEXITSTATUS(status) == 255)
+        return -1;
+    return WEXITSTATUS(status);
+}
+
+int main(int argc, char** argv)
+{
+    hal_harness_t h;
+    if (harness_open(&h) < 0)
+        return 2;
+    harness_activate(&h, ID_A, 1);
+    harness_set_delay(&h, ID_A, 10000000);
+    harness_set_delay(&h, ID_L, 10000000);
+    harness_start_polling(&h);
+
+    const int frames = 100;
+    for (int i=0 ; i<frames ; i++) {
+        harness_akm_frame(&h, 0, 0, 720, 100, 200, 300, fake_now());
+        harness_sleep_ms(2);
+    }
+    harness_sleep_ms(50);
+
+    hal_handle_stats_t accel;
+    harness_stats(&h, ID_A, &accel);
+
+    char dump[8192];
+    CHECK(readDump(dump, sizeof(dump)) > 0, "no dump for root");
+    printf("%s", dump);
+
+    unsigned evdev = 0;
+    const char* p = strstr(dump, "driver akm");
+    CHECK(p && sscanf(p, "driver akm evdev_events %u", &evdev) == 1 &&
+            evdev == unsigned(frames) * 7, "akm read %u input events, %d written",
+            evdev, frames * 7);
+
+    CHECK(strstr(dump, "driver light not created") != NULL,
+            "setDelay() alone created the light driver");
+    CHECK(strstr(dump, "driver proximity not created") != NULL,
+            "the proximity driver was created");
+
+    unsigned delivered = 0, unaligned = 0, bucket, total = 0;
+    long long rate;
+    int offset;
+    p = strstr(dump, "handle 0 ");
+    if (p && sscanf(p, "handle 0 delivered %u rate_mhz %lld unaligned %u latency_ms_log2%n",
+            &delivered, &rate, &unaligned, &offset) == 3) {
+        p += offset;
+        while (sscanf(p, " %u%n", &bucket, &offset) == 1) {
+            total += bucket;
+            p += offset;
+        }
+    }
+    CHECK(delivered == accel.events && delivered > 0,
+            "dump says %u accelerometer events delivered, the framework got %u",
+            delivered, accel.events);
+    CHECK(unaligned == 0, "%u events with a timestamp off our clock", unaligned);
+    CHECK(total == delivered - unaligned, "latency histogram holds %u events, want %u",
+            total, delivered - unaligned);
+
+    CHECK(dumpSizeAs(AID_SYSTEM) == 1, "system didn't get the dump");
+    CHECK(dumpSizeAs(AID_NOBODY) == 0, "uid %d got the dump", AID_NOBODY);
+
+    harness_close(&h);
+    printf("%s\n", sFailures ? "FAILED" : "PASSED");
+    return sFailures ? 1 : 0;
+}
@@ -0,0 +1,249 @@
+/*
+ * Copyright (C) 2011 The CyanogenMod Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/*
+ * StepDetector on synthetic walking traces sampled at STEP_DELAY_NS, or on
+ * recorded ones, its cost per sample, and the step counter of the compass
+ * driver being activated while accelerometer readings wait to be read.
+ *
+ *   sensors_step_test [trace steps]...
+ *
+ * A trace file has one "<ms> <x> <y> <z>" accelerometer reading (m/s^2)
+ * per line, and is expected to count the given number of steps.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+#include "StepDetector.h"
+#include "hal_harness.h"
+
+/*****************************************************************************/
+
+#define MS          1000000LL
+#define GRAVITY     9.81f
+
+static int sFailures;
+
+#define CHECK(cond, ...) do { \
+        if (!(cond)) { \
+            printf("FAIL: " __VA_ARGS__); \
+            printf("\n"); \
+            sFailures++; \
+        } \
+    } while (0)
+
+struct gait_t {
+    const char* name;
+    float cadence;      // steps per second, 0 for none
+    float bounce;       // vertical amplitude, m/s^2
+    float noise;        // m/s^2, either way
+    float seconds;
+    float pause;        // seconds standing still after the walk
+    int repeat;
+    int expected;       // steps, -1 for cadence * seconds * repeat
+    int tolerance;      // steps either way
+};
+
+static const gait_t sGaits[] = {
+    { "walking",            1.8f, 3.0f, 0.3f, 30, 0, 1, -1, 2 },
+    { "strolling",          1.2f, 2.0f, 0.2f, 30, 0, 1, -1, 2 },
+    { "running",            3.0f, 8.0f, 0.5f, 20, 0, 1, -1, 2 },
+    { "stop and go",        1.8f, 3.0f, 0.3f, 10, 5, 3, -1, 3 },
+    { "lying still",        0.0f, 0.0f, 0.2f, 30, 0, 1,  0, 0 },
+    { "carried in a car",   0.0f, 0.0f, 0.8f, 30, 0, 1,  0, 1 },
+};
+
+static unsigned sSeed = 1;
+
+// uniform in [-1, 1], reproducible from run to run
+static float noise()
+{
+    return rand_r(&sSeed) * (2.0f / RAND_MAX) - 1.0f;
+}
+
+// accelerometer reading of gait at time t, the phone tilted in a pocket
+static void sample(const gait_t& g, float t, float* a)
+{
+    const float cycle = g.seconds + g.pause;
+    const float inCycle = fmodf(t, cycle);
+    float v = 0;
+    if (g.cadence && inCycle < g.seconds) {
+        v = g.bounce * sinf(2 * float(M_PI) * g.cadence * inCycle);
+    }
+    const float up = GRAVITY + v;
+    a[0] = 0.3f * up + g.noise * noise();
+    a[1] = 0.2f * v + g.noise * noise();
+    a[2] = 0.93f * up + g.noise * noise();
+}
+
+static int walk(const gait_t& g, StepDetector& d, int64_t* elapsed, int* samples)
+{
+    const float cycle = g.seconds + g.pause;
+    const int n = int(cycle * g.repeat * 1e9f / STEP_DELAY_NS);
+    const uint32_t before = d.getSteps();
+    float a[3];
+    struct timespec t0, t1;
+    *elapsed = 0;
+    for (int i=0 ; i<n ; i++) {
+        const int64_t time = 1000000000LL + i * STEP_DELAY_NS;
+        sample(g, i * (STEP_DELAY_NS * 1e-9f), a);
+        clock_gettime(CLOCK_MONOTONIC, &t0);
+        d.process(a[0], a[1], a[2], time);
+        clock_gettime(CLOCK_MONOTONIC, &t1);
+        *elapsed += (t1.tv_sec - t0.tv_sec) * 1000000000LL + t1.tv_nsec - t0.tv_nsec;
+    }
+    *samples = n;
+    return int(d.getSteps() - before);
+}
+
+static void checkGaits()
+{
+    int64_t total = 0;
+    int totalSamples = 0;
+    for (size_t i=0 ; i<sizeof(sGaits)/sizeof(sGaits[0]) ; i++) {
+        const gait_t& g(sGaits[i]);
+        StepDetector d;
+        int64_t elapsed;
+        int samples;
+        const int steps = walk(g, d, &elapsed, &samples);
+        const int expected = g.expected >= 0 ? g.expected :
+                int(g.cadence * g.seconds * g.repeat + 0.5f);
+        printf("%-18s %4d steps, expected %4d\n", g.name, steps, expected);
+        CHECK(abs(steps - expected) <= g.tolerance, "%s: %d steps, expected %d",
+                g.name, steps, expected);
+        total += elapsed;
+        totalSamples += samples;
+    }
+    printf("StepDetector::process() %lld ns per sample, %d samples\n",
+            (long long)(total / totalSamples), totalSamples);
+}
+
+static int replayFile(const char* path, int expected)
+{
+    FILE* f = fopen(path, "r");
+    if (!f) {
+        perror(path);
+        return 1;
+    }
+    StepDetector d;
+    long long ms;
+    float x, y, z;
+    while (fscanf(f, "%lld %f %f %f", &ms, &x, &y, &z) == 4)
+        d.process(x, y, z, ms * MS);
+    fclose(f);
+    printf("%s: %u steps, expected %d\n", path, d.getSteps(), expected);
+    return abs(int(d.getSteps()) - expected) > expected / 20 + 1;
+}
+
+/*****************************************************************************/
+
+// the counter is activated while the framework is busy and accelerometer
+// readings pile up; its first report must not be dated before them, nor
+// them get dropped for being older than it
+
+struct counter_t {
+    volatile bool stall;
+    int64_t lastTimestamp;
+    int backwards;
+    int accel;
+    int counts;
+    float firstCount;
+    int64_t firstCountTime;
+};
+
+static void onEvent(void* cookie, sensors_event_t const* e, int64_t)
+{
+    counter_t* c = static_cast<counter_t*>(cookie);
+    if (c->stall) {
+        c->stall = false;
+        harness_sleep_ms(60);
+    }
+    if (e->timestamp < c->lastTimestamp)
+        c->backwards++;
+    c->lastTimestamp = e->timestamp;
+    if (e->sensor == ID_A)
+        c->accel++;
+    if (e->sensor == ID_SC) {
+        if (!c->counts++) {
+            c->firstCount = e->data[0];
+            c->firstCountTime = e->timestamp;
+        }
+    }
+}
+
+static void checkCounterActivation()
+{
+    hal_harness_t h;
+    if (harness_open(&h) < 0) {
+        sFailures++;
+        return;
+    }
+    static counter_t c;
+    h.onEvent = onEvent;
+    h.cookie = &c;
+    harness_set_delay(&h, ID_A, STEP_DELAY_NS);
+    harness_activate(&h, ID_A, 1);
+    harness_start_polling(&h);
+    harness_sleep_ms(50);
+
+    const gait_t& walking(sGaits[0]);
+    float a[3];
+    const int frames = 100;
+    int64_t activated = 0;
+    for (int i=0 ; i<frames ; i++) {
+        const int64_t t = fake_now();
+        if (i == frames / 2) {
+            // the framework is stuck in the next event for a while
+            c.stall = true;
+            harness_sleep_ms(5);
+        }
+        sample(walking, i * (STEP_DELAY_NS * 1e-9f), a);
+        harness_akm_frame(&h, int(a[0] / CONVERT_A), int(a[1] / CONVERT_A),
+                int(a[2] / CONVERT_A), 100, 200, 300, t);
+        if (i == frames / 2 + 1) {
+            harness_activate(&h, ID_SC, 1);
+            activated = fake_now();
+        }
+        while (fake_now() < t + STEP_DELAY_NS)
+            harness_sleep_ms(1);
+    }
+    harness_sleep_ms(100);
+    harness_close(&h);
+
+    printf("counter activated mid-stream: %d accelerometer events of %d, first "
+            "count %.0f dated %lld ms after activation\n", c.accel, frames,
+            c.firstCount, (long long)((c.firstCountTime - activated) / MS));
+    CHECK(c.accel == frames, "%d accelerometer readings lost", frames - c.accel);
+    CHECK(c.backwards == 0, "%d events went back in time", c.backwards);
+    CHECK(c.counts > 0 && c.firstCount == 0, "the counter reported %d times, "
+            "first %.0f", c.counts, c.firstCount);
+}
+
+int main(int argc, char** argv)
+{
+    checkGaits();
+    for (int i=1 ; i+1<argc ; i+=2)
+        sFailures += replayFile(argv[i], atoi(argv[i+1]));
+    checkCounterActivation();
+
+    printf("%s\n", sFailures ? "FAILED" : "PASSED");
+    return sFailures ? 1 : 0;
+}